@@ -1,13 +1,13 @@
 #ifndef HXWK_AST_H
 #define HXWK_AST_H
 
+#include "Arena.hpp"
 #include "Lexer.hpp"
+#include "StringInterner.hpp"
 #include "Type.hpp"
 #include "VisitorPattern.hpp"
-#include <memory>
-#include <string>
+#include <cstdint>
 #include <utility>
-#include <vector>
 
 class Expr;
 template <typename T>
@@ -17,6 +17,15 @@ class BinaryExpr;
 class CallExpr;
 class ScopeExpr;
 class IfExpr;
+class CastExpr;
+class AssignExpr;
+class WhileExpr;
+class ForExpr;
+class IndexExpr;
+class ArrayExpr;
+class NewExpr;
+class SpawnExpr;
+class AwaitExpr;
 class VarDecl;
 class FnDecl;
 class FnDef;
@@ -33,28 +42,94 @@ class StatementVis {
 class ExprVis {
   public:
     virtual ~ExprVis() = default;
+    ABSTR_VISIT(LiteralExpr<bool>);
     ABSTR_VISIT(LiteralExpr<int32_t>);
+    ABSTR_VISIT(LiteralExpr<int64_t>);
     ABSTR_VISIT(LiteralExpr<double>);
-    ABSTR_VISIT(LiteralExpr<std::string>);
+    ABSTR_VISIT(LiteralExpr<Symbol>);
     ABSTR_VISIT(IdExpr);
     ABSTR_VISIT(BinaryExpr);
     ABSTR_VISIT(CallExpr);
     ABSTR_VISIT(ScopeExpr);
     ABSTR_VISIT(IfExpr);
+    ABSTR_VISIT(CastExpr);
+    ABSTR_VISIT(AssignExpr);
+    ABSTR_VISIT(WhileExpr);
+    ABSTR_VISIT(ForExpr);
+    ABSTR_VISIT(IndexExpr);
+    ABSTR_VISIT(ArrayExpr);
+    ABSTR_VISIT(NewExpr);
+    ABSTR_VISIT(SpawnExpr);
+    ABSTR_VISIT(AwaitExpr);
 };
 
+class MutStatementVis {
+  public:
+    virtual ~MutStatementVis() = default;
+    ABSTR_VISIT_MUT(Expr);
+    ABSTR_VISIT_MUT(VarDecl);
+    ABSTR_VISIT_MUT(FnDecl);
+    ABSTR_VISIT_MUT(FnDef);
+};
+
+class MutExprVis {
+  public:
+    virtual ~MutExprVis() = default;
+    ABSTR_VISIT_MUT(LiteralExpr<bool>);
+    ABSTR_VISIT_MUT(LiteralExpr<int32_t>);
+    ABSTR_VISIT_MUT(LiteralExpr<int64_t>);
+    ABSTR_VISIT_MUT(LiteralExpr<double>);
+    ABSTR_VISIT_MUT(LiteralExpr<Symbol>);
+    ABSTR_VISIT_MUT(IdExpr);
+    ABSTR_VISIT_MUT(BinaryExpr);
+    ABSTR_VISIT_MUT(CallExpr);
+    ABSTR_VISIT_MUT(ScopeExpr);
+    ABSTR_VISIT_MUT(IfExpr);
+    ABSTR_VISIT_MUT(CastExpr);
+    ABSTR_VISIT_MUT(AssignExpr);
+    ABSTR_VISIT_MUT(WhileExpr);
+    ABSTR_VISIT_MUT(ForExpr);
+    ABSTR_VISIT_MUT(IndexExpr);
+    ABSTR_VISIT_MUT(ArrayExpr);
+    ABSTR_VISIT_MUT(NewExpr);
+    ABSTR_VISIT_MUT(SpawnExpr);
+    ABSTR_VISIT_MUT(AwaitExpr);
+};
+
+// Nodes are allocated in an Arena by the Parser and refer to their children
+// through non-owning pointers. They are never deleted individually, so there
+// is no virtual destructor and most nodes are trivially destructible.
 class Statement {
   public:
-    virtual ~Statement() = default;
     ABSTR_ACCEPT(StatementVis);
+    ABSTR_ACCEPT_MUT(MutStatementVis);
+
+  protected:
+    ~Statement() = default;
 };
 
+// The annotations of Expr and its subclasses are filled in by Sema, IR
+// generation relies on them.
 class Expr : public Statement {
   public:
     ABSTR_ACCEPT(ExprVis);
     ACCEPT(StatementVis);
+    ABSTR_ACCEPT_MUT(MutExprVis);
+    ACCEPT_MUT(MutStatementVis);
+
+    const Type *get_type() const { return type; };
+    void set_type(const Type *type) { this->type = type; };
+
+  protected:
+    ~Expr() = default;
+
+  private:
+    const Type *type{nullptr};
 };
 
+// Integer literals too large for `i32` are `LiteralExpr<int64_t>`, as are
+// the constants of the other integer types ConstFolder creates. Constants of
+// type `f32` are `LiteralExpr<double>`.
 template <typename T>
 class LiteralExpr : public Expr {
   public:
@@ -63,6 +138,7 @@ class LiteralExpr : public Expr {
     T get_val() const { return val; };
 
     ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
 
   private:
     T val;
@@ -70,132 +146,495 @@ class LiteralExpr : public Expr {
 
 class IdExpr : public Expr {
   public:
-    IdExpr(std::string id) : id(std::move(id)){};
+    IdExpr(Symbol id) : id(id){};
 
-    const std::string &get_id() const { return id; };
+    Symbol get_id() const { return id; };
+    // Index of the parameter or variable among its function's locals
+    unsigned get_local() const { return local; };
+    void set_local(unsigned local) { this->local = local; };
 
     ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
 
   private:
-    std::string id;
+    Symbol id;
+    unsigned local{0};
 };
 
 class BinaryExpr : public Expr {
   public:
-    BinaryExpr(Tok op, std::unique_ptr<Expr> lhs, std::unique_ptr<Expr> rhs)
-            : op(op), lhs(std::move(lhs)), rhs(std::move(rhs)){};
+    BinaryExpr(Tok op, Expr *lhs, Expr *rhs) : op(op), lhs(lhs), rhs(rhs){};
 
     Tok get_op() const { return op; };
     const Expr &get_lhs() const { return *lhs; };
     const Expr &get_rhs() const { return *rhs; };
+    Expr &get_lhs() { return *lhs; };
+    Expr &get_rhs() { return *rhs; };
+    void set_lhs(Expr *lhs) { this->lhs = lhs; };
+    void set_rhs(Expr *rhs) { this->rhs = rhs; };
 
     ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
 
   private:
     Tok op;
-    std::unique_ptr<Expr> lhs, rhs;
+    Expr *lhs, *rhs;
+};
+
+// Functions provided by the compiler rather than by a declaration
+enum class Builtin {
+    NONE,
+    // `len(x)`, the number of elements of an array or slice, or of lanes of
+    // a vector
+    LEN,
+    // `free(x)`, releases the elements of a slice created by `new`
+    FREE,
+    // `splat(x)`, a vector of the native number of lanes all holding `x`
+    SPLAT,
+    // `extract(v, i)`, lane `i` of the vector `v`
+    EXTRACT,
+    // `insert(v, i, x)`, `v` with lane `i` replaced by `x`
+    INSERT,
+    // `shuffle(a, [i, j, ...])` or `shuffle(a, b, [i, j, ...])`, a vector of
+    // the lanes selected by the literal indices from `a` followed by `b`
+    SHUFFLE,
+    // `select(mask, a, b)`, lanes of `a` where `mask` holds, else of `b`
+    SELECT,
+    // `hsum(v)`, `hmul(v)`, `hmin(v)` and `hmax(v)` reduce all lanes of `v`,
+    // floating point lanes in an unspecified order
+    HSUM,
+    HMUL,
+    HMIN,
+    HMAX,
+    // `any(mask)` and `all(mask)` reduce vectors of `bool`
+    ANY,
+    ALL,
+    // `load(s, i)` loads a vector of the native number of lanes from
+    // elements `i` onwards of the array or slice `s`, `store(s, i, v)`
+    // stores `v` into the slice `s` likewise
+    LOAD,
+    STORE
 };
 
 class CallExpr : public Expr {
   public:
-    CallExpr(std::string id, std::vector<std::unique_ptr<Expr>> args)
-            : id(std::move(id)), args(std::move(args)){};
-
-    const std::string &get_id() const { return id; };
-    const std::vector<std::unique_ptr<Expr>> &get_args() const {
-        return args;
+    CallExpr(Symbol id, Span<Expr *> args) : id(id), args(args){};
+
+    Symbol get_id() const { return id; };
+    Span<Expr *const> get_args() const { return {args.begin(), args.size()}; };
+    Span<Expr *> get_args() { return args; };
+    // Builtins are only called if no function of the same name is declared
+    Builtin get_builtin() const { return builtin; };
+    void set_builtin(Builtin builtin) { this->builtin = builtin; };
+    // The lanes `shuffle` selects, taken from its last argument by Sema
+    Span<const uint32_t> get_mask() const {
+        return {mask.begin(), mask.size()};
     };
+    void set_mask(Span<uint32_t> mask) { this->mask = mask; };
 
     ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
 
   private:
-    std::string id;
-    std::vector<std::unique_ptr<Expr>> args;
+    Symbol id;
+    Span<Expr *> args;
+    Builtin builtin{Builtin::NONE};
+    Span<uint32_t> mask;
 };
 
 class ScopeExpr : public Expr {
   public:
-    using Body_t = std::vector<std::unique_ptr<Statement>>;
+    // A trailing nullptr marks a scope ending in a semicolon, i.e. one
+    // evaluating to `void`.
+    using Body_t = Span<Statement *>;
 
-    ScopeExpr(Body_t body) : body(std::move(body)){};
+    ScopeExpr(Body_t body) : body(body){};
 
     const Body_t &get_body() const { return body; };
+    // The locals of the futures declared directly within the scope, which
+    // are awaited when it ends
+    Span<const unsigned> get_futures() const {
+        return {futures.begin(), futures.size()};
+    };
+    void set_futures(Span<unsigned> futures) { this->futures = futures; };
 
     ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
 
   private:
     Body_t body;
+    Span<unsigned> futures;
 };
 
 class IfExpr : public Expr {
   public:
-    IfExpr(std::unique_ptr<Expr> cond, std::unique_ptr<ScopeExpr> then,
-           std::unique_ptr<ScopeExpr> or_else)
-            : cond(std::move(cond)),
-              then(std::move(then)),
-              or_else(std::move(or_else)){};
+    IfExpr(Expr *cond, ScopeExpr *then, ScopeExpr *or_else)
+            : cond(cond), then(then), or_else(or_else){};
 
     const Expr &get_cond() const { return *cond; };
     const ScopeExpr &get_then() const { return *then; };
     const ScopeExpr &get_else() const { return *or_else; };
+    Expr &get_cond() { return *cond; };
+    ScopeExpr &get_then() { return *then; };
+    ScopeExpr &get_else() { return *or_else; };
+    void set_cond(Expr *cond) { this->cond = cond; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    Expr *cond;
+    ScopeExpr *then, *or_else;
+};
+
+// Converts between arithmetic types, written out as `operand as type` or
+// inserted by Sema wherever the language converts implicitly
+class CastExpr : public Expr {
+  public:
+    CastExpr(Expr *operand, const Type *type, bool is_explicit = false)
+            : operand(operand), is_explicit_cast(is_explicit) {
+        set_type(type);
+    };
+
+    const Expr &get_operand() const { return *operand; };
+    Expr &get_operand() { return *operand; };
+    void set_operand(Expr *operand) { this->operand = operand; };
+    // Written out by the programmer, its operand is yet to be checked
+    bool is_explicit() const { return is_explicit_cast; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    Expr *operand;
+    bool is_explicit_cast;
+};
+
+// Evaluates to `void`
+class AssignExpr : public Expr {
+  public:
+    AssignExpr(Expr *target, Expr *value) : target(target), value(value){};
+
+    const Expr &get_target() const { return *target; };
+    const Expr &get_value() const { return *value; };
+    Expr &get_target() { return *target; };
+    Expr &get_value() { return *value; };
+    void set_value(Expr *value) { this->value = value; };
+    // The mutable variable assigned to
+    unsigned get_local() const { return local; };
+    void set_local(unsigned local) { this->local = local; };
+    // The element assigned to, nullptr when assigning to a variable
+    const IndexExpr *get_element() const { return element; };
+    void set_element(const IndexExpr *element) { this->element = element; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    Expr *target, *value;
+    unsigned local{0};
+    const IndexExpr *element{nullptr};
+};
+
+// Evaluates to `void`
+class WhileExpr : public Expr {
+  public:
+    WhileExpr(Expr *cond, ScopeExpr *body) : cond(cond), body(body){};
+
+    const Expr &get_cond() const { return *cond; };
+    const ScopeExpr &get_body() const { return *body; };
+    Expr &get_cond() { return *cond; };
+    ScopeExpr &get_body() { return *body; };
+    void set_cond(Expr *cond) { this->cond = cond; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    Expr *cond;
+    ScopeExpr *body;
+};
+
+// Given by `#[unroll(n)]`, `#[vectorize(width)]` and `#[grain(n)]`, 0 where
+// not given
+struct LoopHints {
+    unsigned unroll{0};
+    unsigned vectorize{0};
+    // Iterations a `par for` loop runs in one piece at least
+    unsigned grain{0};
+};
+
+// `reduce(op) var` of a `par for` loop, `op` is `Tok::INVALID` without one
+struct Reduction {
+    Tok op{Tok::INVALID};
+    IdExpr *var{nullptr};
+};
+
+// `for var in begin..end`, counts `var` up from `begin` to `end` exclusively.
+// `end` is evaluated once before the first iteration, `var` cannot be
+// assigned to. Evaluates to `void`.
+//
+// `par for` runs the iterations in parallel, in no particular order. The body
+// cannot assign to variables declared outside of it, other than the
+// reduction variable. Within the body, that variable holds what the current
+// worker has accumulated starting from the identity of `op`; the workers'
+// results are combined into it with `op` after the loop.
+class ForExpr : public Expr {
+  public:
+    ForExpr(Symbol var, Expr *begin, Expr *end, ScopeExpr *body,
+            LoopHints hints, bool parallel = false,
+            Reduction reduction = {})
+            : var(var),
+              begin(begin),
+              end(end),
+              body(body),
+              hints(hints),
+              parallel(parallel),
+              reduction(reduction){};
+
+    Symbol get_var() const { return var; };
+    const Expr &get_begin() const { return *begin; };
+    const Expr &get_end() const { return *end; };
+    const ScopeExpr &get_body() const { return *body; };
+    Expr &get_begin() { return *begin; };
+    Expr &get_end() { return *end; };
+    ScopeExpr &get_body() { return *body; };
+    void set_begin(Expr *begin) { this->begin = begin; };
+    void set_end(Expr *end) { this->end = end; };
+    const LoopHints &get_hints() const { return hints; };
+    bool is_parallel() const { return parallel; };
+    const Reduction &get_reduction() const { return reduction; };
+    // The local holding `var`
+    unsigned get_local() const { return local; };
+    void set_local(unsigned local) { this->local = local; };
+    // Arrays and slices indexed by `var` on every iteration. The loop is
+    // versioned on whether the whole range is in bounds of each, skipping
+    // the checks of those indices on each iteration if so.
+    Span<const IdExpr *> get_range_checks() const { return range_checks; };
+    void set_range_checks(Span<const IdExpr *> range_checks) {
+        this->range_checks = range_checks;
+    };
+    // Variables declared outside of a `par for` loop which its body refers
+    // to, one for each local, not including the reduction variable
+    Span<const IdExpr *> get_captures() const { return captures; };
+    void set_captures(Span<const IdExpr *> captures) {
+        this->captures = captures;
+    };
 
     ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
 
   private:
-    std::unique_ptr<Expr> cond;
-    std::unique_ptr<ScopeExpr> then, or_else;
+    Symbol var;
+    Expr *begin;
+    Expr *end;
+    ScopeExpr *body;
+    LoopHints hints;
+    bool parallel;
+    Reduction reduction;
+    unsigned local{0};
+    Span<const IdExpr *> range_checks;
+    Span<const IdExpr *> captures;
+};
+
+// `base[index]`, an element of an array or slice. Indices out of bounds
+// trap unless compiled with `--unchecked`.
+class IndexExpr : public Expr {
+  public:
+    IndexExpr(Expr *base, Expr *index) : base(base), index(index){};
+
+    const Expr &get_base() const { return *base; };
+    const Expr &get_index() const { return *index; };
+    Expr &get_base() { return *base; };
+    Expr &get_index() { return *index; };
+    void set_index(Expr *index) { this->index = index; };
+    // Only checked if not all of the range of the enclosing `for` loop is in
+    // bounds, see ForExpr::get_range_checks
+    bool is_hoisted() const { return hoisted; };
+    void set_hoisted(bool hoisted) { this->hoisted = hoisted; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    Expr *base, *index;
+    bool hoisted{false};
+};
+
+// `[a, b, c]`, or `[a; size]` with a single element repeated `size` times.
+// The array is stored in the frame of the current function.
+class ArrayExpr : public Expr {
+  public:
+    ArrayExpr(Span<Expr *> elems, uint32_t size) : elems(elems), size(size){};
+
+    Span<Expr *const> get_elems() const {
+        return {elems.begin(), elems.size()};
+    };
+    Span<Expr *> get_elems() { return elems; };
+    uint32_t get_size() const { return size; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    Span<Expr *> elems;
+    uint32_t size;
+};
+
+// `new [elem; size]`, allocates `size` zeroed elements on the heap and
+// evaluates to a slice of them, to be released by `free`
+class NewExpr : public Expr {
+  public:
+    NewExpr(const Type *elem, Expr *size) : elem(elem), size(size){};
+
+    const Type *get_elem() const { return elem; };
+    const Expr &get_size() const { return *size; };
+    Expr &get_size() { return *size; };
+    void set_size(Expr *size) { this->size = size; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    const Type *elem;
+    Expr *size;
+};
+
+// `spawn f(args)`, evaluates the arguments and starts the call on the pool
+// of workers, see Runtime.hpp. Evaluates to a future of the call's result,
+// and may only initialise an immutable variable. The call runs in parallel
+// with the rest of the scope declaring the variable, at whose end it is
+// awaited at the latest.
+class SpawnExpr : public Expr {
+  public:
+    SpawnExpr(CallExpr *call) : call(call){};
+
+    const CallExpr &get_call() const { return *call; };
+    CallExpr &get_call() { return *call; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    CallExpr *call;
+};
+
+// `await future`, waits for a spawned call to finish and evaluates to its
+// result. The waiting worker runs other tasks in the meantime. A future may
+// be awaited any number of times.
+class AwaitExpr : public Expr {
+  public:
+    AwaitExpr(IdExpr *future) : future(future){};
+
+    const IdExpr &get_future() const { return *future; };
+    IdExpr &get_future() { return *future; };
+
+    ACCEPT(ExprVis);
+    ACCEPT_MUT(MutExprVis);
+
+  private:
+    IdExpr *future;
 };
 
 class VarDecl : public Statement {
   public:
-    VarDecl(std::string id, std::unique_ptr<Expr> rhs)
-            : id(std::move(id)), rhs(std::move(rhs)){};
+    VarDecl(Symbol id, Expr *rhs, bool is_mut = false)
+            : id(id), rhs(rhs), is_mut(is_mut){};
 
-    const std::string &get_id() const { return id; };
+    Symbol get_id() const { return id; };
+    // Declared with `let mut`, i.e. assignable
+    bool is_mutable() const { return is_mut; };
     const Expr &get_rhs() const { return *rhs; };
+    Expr &get_rhs() { return *rhs; };
+    void set_rhs(Expr *rhs) { this->rhs = rhs; };
+    unsigned get_local() const { return local; };
+    void set_local(unsigned local) { this->local = local; };
 
     ACCEPT(StatementVis);
+    ACCEPT_MUT(MutStatementVis);
 
   private:
-    std::string id;
-    std::unique_ptr<Expr> rhs;
+    Symbol id;
+    Expr *rhs;
+    bool is_mut;
+    unsigned local{0};
+};
+
+// What a call may do besides computing its result, including what the
+// functions it calls in turn may do. The defaults hold for functions which
+// are only declared, about which nothing is known.
+struct FnEffects {
+    enum class Memory { NONE, READ, WRITE };
+    // Accesses to memory outside of the function's own frame, such as the
+    // elements of slices, the heap, output and the runtime's state
+    Memory memory{Memory::WRITE};
+    // Functions without a definition may unwind, the language has no
+    // exceptions
+    bool unwinds{true};
+    // Every call returns, unless it traps. Loops other than counted ones and
+    // recursion are assumed to run forever.
+    bool terminates{false};
+    // Traps if a bounds check fails, unless compiled with `--unchecked`
+    bool may_trap{true};
+    // May call itself, directly or through other functions
+    bool recursive{true};
 };
 
 class FnDecl : public Statement {
   public:
-    using Param_t = std::pair<std::string, std::shared_ptr<Type>>;
-    FnDecl(std::string id, std::vector<Param_t> params,
-           std::shared_ptr<Type> ret_type)
-            : id(std::move(id)),
-              params(std::move(params)),
-              ret_type(std::move(ret_type)){};
+    using Param_t = std::pair<Symbol, const Type *>;
+    FnDecl(Symbol id, Span<Param_t> params, const Type *ret_type)
+            : id(id), params(params), ret_type(ret_type){};
 
-    const std::string &get_id() const { return id; };
-    const std::vector<Param_t> &get_params() const { return params; };
-    const std::shared_ptr<Type> &get_ret_type() const { return ret_type; };
+    Symbol get_id() const { return id; };
+    Span<const Param_t> get_params() const {
+        return {params.begin(), params.size()};
+    };
+    const Type *get_ret_type() const { return ret_type; };
+    // Inferred by EffectAnalysis
+    const FnEffects &get_effects() const { return effects; };
+    void set_effects(const FnEffects &effects) { this->effects = effects; };
 
     ACCEPT(StatementVis);
+    ACCEPT_MUT(MutStatementVis);
 
   private:
-    std::string id;
-    std::vector<Param_t> params;
-    std::shared_ptr<Type> ret_type;
+    Symbol id;
+    Span<Param_t> params;
+    const Type *ret_type;
+    FnEffects effects;
 };
 
 class FnDef : public Statement {
   public:
-    FnDef(std::unique_ptr<FnDecl> decl, std::unique_ptr<ScopeExpr> body)
-            : decl(std::move(decl)), body(std::move(body)){};
+    FnDef(FnDecl *decl, ScopeExpr *body) : decl(decl), body(body){};
 
     const FnDecl &get_decl() const { return *decl; };
     const ScopeExpr &get_body_scope() const { return *body; };
     const ScopeExpr::Body_t &get_body() const { return body->get_body(); };
+    FnDecl &get_decl() { return *decl; };
+    ScopeExpr &get_body_scope() { return *body; };
+    // Parameters come first, followed by the variables in order of
+    // declaration
+    unsigned get_num_locals() const { return num_locals; };
+    void set_num_locals(unsigned num_locals) {
+        this->num_locals = num_locals;
+    };
+    // Creates arrays, which live in its frame. Slices of them may be passed
+    // to calls in tail position, so those cannot reuse the frame.
+    bool has_local_arrays() const { return local_arrays; };
+    void set_local_arrays(bool local_arrays) {
+        this->local_arrays = local_arrays;
+    };
 
     ACCEPT(StatementVis);
+    ACCEPT_MUT(MutStatementVis);
 
   private:
-    std::unique_ptr<FnDecl> decl;
-    std::unique_ptr<ScopeExpr> body;
+    FnDecl *decl;
+    ScopeExpr *body;
+    unsigned num_locals{0};
+    bool local_arrays{false};
 };
 
 #endif
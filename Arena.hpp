@@ -0,0 +1,98 @@
+#ifndef HXWK_ARENA_H
+#define HXWK_ARENA_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Non-owning view of a contiguous array, typically allocated in an Arena.
+template <typename T>
+class Span {
+  public:
+    Span() = default;
+    Span(T *data, std::size_t size) : data_{data}, size_{size} {};
+
+    T *begin() const { return data_; };
+    T *end() const { return data_ + size_; };
+    std::size_t size() const { return size_; };
+    bool empty() const { return size_ == 0; };
+    T &operator[](std::size_t i) const { return data_[i]; };
+    T &back() const { return data_[size_ - 1]; };
+
+  private:
+    T *data_{nullptr};
+    std::size_t size_{0};
+};
+
+// Bump allocator for objects sharing one lifetime, such as all nodes of a
+// syntax tree. Objects are never freed individually; reset() releases all of
+// them at once, keeping the first slab around for reuse. Destructors are only
+// recorded and run for types that actually need one.
+class Arena {
+  public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() { run_dtors(); };
+
+    template <typename T, typename... Args>
+    T *make(Args &&... args) {
+        auto *obj = new (alloc.Allocate(sizeof(T), alignof(T)))
+                T(std::forward<Args>(args)...);
+        register_dtor(obj);
+        return obj;
+    }
+
+    // Copies the elements of a vector under construction into the arena
+    template <typename T>
+    Span<T> copy(const llvm::SmallVectorImpl<T> &elems) {
+        if (elems.empty())
+            return {};
+
+        auto *data = static_cast<T *>(
+                alloc.Allocate(elems.size() * sizeof(T), alignof(T)));
+        for (std::size_t i = 0; i < elems.size(); ++i)
+            register_dtor(new (data + i) T(elems[i]));
+        return {data, elems.size()};
+    }
+
+    void reset() {
+        run_dtors();
+        alloc.Reset();
+    };
+
+    std::size_t get_bytes_allocated() const {
+        return alloc.getBytesAllocated();
+    };
+
+  private:
+    struct Dtor {
+        void (*fn)(void *);
+        void *obj;
+    };
+
+    template <typename T>
+    typename std::enable_if<std::is_trivially_destructible<T>::value>::type
+    register_dtor(T *) {}
+
+    template <typename T>
+    typename std::enable_if<!std::is_trivially_destructible<T>::value>::type
+    register_dtor(T *obj) {
+        dtors.push_back({[](void *obj) { static_cast<T *>(obj)->~T(); }, obj});
+    }
+
+    void run_dtors() {
+        for (auto i = dtors.rbegin(); i != dtors.rend(); ++i)
+            i->fn(i->obj);
+        dtors.clear();
+    };
+
+    llvm::BumpPtrAllocator alloc;
+    std::vector<Dtor> dtors;
+};
+
+#endif
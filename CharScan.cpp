@@ -0,0 +1,87 @@
+#include "CharScan.hpp"
+#include "CharScanKernels.hpp"
+
+#ifdef HXWK_SCAN_X86
+#include <emmintrin.h>
+
+const char *skip_space_avx2(const char *begin, const char *end);
+const char *skip_alnum_avx2(const char *begin, const char *end);
+const char *skip_digits_avx2(const char *begin, const char *end);
+
+namespace {
+
+struct SSE2 {
+    using V = __m128i;
+    static constexpr int width = 16;
+
+    static __m128i load(const char *p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+
+    static __m128i in_range(__m128i v, char lo, char n) {
+        auto biased = _mm_add_epi8(v, _mm_set1_epi8(char(-128 - lo)));
+        return _mm_cmplt_epi8(biased, _mm_set1_epi8(char(-128 + n)));
+    }
+
+    static __m128i either(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+
+    static __m128i fold_case(__m128i v) {
+        return _mm_or_si128(v, _mm_set1_epi8(0x20));
+    }
+
+    static __m128i equal(__m128i v, char c) {
+        return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+    }
+
+    static std::uint32_t mask(__m128i v) {
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(v));
+    }
+};
+
+const char *skip_space_sse2(const char *begin, const char *end) {
+    return skip_vector<SSE2, SpaceClass, is_space>(begin, end);
+}
+
+const char *skip_alnum_sse2(const char *begin, const char *end) {
+    return skip_vector<SSE2, AlnumClass, is_alnum>(begin, end);
+}
+
+const char *skip_digits_sse2(const char *begin, const char *end) {
+    return skip_vector<SSE2, DigitClass, is_digit>(begin, end);
+}
+
+}
+#endif
+
+const CharScanner &CharScanner::scalar() {
+    static const CharScanner scanner{"scalar", skip_scalar<is_space>,
+                                     skip_scalar<is_alnum>,
+                                     skip_scalar<is_digit>};
+    return scanner;
+}
+
+const CharScanner *CharScanner::sse2() {
+#ifdef HXWK_SCAN_X86
+    static const CharScanner scanner{"sse2", skip_space_sse2, skip_alnum_sse2,
+                                     skip_digits_sse2};
+    return &scanner;
+#else
+    return nullptr;
+#endif
+}
+
+const CharScanner *CharScanner::avx2() {
+#ifdef HXWK_SCAN_X86
+    static const CharScanner scanner{"avx2", skip_space_avx2, skip_alnum_avx2,
+                                     skip_digits_avx2};
+    return __builtin_cpu_supports("avx2") ? &scanner : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+const CharScanner &CharScanner::best() {
+    static const CharScanner &scanner
+            = avx2() ? *avx2() : sse2() ? *sse2() : scalar();
+    return scanner;
+}
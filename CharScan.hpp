@@ -0,0 +1,25 @@
+#ifndef HXWK_CHARSCAN_H
+#define HXWK_CHARSCAN_H
+
+// Kernels skipping runs of one character class in [begin, end). Each returns
+// a pointer to the first character not in the class, or `end`. Besides the
+// portable scalar version there are SSE2 and AVX2 versions on x86; best()
+// picks the widest one the running CPU supports.
+struct CharScanner {
+    using Kernel = const char *(*)(const char *begin, const char *end);
+
+    const char *name;
+    // Whitespace as classified by std::isspace in the "C" locale
+    Kernel skip_space;
+    // [0-9A-Za-z]
+    Kernel skip_alnum;
+    // [0-9]
+    Kernel skip_digits;
+
+    static const CharScanner &scalar();
+    static const CharScanner *sse2();
+    static const CharScanner *avx2();
+    static const CharScanner &best();
+};
+
+#endif
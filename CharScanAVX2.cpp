@@ -0,0 +1,54 @@
+// Compiled with -mavx2, see CMakeLists.txt. Only reached through
+// CharScanner::avx2(), which checks for CPU support first.
+
+#include "CharScanKernels.hpp"
+
+#ifdef HXWK_SCAN_X86
+#include <immintrin.h>
+
+namespace {
+
+struct AVX2 {
+    using V = __m256i;
+    static constexpr int width = 32;
+
+    static __m256i load(const char *p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+
+    static __m256i in_range(__m256i v, char lo, char n) {
+        auto biased = _mm256_add_epi8(v, _mm256_set1_epi8(char(-128 - lo)));
+        return _mm256_cmpgt_epi8(_mm256_set1_epi8(char(-128 + n)), biased);
+    }
+
+    static __m256i either(__m256i a, __m256i b) {
+        return _mm256_or_si256(a, b);
+    }
+
+    static __m256i fold_case(__m256i v) {
+        return _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    }
+
+    static __m256i equal(__m256i v, char c) {
+        return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+    }
+
+    static std::uint32_t mask(__m256i v) {
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(v));
+    }
+};
+
+}
+
+const char *skip_space_avx2(const char *begin, const char *end) {
+    return skip_vector<AVX2, SpaceClass, is_space>(begin, end);
+}
+
+const char *skip_alnum_avx2(const char *begin, const char *end) {
+    return skip_vector<AVX2, AlnumClass, is_alnum>(begin, end);
+}
+
+const char *skip_digits_avx2(const char *begin, const char *end) {
+    return skip_vector<AVX2, DigitClass, is_digit>(begin, end);
+}
+#endif
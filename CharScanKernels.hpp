@@ -0,0 +1,84 @@
+#ifndef HXWK_CHARSCANKERNELS_H
+#define HXWK_CHARSCANKERNELS_H
+
+// Building blocks for the CharScanner kernels. This header is included by
+// translation units compiled for different instruction sets, so everything
+// in it has internal linkage: the linker must never pick an AVX2-compiled
+// copy of a helper for the baseline kernels.
+
+#include <cstdint>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define HXWK_SCAN_X86
+#endif
+
+namespace {
+
+inline bool is_space(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool is_digit(unsigned char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+inline bool is_alnum(unsigned char c) {
+    return is_digit(c) || static_cast<unsigned char>((c | 0x20) - 'a') < 26;
+}
+
+template <bool (*Pred)(unsigned char)>
+const char *skip_scalar(const char *begin, const char *end) {
+    while (begin != end && Pred(static_cast<unsigned char>(*begin)))
+        ++begin;
+    return begin;
+}
+
+// Each instruction set provides a struct with the register type V and
+// width, load, in_range, either, fold_case, equal and mask operations on it.
+// The struct rather than V keys the templates below, as the attributes of
+// vector types are lost on template arguments. Ranges are tested with one
+// signed comparison each by biasing [lo, lo + n) onto [-128, -128 + n).
+template <typename C>
+struct SpaceClass {
+    static typename C::V match(typename C::V v) {
+        return C::either(C::equal(v, ' '), C::in_range(v, '\t', 5));
+    }
+};
+
+template <typename C>
+struct DigitClass {
+    static typename C::V match(typename C::V v) {
+        return C::in_range(v, '0', 10);
+    }
+};
+
+template <typename C>
+struct AlnumClass {
+    static typename C::V match(typename C::V v) {
+        return C::either(C::in_range(v, '0', 10),
+                         C::in_range(C::fold_case(v), 'a', 26));
+    }
+};
+
+// Classifies a whole register at once and locates the first byte outside the
+// class through the inverted comparison mask. Only whole registers are
+// loaded, the remainder is handled by the scalar loop, so this never reads
+// past `end`.
+template <typename C, template <typename> class Class,
+          bool (*Pred)(unsigned char)>
+inline const char *skip_vector(const char *begin, const char *end) {
+    constexpr std::uint32_t all
+            = C::width == 32 ? ~std::uint32_t{0} : (1u << C::width) - 1;
+
+    while (end - begin >= C::width) {
+        auto outside = ~C::mask(Class<C>::match(C::load(begin))) & all;
+        if (outside != 0)
+            return begin + __builtin_ctz(outside);
+        begin += C::width;
+    }
+    return skip_scalar<Pred>(begin, end);
+}
+
+}
+
+#endif
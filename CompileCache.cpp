@@ -0,0 +1,203 @@
+#include "CompileCache.hpp"
+#include "Log.hpp"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Any rebuild of the compiler may change its output, so it invalidates all
+// entries. Whichever source file changed, the executable did too, so its
+// hash stands for the version. LLVM is linked dynamically and named apart.
+static const std::string &get_compiler_version() {
+    static const std::string version = [] {
+        static int anchor;
+        // The name only serves as a fallback for looking up the executable
+        const auto exe = llvm::sys::fs::getMainExecutable("hxwk", &anchor);
+        auto contents = llvm::MemoryBuffer::getFile(exe);
+        // A compiler which cannot be identified trusts no earlier entries
+        if (!contents)
+            return "unknown "
+                   + std::to_string(llvm::sys::Process::getProcessId()) + " "
+                   + std::to_string(llvm::sys::Process::GetRandomNumber());
+        llvm::SHA1 hash;
+        hash.update((*contents)->getBuffer());
+        return "hxwk " + llvm::toHex(hash.final(), true)
+               + " LLVM " LLVM_VERSION_STRING;
+    }();
+    return version;
+}
+
+static const unsigned key_length = 40;
+
+static bool is_key(llvm::StringRef name) {
+    return name.size() == key_length
+           && name.find_first_not_of("0123456789abcdef")
+                      == llvm::StringRef::npos;
+}
+
+std::unique_ptr<CompileCache> CompileCache::open(llvm::StringRef dir,
+                                                 uint64_t max_bytes) {
+    if (auto err = llvm::sys::fs::create_directories(dir)) {
+        Log::error("Cannot create cache directory `", dir.str(),
+                   "`: ", err.message());
+        return nullptr;
+    }
+    return std::unique_ptr<CompileCache>{
+            new CompileCache{dir.str(), max_bytes}};
+}
+
+std::string CompileCache::default_dir() {
+    llvm::SmallString<128> path;
+    if (!llvm::sys::path::cache_directory(path))
+        path = ".";
+    llvm::sys::path::append(path, "hxwk");
+    return path.str().str();
+}
+
+std::string CompileCache::make_key(llvm::ArrayRef<llvm::StringRef> parts) {
+    llvm::SHA1 hash;
+    auto add = [&hash](llvm::StringRef part) {
+        // Length prefixes keep ("ab", "c") and ("a", "bc") apart
+        uint8_t size[8];
+        llvm::support::endian::write64le(size, part.size());
+        hash.update(size);
+        hash.update(part);
+    };
+
+    add(get_compiler_version());
+    for (auto part : parts)
+        add(part);
+    return llvm::toHex(hash.final(), true);
+}
+
+std::string CompileCache::get_path(llvm::StringRef key) const {
+    llvm::SmallString<128> path{dir};
+    llvm::sys::path::append(path, key);
+    return path.str().str();
+}
+
+std::unique_ptr<llvm::MemoryBuffer> CompileCache::lookup(llvm::StringRef key) {
+    if (missed.count(key))
+        return nullptr;
+
+    int fd;
+    if (llvm::sys::fs::openFileForRead(get_path(key), fd)) {
+        ++stats.misses;
+        missed.insert(key);
+        return nullptr;
+    }
+
+    auto buffer = llvm::MemoryBuffer::getOpenFile(
+            llvm::sys::fs::convertFDToNativeFile(fd), key, -1);
+    // Eviction goes by modification time, so a hit keeps an entry alive
+    if (buffer)
+        llvm::sys::fs::setLastAccessAndModificationTime(
+                fd, std::chrono::system_clock::now());
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+    if (!buffer) {
+        ++stats.misses;
+        missed.insert(key);
+        return nullptr;
+    }
+    ++stats.hits;
+    return std::move(*buffer);
+}
+
+void CompileCache::store(llvm::StringRef key, llvm::StringRef data) {
+    // Concurrent compilers must never see half-written entries, so the
+    // entry is written to a temporary file first and then renamed
+    llvm::SmallString<128> model{dir};
+    llvm::sys::path::append(model, "tmp-%%%%%%%%");
+    int fd;
+    llvm::SmallString<128> tmp_path;
+    if (llvm::sys::fs::createUniqueFile(model, fd, tmp_path))
+        return;
+
+    {
+        llvm::raw_fd_ostream out{fd, true};
+        out << data;
+        out.close();
+        if (out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmp_path);
+            return;
+        }
+    }
+
+    if (llvm::sys::fs::rename(tmp_path, get_path(key))) {
+        llvm::sys::fs::remove(tmp_path);
+        return;
+    }
+    ++stats.stored;
+    missed.erase(key);
+}
+
+void CompileCache::evict() {
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        llvm::sys::TimePoint<> mtime;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+
+    std::error_code err;
+    for (llvm::sys::fs::directory_iterator it{dir, err}, end;
+         it != end && !err; it.increment(err)) {
+        if (!is_key(llvm::sys::path::filename(it->path())))
+            continue;
+        llvm::sys::fs::file_status status;
+        if (llvm::sys::fs::status(it->path(), status))
+            continue;
+        entries.push_back({it->path(), status.getSize(),
+                           status.getLastModificationTime()});
+        total += status.getSize();
+    }
+
+    if (total <= max_bytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &lhs, const Entry &rhs) {
+                  return lhs.mtime < rhs.mtime;
+              });
+    for (const auto &entry : entries) {
+        if (total <= max_bytes)
+            break;
+        if (llvm::sys::fs::remove(entry.path))
+            continue;
+        total -= entry.size;
+        ++stats.evicted;
+    }
+}
+
+void CompileCache::print_stats() const {
+    std::cerr << "cache: " << stats.hits << " hits, " << stats.misses
+              << " misses, " << stats.stored << " stored, " << stats.evicted
+              << " evicted\n";
+}
+
+void CompileCache::notifyObjectCompiled(const llvm::Module *module,
+                                        llvm::MemoryBufferRef object) {
+    store(get_object_key(module->getModuleIdentifier()), object.getBuffer());
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+CompileCache::getObject(const llvm::Module *module) {
+    return lookup(get_object_key(module->getModuleIdentifier()));
+}
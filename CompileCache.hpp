@@ -0,0 +1,76 @@
+#ifndef HXWK_COMPILECACHE_H
+#define HXWK_COMPILECACHE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace llvm {
+class Module;
+}
+
+// Content-addressed store for compiler output in a directory. Keys are SHA-1
+// hashes of everything the output depends on; entries are single files named
+// after their key. Once the directory grows past its size limit, the least
+// recently used entries are deleted.
+//
+// The JIT uses the cache through the llvm::ObjectCache interface, which
+// hashes a module's identifier into its key. The identifier therefore has to
+// stand for everything the module's object code depends on.
+class CompileCache : public llvm::ObjectCache {
+  public:
+    struct Stats {
+        unsigned hits{0};
+        unsigned misses{0};
+        unsigned stored{0};
+        unsigned evicted{0};
+    };
+
+    // Returns nullptr after reporting an error if `dir` cannot be created
+    static std::unique_ptr<CompileCache> open(llvm::StringRef dir,
+                                              uint64_t max_bytes);
+    // The default directory is `hxwk` inside the user's cache directory
+    static std::string default_dir();
+
+    // Hashes `parts` along with the compiler's own version
+    static std::string make_key(llvm::ArrayRef<llvm::StringRef> parts);
+    // The key the JIT's object code for a module with `module_id` is filed
+    // under
+    static std::string get_object_key(llvm::StringRef module_id) {
+        return make_key({"object", module_id});
+    };
+
+    // Returns nullptr on a miss. A key that missed once keeps missing until
+    // it is stored, without asking the file system again.
+    std::unique_ptr<llvm::MemoryBuffer> lookup(llvm::StringRef key);
+    // Failing to store is not an error, the entry is simply missing next time
+    void store(llvm::StringRef key, llvm::StringRef data);
+    // Deletes the least recently used entries until the limit is respected
+    void evict();
+
+    const Stats &get_stats() const { return stats; };
+    void print_stats() const;
+
+    void notifyObjectCompiled(const llvm::Module *module,
+                              llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer>
+    getObject(const llvm::Module *module) override;
+
+  private:
+    CompileCache(std::string dir, uint64_t max_bytes)
+            : dir{std::move(dir)}, max_bytes{max_bytes} {};
+
+    std::string get_path(llvm::StringRef key) const;
+
+    std::string dir;
+    uint64_t max_bytes;
+    llvm::StringSet<> missed;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,537 @@
+#include "ConstFold.hpp"
+#include "llvm/Support/Casting.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Deep recursion would exhaust the stack long before the step budget
+constexpr unsigned max_depth = 256;
+
+}
+
+void ConstFolder::run(llvm::ArrayRef<FnDef *> defs) {
+    for (const auto *def : defs)
+        fns[def->get_decl().get_id().get_id()] = def;
+
+    for (auto *def : defs) {
+        std::vector<Constant> locals(def->get_num_locals());
+        ConstFoldVis body{*this, locals};
+        def->get_body_scope().accept(body);
+    }
+}
+
+Expr *ConstFolder::fold(Expr &expr, std::vector<Constant> &locals,
+                        Constant &val) {
+    ConstFoldVis vis{*this, locals};
+    expr.accept(vis);
+    val = vis.get_val();
+    return vis.get_replacement() ? vis.get_replacement() : &expr;
+}
+
+Constant ConstFolder::call(Symbol id, llvm::ArrayRef<Constant> args) {
+    auto fn = fns.find(id.get_id());
+    if (fn == fns.end() || depth == max_depth)
+        return {};
+    const auto &def = *fn->second;
+    // Anything touching memory fails to evaluate anyway
+    if (def.get_decl().get_effects().memory != FnEffects::Memory::NONE)
+        return {};
+
+    std::vector<Constant> locals(def.get_num_locals());
+    std::copy(args.begin(), args.end(), locals.begin());
+
+    ++depth;
+    ConstEvalVis body{*this, locals};
+    def.get_body_scope().accept(body);
+    --depth;
+
+    const auto *ret_type = def.get_decl().get_ret_type();
+    if (!body.get_val().type || !llvm::isa<VoidType>(ret_type))
+        return body.get_val();
+    return {ret_type, 0, 0};
+}
+
+Expr *ConstFolder::make_literal(const Constant &val) {
+    Expr *literal;
+    if (llvm::isa<BoolType>(val.type))
+        literal = arena.make<LiteralExpr<bool>>(val.i != 0);
+    else if (llvm::isa<Int32Type>(val.type))
+        literal = arena.make<LiteralExpr<int32_t>>(val.i);
+    else if (!get_arith_traits(*val.type)->is_float)
+        literal = arena.make<LiteralExpr<int64_t>>(val.i);
+    else
+        literal = arena.make<LiteralExpr<double>>(val.d);
+    literal->set_type(val.type);
+    return literal;
+}
+
+Constant ConstFolder::make_int(const Type *type, uint64_t i) const {
+    const auto bits = get_arith_traits(*type)->bits;
+    if (bits < 64) {
+        const auto mask = (uint64_t{1} << bits) - 1;
+        i &= mask;
+        if (get_arith_traits(*type)->is_signed && (i >> (bits - 1)) != 0)
+            i |= ~mask;
+    }
+    return {type, static_cast<int64_t>(i), 0};
+}
+
+// Mirrors the instructions IRGenerator emits. Operations which are undefined
+// at run time are not folded.
+Constant ConstFolder::fold_binary(Tok op, const Constant &lhs,
+                                  const Constant &rhs) const {
+    const auto &traits = *get_arith_traits(*lhs.type);
+    if (traits.is_float) {
+        switch (op) {
+            case Tok::PLUS:
+                return make_fp(lhs.type, lhs.d + rhs.d);
+            case Tok::MINUS:
+                return make_fp(lhs.type, lhs.d - rhs.d);
+            case Tok::MULT:
+                return make_fp(lhs.type, lhs.d * rhs.d);
+            case Tok::SLASH:
+                return make_fp(lhs.type, lhs.d / rhs.d);
+            case Tok::CMP_LT:
+                // Unordered or less than
+                return make_bool(!(lhs.d >= rhs.d));
+            default:
+                return {};
+        }
+    }
+
+    // Integers wrap around, the instructions carry no overflow flags. Bools
+    // are unsigned integers of a single bit.
+    const auto l = static_cast<uint64_t>(lhs.i);
+    const auto r = static_cast<uint64_t>(rhs.i);
+    switch (op) {
+        case Tok::PLUS:
+            return make_int(lhs.type, l + r);
+        case Tok::MINUS:
+            return make_int(lhs.type, l - r);
+        case Tok::MULT:
+            return make_int(lhs.type, l * r);
+        case Tok::SLASH: {
+            if (r == 0)
+                return {};
+            if (!traits.is_signed)
+                return make_int(lhs.type, l / r);
+            const auto min = static_cast<int64_t>(~uint64_t{0}
+                                                  << (traits.bits - 1));
+            if (lhs.i == min && rhs.i == -1)
+                return {};
+            return make_int(lhs.type, lhs.i / rhs.i);
+        }
+        case Tok::CMP_LT:
+            return make_bool(traits.is_signed ? lhs.i < rhs.i : l < r);
+        default:
+            return {};
+    }
+}
+
+// Mirrors IRGenerator::arit_cast
+Constant ConstFolder::fold_cast(const Constant &val, const Type &to) const {
+    if (val.type == &to)
+        return val;
+    // Vectors are not represented as constants, splats are left to run time
+    if (!get_arith_traits(to))
+        return {};
+
+    const auto &from_traits = *get_arith_traits(*val.type);
+    const auto &to_traits = *get_arith_traits(to);
+    if (to_traits.is_float) {
+        if (from_traits.is_float)
+            return make_fp(&to, val.d);
+        // Unsigned values are zero extended, so all fit the signed `i`
+        if (llvm::isa<FloatType>(to))
+            return make_fp(&to, static_cast<float>(val.i));
+        return make_fp(&to, static_cast<double>(val.i));
+    }
+
+    // Truncation and both kinds of extension, as `i` is already extended
+    // according to the signedness of `from`
+    if (!from_traits.is_float)
+        return make_int(&to, static_cast<uint64_t>(val.i));
+
+    // fptosi and fptoui only yield a value if the truncated value fits
+    const auto bits = to_traits.bits - to_traits.is_signed;
+    const double upper = std::ldexp(1.0, bits);
+    const double lower = to_traits.is_signed ? -upper - 1 : -1;
+    if (!(val.d > lower && val.d < upper))
+        return {};
+    return make_int(&to, static_cast<uint64_t>(static_cast<int64_t>(val.d)));
+}
+
+void ConstEvalVis::visit(const LiteralExpr<bool> &expr) {
+    val = folder.step() ? folder.make_bool(expr.get_val()) : Constant{};
+}
+
+void ConstEvalVis::visit(const LiteralExpr<int32_t> &expr) {
+    val = folder.step() ? folder.make_int(expr.get_type(), expr.get_val())
+                        : Constant{};
+}
+
+void ConstEvalVis::visit(const LiteralExpr<int64_t> &expr) {
+    val = folder.step() ? folder.make_int(expr.get_type(), expr.get_val())
+                        : Constant{};
+}
+
+void ConstEvalVis::visit(const LiteralExpr<double> &expr) {
+    val = folder.step() ? folder.make_fp(expr.get_type(), expr.get_val())
+                        : Constant{};
+}
+
+void ConstEvalVis::visit(const LiteralExpr<Symbol> &) {
+    val = {};
+}
+
+void ConstEvalVis::visit(const IdExpr &expr) {
+    val = folder.step() ? locals[expr.get_local()] : Constant{};
+}
+
+void ConstEvalVis::visit(const BinaryExpr &expr) {
+    val = {};
+    if (!folder.step())
+        return;
+
+    ConstEvalVis lhs{folder, locals}, rhs{folder, locals};
+    expr.get_lhs().accept(lhs);
+    if (!lhs.get_val().type)
+        return;
+    expr.get_rhs().accept(rhs);
+    if (!rhs.get_val().type)
+        return;
+
+    val = folder.fold_binary(expr.get_op(), lhs.get_val(), rhs.get_val());
+}
+
+void ConstEvalVis::visit(const CallExpr &expr) {
+    val = {};
+    if (!folder.step())
+        return;
+
+    std::vector<Constant> args;
+    for (const auto *arg : expr.get_args()) {
+        ConstEvalVis arg_vis{folder, locals};
+        arg->accept(arg_vis);
+        if (!arg_vis.get_val().type)
+            return;
+        args.push_back(arg_vis.get_val());
+    }
+
+    val = folder.call(expr.get_id(), args);
+}
+
+void ConstEvalVis::visit(const ScopeExpr &expr) {
+    val = {};
+    if (!folder.step())
+        return;
+
+    const auto &body = expr.get_body();
+    bool explicit_void = !body.empty() && !body.back();
+
+    ConstEvalStatementVis body_vis{folder, locals};
+    for (auto i = body.begin(); i != body.end() - explicit_void; ++i) {
+        (*i)->accept(body_vis);
+        if (!body_vis.get_val().type)
+            return;
+    }
+
+    if (body.empty() || explicit_void)
+        val = {folder.types.get_void(), 0, 0};
+    else
+        val = body_vis.get_val();
+}
+
+void ConstEvalVis::visit(const IfExpr &expr) {
+    val = {};
+    if (!folder.step())
+        return;
+
+    ConstEvalVis cond{folder, locals};
+    expr.get_cond().accept(cond);
+    if (!cond.get_val().type)
+        return;
+
+    ConstEvalVis taken{folder, locals};
+    if (cond.get_val().i)
+        expr.get_then().accept(taken);
+    else
+        expr.get_else().accept(taken);
+    val = taken.get_val();
+}
+
+void ConstEvalVis::visit(const CastExpr &expr) {
+    val = {};
+    if (!folder.step())
+        return;
+
+    ConstEvalVis operand{folder, locals};
+    expr.get_operand().accept(operand);
+    if (operand.get_val().type)
+        val = folder.fold_cast(operand.get_val(), *expr.get_type());
+}
+
+void ConstEvalVis::visit(const AssignExpr &expr) {
+    val = {};
+    if (!folder.step())
+        return;
+
+    ConstEvalVis value{folder, locals};
+    expr.get_value().accept(value);
+    if (!value.get_val().type)
+        return;
+
+    locals[expr.get_local()] = value.get_val();
+    val = {folder.types.get_void(), 0, 0};
+}
+
+void ConstEvalVis::visit(const WhileExpr &expr) {
+    val = {};
+    while (folder.step()) {
+        ConstEvalVis cond{folder, locals};
+        expr.get_cond().accept(cond);
+        if (!cond.get_val().type)
+            return;
+        if (!cond.get_val().i) {
+            val = {folder.types.get_void(), 0, 0};
+            return;
+        }
+
+        ConstEvalVis body{folder, locals};
+        expr.get_body().accept(body);
+        if (!body.get_val().type)
+            return;
+    }
+}
+
+void ConstEvalVis::visit(const ForExpr &expr) {
+    val = {};
+    // Reductions start from the identity on each worker
+    if (expr.is_parallel())
+        return;
+
+    ConstEvalVis begin{folder, locals}, end{folder, locals};
+    expr.get_begin().accept(begin);
+    if (!begin.get_val().type)
+        return;
+    expr.get_end().accept(end);
+    if (!end.get_val().type)
+        return;
+
+    // The bounds are extended to 64 bits, which compare alike for all types
+    const auto *counter_type = begin.get_val().type;
+    for (int64_t i = begin.get_val().i; i < end.get_val().i; ++i) {
+        if (!folder.step())
+            return;
+
+        locals[expr.get_local()] = {counter_type, i, 0};
+        ConstEvalVis body{folder, locals};
+        expr.get_body().accept(body);
+        if (!body.get_val().type)
+            return;
+    }
+    val = {folder.types.get_void(), 0, 0};
+}
+
+// Arrays and slices are not represented as constants
+void ConstEvalVis::visit(const IndexExpr &) {
+    val = {};
+}
+
+void ConstEvalVis::visit(const ArrayExpr &) {
+    val = {};
+}
+
+void ConstEvalVis::visit(const NewExpr &) {
+    val = {};
+}
+
+// Spawned calls run on other workers
+void ConstEvalVis::visit(const SpawnExpr &) {
+    val = {};
+}
+
+void ConstEvalVis::visit(const AwaitExpr &) {
+    val = {};
+}
+
+void ConstEvalStatementVis::visit(const Expr &expr) {
+    ConstEvalVis expr_vis{folder, locals};
+    expr.accept(expr_vis);
+    val = expr_vis.get_val();
+}
+
+void ConstEvalStatementVis::visit(const VarDecl &decl) {
+    ConstEvalVis expr_vis{folder, locals};
+    decl.get_rhs().accept(expr_vis);
+    val = expr_vis.get_val();
+    locals[decl.get_local()] = val;
+}
+
+// Not found in scopes
+void ConstEvalStatementVis::visit(const FnDecl &) {
+    val = {};
+}
+
+void ConstEvalStatementVis::visit(const FnDef &) {
+    val = {};
+}
+
+void ConstFoldVis::fold_to(const Constant &val) {
+    this->val = val;
+    if (val.type && !llvm::isa<VoidType>(val.type))
+        replacement = folder.make_literal(val);
+}
+
+void ConstFoldVis::visit(LiteralExpr<bool> &expr) {
+    val = folder.make_bool(expr.get_val());
+}
+
+void ConstFoldVis::visit(LiteralExpr<int32_t> &expr) {
+    val = folder.make_int(expr.get_type(), expr.get_val());
+}
+
+void ConstFoldVis::visit(LiteralExpr<int64_t> &expr) {
+    val = folder.make_int(expr.get_type(), expr.get_val());
+}
+
+void ConstFoldVis::visit(LiteralExpr<double> &expr) {
+    val = folder.make_fp(expr.get_type(), expr.get_val());
+}
+
+void ConstFoldVis::visit(LiteralExpr<Symbol> &) {}
+
+void ConstFoldVis::visit(IdExpr &expr) {
+    fold_to(locals[expr.get_local()]);
+}
+
+void ConstFoldVis::visit(BinaryExpr &expr) {
+    Constant lhs, rhs;
+    expr.set_lhs(folder.fold(expr.get_lhs(), locals, lhs));
+    expr.set_rhs(folder.fold(expr.get_rhs(), locals, rhs));
+    if (lhs.type && rhs.type)
+        fold_to(folder.fold_binary(expr.get_op(), lhs, rhs));
+}
+
+void ConstFoldVis::visit(CallExpr &expr) {
+    std::vector<Constant> args;
+    bool known = true;
+    for (auto &arg : expr.get_args()) {
+        Constant arg_val;
+        arg = folder.fold(*arg, locals, arg_val);
+        known = known && arg_val.type;
+        args.push_back(arg_val);
+    }
+
+    if (!known || !folder.step_budget)
+        return;
+    folder.steps_left = folder.step_budget;
+    fold_to(folder.call(expr.get_id(), args));
+}
+
+void ConstFoldVis::visit(ScopeExpr &expr) {
+    const auto &body = expr.get_body();
+    bool explicit_void = !body.empty() && !body.back();
+
+    ConstFoldStatementVis body_vis{folder, locals};
+    for (auto i = body.begin(); i != body.end() - explicit_void; ++i) {
+        (*i)->accept(body_vis);
+        *i = body_vis.get_replacement();
+    }
+
+    // Earlier statements might have side effects
+    if (body.size() == 1)
+        fold_to(body_vis.get_val());
+}
+
+void ConstFoldVis::visit(IfExpr &expr) {
+    Constant cond;
+    expr.set_cond(folder.fold(expr.get_cond(), locals, cond));
+    if (!cond.type) {
+        ConstFoldVis then{folder, locals}, or_else{folder, locals};
+        expr.get_then().accept(then);
+        expr.get_else().accept(or_else);
+        return;
+    }
+
+    replacement = folder.fold(cond.i ? expr.get_then() : expr.get_else(),
+                              locals, val);
+}
+
+void ConstFoldVis::visit(CastExpr &expr) {
+    Constant operand;
+    expr.set_operand(folder.fold(expr.get_operand(), locals, operand));
+    if (operand.type)
+        fold_to(folder.fold_cast(operand, *expr.get_type()));
+}
+
+void ConstFoldVis::visit(AssignExpr &expr) {
+    Constant value;
+    expr.set_value(folder.fold(expr.get_value(), locals, value));
+}
+
+void ConstFoldVis::visit(WhileExpr &expr) {
+    Constant cond;
+    expr.set_cond(folder.fold(expr.get_cond(), locals, cond));
+    ConstFoldVis body{folder, locals};
+    expr.get_body().accept(body);
+}
+
+void ConstFoldVis::visit(ForExpr &expr) {
+    Constant begin, end;
+    expr.set_begin(folder.fold(expr.get_begin(), locals, begin));
+    expr.set_end(folder.fold(expr.get_end(), locals, end));
+    ConstFoldVis body{folder, locals};
+    expr.get_body().accept(body);
+}
+
+void ConstFoldVis::visit(IndexExpr &expr) {
+    // Arrays and slices never fold, so the base is only folded within
+    Constant base, index;
+    folder.fold(expr.get_base(), locals, base);
+    expr.set_index(folder.fold(expr.get_index(), locals, index));
+}
+
+void ConstFoldVis::visit(ArrayExpr &expr) {
+    for (auto &elem : expr.get_elems()) {
+        Constant elem_val;
+        elem = folder.fold(*elem, locals, elem_val);
+    }
+}
+
+void ConstFoldVis::visit(NewExpr &expr) {
+    Constant size;
+    expr.set_size(folder.fold(expr.get_size(), locals, size));
+}
+
+void ConstFoldVis::visit(SpawnExpr &expr) {
+    // The call stays, its result is only available through the future
+    for (auto &arg : expr.get_call().get_args()) {
+        Constant arg_val;
+        arg = folder.fold(*arg, locals, arg_val);
+    }
+}
+
+void ConstFoldVis::visit(AwaitExpr &) {}
+
+void ConstFoldStatementVis::visit(Expr &expr) {
+    replacement = folder.fold(expr, locals, val);
+}
+
+void ConstFoldStatementVis::visit(VarDecl &decl) {
+    decl.set_rhs(folder.fold(decl.get_rhs(), locals, val));
+    // Mutable variables may change before their uses
+    if (!decl.is_mutable())
+        locals[decl.get_local()] = val;
+    replacement = &decl;
+}
+
+void ConstFoldStatementVis::visit(FnDecl &decl) {
+    replacement = &decl;
+}
+
+void ConstFoldStatementVis::visit(FnDef &def) {
+    replacement = &def;
+}
@@ -0,0 +1,194 @@
+#ifndef HXWK_CONSTFOLD_H
+#define HXWK_CONSTFOLD_H
+
+#include "AST.hpp"
+#include "Arena.hpp"
+#include "Type.hpp"
+#include "VisitorPattern.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Casting.h"
+#include <cstdint>
+#include <vector>
+
+// A value known at compile time
+struct Constant {
+    // Arithmetic or void, nullptr while the value is unknown
+    const Type *type{nullptr};
+    // Holds bools and integers, sign extended for signed types and zero
+    // extended for the others
+    int64_t i{0};
+    // Holds floating point values, rounded to `float` for `f32`
+    double d{0};
+};
+
+// Replaces expressions of a tree annotated by Sema with literals wherever
+// their value is known at compile time. Arithmetic, comparisons, conversions
+// and immutable variables bound to constants are folded, `if` expressions
+// with a constant condition are replaced by the branch taken.
+//
+// Calls with constant arguments to functions which EffectAnalysis found not
+// to access memory are evaluated by interpreting the callee, which fails as
+// soon as it reaches arrays, slices or vectors. Evaluating a call may take
+// `step_budget` steps, which guarantees termination; calls which run out of
+// steps are left for run time.
+class ConstFolder {
+  public:
+    friend class ConstEvalVis;
+    friend class ConstEvalStatementVis;
+    friend class ConstFoldVis;
+    friend class ConstFoldStatementVis;
+    // New literals are allocated in `arena`. A `step_budget` of 0 disables
+    // the evaluation of calls.
+    ConstFolder(TypeContext &types, Arena &arena, unsigned step_budget)
+            : types{types}, arena{arena}, step_budget{step_budget} {};
+
+    void run(llvm::ArrayRef<FnDef *> defs);
+
+  private:
+    // Folds `expr`, returns the expression to replace it with
+    Expr *fold(Expr &expr, std::vector<Constant> &locals, Constant &val);
+    Constant call(Symbol id, llvm::ArrayRef<Constant> args);
+    Expr *make_literal(const Constant &val);
+    Constant make_bool(bool b) const { return {types.get_bool(), b, 0}; };
+    // Wraps `i` around to the width of the integer type `type`
+    Constant make_int(const Type *type, uint64_t i) const;
+    Constant make_fp(const Type *type, double d) const {
+        if (llvm::isa<FloatType>(type))
+            d = static_cast<float>(d);
+        return {type, 0, d};
+    };
+    Constant fold_binary(Tok op, const Constant &lhs,
+                         const Constant &rhs) const;
+    Constant fold_cast(const Constant &val, const Type &to) const;
+    // Counts one step of evaluation, false once the budget is used up
+    bool step() {
+        if (!steps_left)
+            return false;
+        --steps_left;
+        return true;
+    };
+
+    TypeContext &types;
+    Arena &arena;
+    unsigned step_budget;
+    unsigned steps_left{0};
+    unsigned depth{0};
+    // Definitions by symbol id
+    llvm::DenseMap<uint32_t, const FnDef *> fns;
+};
+
+// Evaluates an expression, all locals it refers to have to be known
+class ConstEvalVis : public ExprVis {
+  public:
+    ConstEvalVis(ConstFolder &folder, std::vector<Constant> &locals)
+            : folder{folder}, locals{locals} {};
+
+    VISIT(LiteralExpr<bool>);
+    VISIT(LiteralExpr<int32_t>);
+    VISIT(LiteralExpr<int64_t>);
+    VISIT(LiteralExpr<double>);
+    VISIT(LiteralExpr<Symbol>);
+    VISIT(IdExpr);
+    VISIT(BinaryExpr);
+    VISIT(CallExpr);
+    VISIT(ScopeExpr);
+    VISIT(IfExpr);
+    VISIT(CastExpr);
+    VISIT(AssignExpr);
+    VISIT(WhileExpr);
+    VISIT(ForExpr);
+    VISIT(IndexExpr);
+    VISIT(ArrayExpr);
+    VISIT(NewExpr);
+    VISIT(SpawnExpr);
+    VISIT(AwaitExpr);
+
+    // The value's type is nullptr if it cannot be evaluated
+    const Constant &get_val() const { return val; };
+
+  private:
+    ConstFolder &folder;
+    std::vector<Constant> &locals;
+    Constant val;
+};
+
+class ConstEvalStatementVis : public StatementVis {
+  public:
+    ConstEvalStatementVis(ConstFolder &folder, std::vector<Constant> &locals)
+            : folder{folder}, locals{locals} {};
+
+    VISIT(Expr);
+    VISIT(VarDecl);
+    VISIT(FnDecl);
+    VISIT(FnDef);
+
+    const Constant &get_val() const { return val; };
+
+  private:
+    ConstFolder &folder;
+    std::vector<Constant> &locals;
+    Constant val;
+};
+
+// Folds an expression in place, locals may be unknown
+class ConstFoldVis : public MutExprVis {
+  public:
+    ConstFoldVis(ConstFolder &folder, std::vector<Constant> &locals)
+            : folder{folder}, locals{locals} {};
+
+    VISIT_MUT(LiteralExpr<bool>);
+    VISIT_MUT(LiteralExpr<int32_t>);
+    VISIT_MUT(LiteralExpr<int64_t>);
+    VISIT_MUT(LiteralExpr<double>);
+    VISIT_MUT(LiteralExpr<Symbol>);
+    VISIT_MUT(IdExpr);
+    VISIT_MUT(BinaryExpr);
+    VISIT_MUT(CallExpr);
+    VISIT_MUT(ScopeExpr);
+    VISIT_MUT(IfExpr);
+    VISIT_MUT(CastExpr);
+    VISIT_MUT(AssignExpr);
+    VISIT_MUT(WhileExpr);
+    VISIT_MUT(ForExpr);
+    VISIT_MUT(IndexExpr);
+    VISIT_MUT(ArrayExpr);
+    VISIT_MUT(NewExpr);
+    VISIT_MUT(SpawnExpr);
+    VISIT_MUT(AwaitExpr);
+
+    const Constant &get_val() const { return val; };
+    // The node the visited expression is to be replaced with, if any
+    Expr *get_replacement() const { return replacement; };
+
+  private:
+    // Replaces the visited expression with `val` if it is known
+    void fold_to(const Constant &val);
+
+    ConstFolder &folder;
+    std::vector<Constant> &locals;
+    Constant val;
+    Expr *replacement{nullptr};
+};
+
+class ConstFoldStatementVis : public MutStatementVis {
+  public:
+    ConstFoldStatementVis(ConstFolder &folder, std::vector<Constant> &locals)
+            : folder{folder}, locals{locals} {};
+
+    VISIT_MUT(Expr);
+    VISIT_MUT(VarDecl);
+    VISIT_MUT(FnDecl);
+    VISIT_MUT(FnDef);
+
+    const Constant &get_val() const { return val; };
+    Statement *get_replacement() const { return replacement; };
+
+  private:
+    ConstFolder &folder;
+    std::vector<Constant> &locals;
+    Constant val;
+    Statement *replacement{nullptr};
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "Effects.hpp"
+#include "Type.hpp"
+#include "llvm/Support/Casting.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Effects of a call to either function
+void join(FnEffects &into, const FnEffects &from) {
+    into.memory = std::max(into.memory, from.memory);
+    into.unwinds = into.unwinds || from.unwinds;
+    into.terminates = into.terminates && from.terminates;
+    into.may_trap = into.may_trap || from.may_trap;
+}
+
+}
+
+void EffectAnalysis::run(llvm::ArrayRef<FnDecl *> decls,
+                         llvm::ArrayRef<FnDef *> defs) {
+    indices.clear();
+    externs.clear();
+    summaries.assign(defs.size(), {});
+    components.clear();
+
+    for (unsigned i = 0; i < defs.size(); ++i)
+        indices[defs[i]->get_decl().get_id().get_id()] = i;
+    for (const auto *decl : decls)
+        if (!indices.count(decl->get_id().get_id()))
+            externs.insert(decl->get_id().get_id());
+
+    for (unsigned i = 0; i < defs.size(); ++i) {
+        EffectVis body{*this, summaries[i]};
+        defs[i]->get_body_scope().accept(body);
+    }
+
+    // Callees are done before their callers, except within a component
+    const auto component = find_components();
+    std::vector<FnEffects> effects(defs.size());
+    // Whether a call may reach a function which is only declared
+    std::vector<char> reaches_extern(defs.size(), false);
+    for (unsigned c = 0; c < components.size(); ++c) {
+        const auto &members = components[c];
+        auto joined = summaries[members.front()].effects;
+        bool reaches = false;
+        bool recursive = members.size() > 1;
+        for (const auto member : members) {
+            join(joined, summaries[member].effects);
+            reaches = reaches || summaries[member].calls_extern;
+            for (const auto callee : summaries[member].callees) {
+                if (component[callee] != c) {
+                    join(joined, effects[callee]);
+                    reaches = reaches || reaches_extern[callee];
+                } else if (callee == member) {
+                    recursive = true;
+                }
+            }
+        }
+        // Functions which are only declared may call back by name
+        recursive = recursive || reaches;
+        joined.recursive = recursive;
+        joined.terminates = joined.terminates && !recursive;
+        for (const auto member : members) {
+            effects[member] = joined;
+            reaches_extern[member] = reaches;
+        }
+    }
+
+    for (unsigned i = 0; i < defs.size(); ++i)
+        defs[i]->get_decl().set_effects(effects[i]);
+    // The first declaration may be a statement of its own
+    for (auto *decl : decls) {
+        auto def = indices.find(decl->get_id().get_id());
+        if (def != indices.end())
+            decl->set_effects(effects[def->second]);
+    }
+}
+
+// Tarjan's algorithm, with an explicit stack of the definitions being visited
+std::vector<unsigned> EffectAnalysis::find_components() {
+    constexpr unsigned unvisited = ~0u;
+    std::vector<unsigned> component(summaries.size(), unvisited);
+    std::vector<unsigned> order(summaries.size(), unvisited);
+    std::vector<unsigned> low(summaries.size(), 0);
+    // Visited definitions not yet assigned to a component
+    std::vector<unsigned> stack;
+    // Definitions being visited, along with the next callee to follow
+    std::vector<std::pair<unsigned, unsigned>> path;
+    unsigned next_order = 0;
+
+    auto enter = [&](unsigned def) {
+        order[def] = low[def] = next_order++;
+        stack.push_back(def);
+        path.push_back({def, 0});
+    };
+
+    for (unsigned root = 0; root < summaries.size(); ++root) {
+        if (order[root] != unvisited)
+            continue;
+        enter(root);
+        while (!path.empty()) {
+            const auto def = path.back().first;
+            const auto &callees = summaries[def].callees;
+            if (path.back().second < callees.size()) {
+                const auto callee = callees[path.back().second++];
+                if (order[callee] == unvisited)
+                    enter(callee);
+                else if (component[callee] == unvisited)
+                    low[def] = std::min(low[def], order[callee]);
+                continue;
+            }
+
+            path.pop_back();
+            if (!path.empty()) {
+                auto &caller_low = low[path.back().first];
+                caller_low = std::min(caller_low, low[def]);
+            }
+            if (low[def] != order[def])
+                continue;
+
+            components.emplace_back();
+            unsigned member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                component[member] = components.size() - 1;
+                components.back().push_back(member);
+            } while (member != def);
+        }
+    }
+    return component;
+}
+
+void EffectVis::access(FnEffects::Memory memory) {
+    summary.effects.memory = std::max(summary.effects.memory, memory);
+}
+
+// C and the runtime return and never unwind, the runtime's state and output
+// count as memory
+void EffectVis::call_out() {
+    access(FnEffects::Memory::WRITE);
+}
+
+void EffectVis::call(Symbol id) {
+    auto callee = analysis.indices.find(id.get_id());
+    if (callee != analysis.indices.end()) {
+        summary.callees.push_back(callee->second);
+        return;
+    }
+    // `printf` is the only function not declared by the program
+    if (!analysis.externs.count(id.get_id()))
+        return call_out();
+    // Nothing is known about functions which are only declared
+    join(summary.effects, FnEffects{});
+    summary.calls_extern = true;
+}
+
+void EffectVis::visit(const LiteralExpr<bool> &) {}
+
+void EffectVis::visit(const LiteralExpr<int32_t> &) {}
+
+void EffectVis::visit(const LiteralExpr<int64_t> &) {}
+
+void EffectVis::visit(const LiteralExpr<double> &) {}
+
+void EffectVis::visit(const LiteralExpr<Symbol> &) {}
+
+// Arrays live in the frame of the function declaring them
+void EffectVis::visit(const IdExpr &) {}
+
+void EffectVis::visit(const BinaryExpr &expr) {
+    expr.get_lhs().accept(*this);
+    expr.get_rhs().accept(*this);
+}
+
+void EffectVis::visit(const CallExpr &expr) {
+    for (const auto *arg : expr.get_args())
+        arg->accept(*this);
+
+    switch (expr.get_builtin()) {
+        case Builtin::NONE:
+            return call(expr.get_id());
+        case Builtin::FREE:
+            return call_out();
+        case Builtin::EXTRACT:
+        case Builtin::INSERT:
+            summary.effects.may_trap = true;
+            return;
+        case Builtin::LOAD:
+            if (llvm::isa<SliceType>(expr.get_args()[0]->get_type()))
+                access(FnEffects::Memory::READ);
+            summary.effects.may_trap = true;
+            return;
+        case Builtin::STORE:
+            access(FnEffects::Memory::WRITE);
+            summary.effects.may_trap = true;
+            return;
+        default:
+            return;
+    }
+}
+
+void EffectVis::visit(const ScopeExpr &expr) {
+    EffectStatementVis body_vis{analysis, summary};
+    for (const auto *statement : expr.get_body())
+        if (statement)
+            statement->accept(body_vis);
+}
+
+void EffectVis::visit(const IfExpr &expr) {
+    expr.get_cond().accept(*this);
+    expr.get_then().accept(*this);
+    expr.get_else().accept(*this);
+}
+
+void EffectVis::visit(const CastExpr &expr) {
+    expr.get_operand().accept(*this);
+}
+
+// Elements of arrays belong to the variable assigned to, elements of slices
+// do not
+void EffectVis::visit(const AssignExpr &expr) {
+    expr.get_target().accept(*this);
+    expr.get_value().accept(*this);
+    const auto *element = expr.get_element();
+    if (element && llvm::isa<SliceType>(element->get_base().get_type()))
+        access(FnEffects::Memory::WRITE);
+}
+
+void EffectVis::visit(const WhileExpr &expr) {
+    expr.get_cond().accept(*this);
+    expr.get_body().accept(*this);
+    summary.effects.terminates = false;
+}
+
+void EffectVis::visit(const ForExpr &expr) {
+    expr.get_begin().accept(*this);
+    expr.get_end().accept(*this);
+    expr.get_body().accept(*this);
+    if (!expr.get_range_checks().empty())
+        summary.effects.may_trap = true;
+    if (expr.is_parallel())
+        call_out();
+}
+
+void EffectVis::visit(const IndexExpr &expr) {
+    expr.get_base().accept(*this);
+    expr.get_index().accept(*this);
+    if (llvm::isa<SliceType>(expr.get_base().get_type()))
+        access(FnEffects::Memory::READ);
+    summary.effects.may_trap = true;
+}
+
+void EffectVis::visit(const ArrayExpr &expr) {
+    for (const auto *elem : expr.get_elems())
+        elem->accept(*this);
+}
+
+void EffectVis::visit(const NewExpr &expr) {
+    expr.get_size().accept(*this);
+    call_out();
+    summary.effects.may_trap = true;
+}
+
+// The spawned call runs on the pool, but has to finish before the caller
+// returns
+void EffectVis::visit(const SpawnExpr &expr) {
+    for (const auto *arg : expr.get_call().get_args())
+        arg->accept(*this);
+    call(expr.get_call().get_id());
+    call_out();
+}
+
+void EffectVis::visit(const AwaitExpr &) {
+    call_out();
+}
+
+void EffectStatementVis::visit(const Expr &expr) {
+    EffectVis expr_vis{analysis, summary};
+    expr.accept(expr_vis);
+}
+
+void EffectStatementVis::visit(const VarDecl &decl) {
+    EffectVis expr_vis{analysis, summary};
+    decl.get_rhs().accept(expr_vis);
+}
+
+// Not found in scopes
+void EffectStatementVis::visit(const FnDecl &) {}
+
+void EffectStatementVis::visit(const FnDef &) {}
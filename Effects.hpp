@@ -0,0 +1,107 @@
+#ifndef HXWK_EFFECTS_H
+#define HXWK_EFFECTS_H
+
+#include "AST.hpp"
+#include "VisitorPattern.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+#include <vector>
+
+// Infers the effects of every function of a tree annotated by Sema and
+// stores them in its declarations, see FnEffects. Calls are followed through
+// the call graph, so that a function is only pure if everything it may call,
+// directly, through `spawn` or from a `par for` body, is. The functions of
+// each strongly connected component of the graph share their effects, which
+// are worked out callees first.
+//
+// `printf`, `new`, `free`, `par for`, `spawn` and `await` call into C or the
+// runtime, which counts as writing to memory. Functions which are only
+// declared keep the defaults of FnEffects, and their callers count as
+// recursive since they may call back into the program by name.
+class EffectAnalysis {
+  public:
+    friend class EffectVis;
+    friend class EffectStatementVis;
+
+    void run(llvm::ArrayRef<FnDecl *> decls, llvm::ArrayRef<FnDef *> defs);
+
+  private:
+    // What a definition does itself
+    struct Summary {
+        FnEffects effects{FnEffects::Memory::NONE, false, true, false, false};
+        // Indices of the definitions it calls
+        llvm::SmallVector<unsigned, 8> callees;
+        // Calls a function which is only declared, which may in turn call
+        // any function of the program
+        bool calls_extern{false};
+    };
+
+    // Groups the definitions into strongly connected components, callees
+    // before callers. Returns the component of each definition.
+    std::vector<unsigned> find_components();
+
+    // Definitions by symbol id
+    llvm::DenseMap<uint32_t, unsigned> indices;
+    // Symbol ids of the functions declared without a definition
+    llvm::DenseSet<uint32_t> externs;
+    std::vector<Summary> summaries;
+    // The definitions of each component, in the order found
+    std::vector<llvm::SmallVector<unsigned, 1>> components;
+};
+
+class EffectVis : public ExprVis {
+  public:
+    EffectVis(EffectAnalysis &analysis, EffectAnalysis::Summary &summary)
+            : analysis{analysis}, summary{summary} {};
+
+    VISIT(LiteralExpr<bool>);
+    VISIT(LiteralExpr<int32_t>);
+    VISIT(LiteralExpr<int64_t>);
+    VISIT(LiteralExpr<double>);
+    VISIT(LiteralExpr<Symbol>);
+    VISIT(IdExpr);
+    VISIT(BinaryExpr);
+    VISIT(CallExpr);
+    VISIT(ScopeExpr);
+    VISIT(IfExpr);
+    VISIT(CastExpr);
+    VISIT(AssignExpr);
+    VISIT(WhileExpr);
+    VISIT(ForExpr);
+    VISIT(IndexExpr);
+    VISIT(ArrayExpr);
+    VISIT(NewExpr);
+    VISIT(SpawnExpr);
+    VISIT(AwaitExpr);
+
+  private:
+    void access(FnEffects::Memory memory);
+    // A call into C or the runtime
+    void call_out();
+    // Calls the definition of `id`, or a function which is only declared
+    void call(Symbol id);
+
+    EffectAnalysis &analysis;
+    EffectAnalysis::Summary &summary;
+};
+
+class EffectStatementVis : public StatementVis {
+  public:
+    EffectStatementVis(EffectAnalysis &analysis,
+                       EffectAnalysis::Summary &summary)
+            : analysis{analysis}, summary{summary} {};
+
+    VISIT(Expr);
+    VISIT(VarDecl);
+    VISIT(FnDecl);
+    VISIT(FnDef);
+
+  private:
+    EffectAnalysis &analysis;
+    EffectAnalysis::Summary &summary;
+};
+
+#endif
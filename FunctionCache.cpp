@@ -0,0 +1,166 @@
+#include "FunctionCache.hpp"
+#include "CompileCache.hpp"
+#include "Target.hpp"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include <algorithm>
+
+// Local symbols are private to each object, so every function's object needs
+// its own copy of the string literals and helper functions it refers to.
+static void
+collect_locals(const llvm::Function &fn,
+               llvm::SmallPtrSetImpl<const llvm::GlobalValue *> &locals) {
+    llvm::SmallVector<const llvm::Value *, 32> worklist;
+    auto push_operands = [&worklist](const llvm::User &user) {
+        for (const auto &operand : user.operands())
+            worklist.push_back(operand.get());
+    };
+    auto push_body = [&push_operands](const llvm::Function &fn) {
+        for (const auto &block : fn)
+            for (const auto &inst : block)
+                push_operands(inst);
+    };
+
+    push_body(fn);
+    while (!worklist.empty()) {
+        const auto *val = worklist.pop_back_val();
+        if (const auto *global = llvm::dyn_cast<llvm::GlobalValue>(val)) {
+            if (!global->hasLocalLinkage() || !locals.insert(global).second)
+                continue;
+            const auto *var = llvm::dyn_cast<llvm::GlobalVariable>(global);
+            if (var && var->hasInitializer()) {
+                worklist.push_back(var->getInitializer());
+            } else if (const auto *callee
+                       = llvm::dyn_cast<llvm::Function>(global)) {
+                push_body(*callee);
+            }
+        } else if (const auto *constant
+                   = llvm::dyn_cast<llvm::Constant>(val)) {
+            push_operands(*constant);
+        }
+    }
+}
+
+// Calls the optimiser may inline once `fn` has had its callees inlined. Local
+// functions, like the bodies of `par for` loops, count as callees wherever
+// they are referred to, since they are compiled along with `fn`.
+static void collect_callees(llvm::Function &fn,
+                            llvm::SmallPtrSetImpl<llvm::Function *> &callees) {
+    llvm::SmallVector<llvm::Function *, 16> worklist{&fn};
+    auto add = [&](llvm::Function *callee) {
+        if (callee && callees.insert(callee).second)
+            worklist.push_back(callee);
+    };
+    while (!worklist.empty()) {
+        for (auto &block : *worklist.pop_back_val()) {
+            for (auto &inst : block) {
+                const auto *call = llvm::dyn_cast<llvm::CallBase>(&inst);
+                add(call ? call->getCalledFunction() : nullptr);
+                for (const auto &operand : inst.operands()) {
+                    auto *local = llvm::dyn_cast<llvm::Function>(operand);
+                    if (local && local->hasLocalLinkage())
+                        add(local);
+                }
+            }
+        }
+    }
+}
+
+std::string FunctionCache::get_key(llvm::Function &fn) {
+    llvm::SmallPtrSet<llvm::Function *, 16> callees;
+    collect_callees(fn, callees);
+    callees.erase(&fn);
+
+    llvm::SmallVector<llvm::Function *, 16> reachable{&fn};
+    reachable.append(callees.begin(), callees.end());
+    std::sort(reachable.begin() + 1, reachable.end(),
+              [](llvm::Function *lhs, llvm::Function *rhs) {
+                  return lhs->getName() < rhs->getName();
+              });
+
+    // Owns the strings the key is made of
+    std::vector<std::string> storage;
+    for (auto *callee : reachable) {
+        std::string signature;
+        llvm::raw_string_ostream signature_stream{signature};
+        callee->getFunctionType()->print(signature_stream);
+        signature_stream.flush();
+
+        auto digest = digests.find(callee->getName());
+        storage.push_back(callee->getName().str());
+        storage.push_back(std::move(signature));
+        storage.push_back(digest != digests.end() ? digest->second : "");
+    }
+
+    std::vector<llvm::StringRef> parts{"function", target};
+    parts.insert(parts.end(), storage.begin(), storage.end());
+    return CompileCache::make_key(parts);
+}
+
+void FunctionCache::prepare(llvm::Module &module) {
+    llvm::SmallVector<llvm::Function *, 16> cached;
+    // Local functions are copied into the object of each function that
+    // refers to them
+    for (auto &fn : module) {
+        if (fn.isDeclaration() || fn.hasLocalLinkage())
+            continue;
+
+        auto key = get_key(fn);
+        if (auto object = cache.lookup(key)) {
+            cached.push_back(&fn);
+            objects.push_back(std::move(object));
+        } else {
+            pending[fn.getName()] = std::move(key);
+        }
+    }
+
+    llvm::SmallPtrSet<llvm::Function *, 16> inlinable;
+    for (const auto &entry : pending)
+        collect_callees(*module.getFunction(entry.first()), inlinable);
+
+    // Bodies nothing left to compile can inline are only optimisation work
+    for (auto *fn : cached) {
+        if (inlinable.count(fn))
+            fn->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+        else
+            fn->deleteBody();
+    }
+}
+
+bool FunctionCache::compile(llvm::Module &module, llvm::TargetMachine &tm) {
+    for (const auto &entry : pending) {
+        auto *fn = module.getFunction(entry.first());
+        if (!fn || fn->isDeclaration())
+            continue;
+
+        llvm::SmallPtrSet<const llvm::GlobalValue *, 8> locals;
+        collect_locals(*fn, locals);
+
+        llvm::ValueToValueMapTy vmap;
+        auto part = llvm::CloneModule(
+                module, vmap, [fn, &locals](const llvm::GlobalValue *global) {
+                    return global == fn || locals.count(global);
+                });
+
+        llvm::SmallVector<char, 0> object;
+        if (!emit_native(*part, tm, false, object))
+            return false;
+
+        llvm::StringRef contents{object.data(), object.size()};
+        cache.store(entry.second, contents);
+        objects.push_back(
+                llvm::MemoryBuffer::getMemBufferCopy(contents, entry.first()));
+    }
+    pending.clear();
+    return true;
+}
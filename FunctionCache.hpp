@@ -0,0 +1,61 @@
+#ifndef HXWK_FUNCTIONCACHE_H
+#define HXWK_FUNCTIONCACHE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class Function;
+class Module;
+class TargetMachine;
+}
+
+class CompileCache;
+
+// Compiles every function into an object of its own, so that functions whose
+// code cannot have changed are taken from a CompileCache instead.
+//
+// A function's key covers the tokens of its definition along with the names,
+// signatures and tokens of all functions it can reach through calls. Those
+// are all that the optimiser can inline or derive attributes from, so an edit
+// elsewhere in the file leaves the function's object code valid.
+class FunctionCache {
+  public:
+    // `target` has to describe everything else the object code depends on
+    FunctionCache(CompileCache &cache, std::string target)
+            : cache{cache}, target{std::move(target)} {};
+
+    // `digest` is the hash of the tokens function `name` was defined by
+    void add_digest(llvm::StringRef name, llvm::StringRef digest) {
+        digests[name] = digest.str();
+    };
+
+    // Must run before optimisation. Cached functions are made
+    // available_externally, so calls to them can still be inlined but they
+    // are not compiled again.
+    void prepare(llvm::Module &module);
+    // Must run after optimisation, compiles the functions that were not
+    // cached and stores them. Returns false after reporting an error.
+    bool compile(llvm::Module &module, llvm::TargetMachine &tm);
+
+    // Object code for all functions, cached or not
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> take_objects() {
+        return std::move(objects);
+    };
+
+  private:
+    std::string get_key(llvm::Function &fn);
+
+    CompileCache &cache;
+    std::string target;
+    llvm::StringMap<std::string> digests;
+    // Keys of the functions which are compiled by `compile`
+    llvm::StringMap<std::string> pending;
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects;
+};
+
+#endif
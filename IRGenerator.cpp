@@ -1,8 +1,11 @@
 #include "IRGenerator.hpp"
-#include "C++11Compat.hpp"
 #include "Lexer.hpp"
 #include "Log.hpp"
-#include "llvm/ADT/APFloat.h"
+#include "Optimizer.hpp"
+#include "Runtime.hpp"
+#include "Target.hpp"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/BasicBlock.h"
@@ -10,9 +13,16 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/raw_os_ostream.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <cstdint>
 #include <iostream>
 #include <utility>
 #include <vector>
@@ -21,434 +31,1283 @@ namespace llvm {
 class Type;
 }
 
-void IdScoper::enter() {
-    named_values.emplace_back();
+void IRGenerator::write_assembly(std::ostream &stream) const {
+    llvm::raw_os_ostream llvm_stream{stream};
+    module->print(llvm_stream, nullptr);
 }
 
-void IdScoper::exit() {
-    named_values.pop_back();
+void IRGenerator::write_bitcode(std::ostream &stream) const {
+    llvm::raw_os_ostream llvm_stream{stream};
+    llvm::WriteBitcodeToFile(*module, llvm_stream);
 }
 
-IdScoper::value_t IdScoper::operator[](const std::string &id) {
-    for (auto i = named_values.rbegin(); i != named_values.rend(); ++i) {
-        value_t &val = i->operator[](id);
-        if (val.val != nullptr)
-            return val;
-    }
-    return value_t{};
+void IRGenerator::set_target(llvm::TargetMachine &tm) {
+    module->setTargetTriple(tm.getTargetTriple().getTriple());
+    module->setDataLayout(tm.createDataLayout());
 }
 
-IdScoper::value_t &IdScoper::current_scope(const std::string &id) {
-    return named_values.back()[id];
+bool IRGenerator::write_native_assembly(std::ostream &stream,
+                                        llvm::TargetMachine &tm) {
+    return write_native(stream, tm, true);
 }
 
-void IRGenerator::write_assembly(std::ostream &stream) const {
-    llvm::raw_os_ostream llvm_stream{stream};
-    module.print(llvm_stream, nullptr);
+bool IRGenerator::write_object(std::ostream &stream, llvm::TargetMachine &tm) {
+    return write_native(stream, tm, false);
 }
 
-void IRGenerator::write_bitcode(std::ostream &stream) const {
-    llvm::raw_os_ostream llvm_stream{stream};
-    llvm::WriteBitcodeToFile(&module, llvm_stream);
+bool IRGenerator::write_native(std::ostream &stream, llvm::TargetMachine &tm,
+                               bool assembly) {
+    llvm::SmallVector<char, 0> buffer;
+    if (!emit_native(*module, tm, assembly, buffer))
+        return false;
+
+    stream.write(buffer.data(), buffer.size());
+    return true;
 }
 
-template <typename SetupT>
-IRHandle IRGenerator::gen_scope(const ScopeExpr &scope, SetupT setup) {
+llvm::Value *IRGenerator::gen_scope(const ScopeExpr &scope, bool tail) {
     const auto &body = scope.get_body();
 
     bool explicit_void = !body.empty() && !body.back();
-
-    named_values.enter();
-
-    setup();
+    auto *stub = get_void_val();
+    const auto last = body.end() - explicit_void;
+    if (body.begin() == last)
+        return stub;
 
     IRStatementVis body_vis{*this};
-    for (auto i = body.begin(); i != (body.end() - explicit_void); ++i) {
+    for (auto i = body.begin(); i != last - 1; ++i)
         (*i)->accept(body_vis);
-        if (!body_vis.get_val())
+
+    // Discarding the last statement's value only happens in void functions,
+    // so it is in tail position either way. Spawned calls have to finish
+    // before the scope returns.
+    const auto futures = scope.get_futures();
+    IRStatementVis last_vis{*this, tail && futures.empty()};
+    (*(last - 1))->accept(last_vis);
+    if (last_vis.has_returned())
+        return nullptr;
+
+    for (auto local : futures)
+        gen_join(locals[local]);
+    return explicit_void ? stub : last_vis.get_val();
+}
+
+llvm::AllocaInst *IRGenerator::gen_alloca(llvm::Type *type,
+                                          llvm::StringRef name) {
+    auto &entry = builder.GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> entry_builder{&entry, entry.begin()};
+    return entry_builder.CreateAlloca(type, nullptr, name);
+}
+
+llvm::Value *IRGenerator::get_void_val() {
+    return llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(context));
+}
+
+llvm::MDNode *IRGenerator::gen_loop_id(const LoopHints &hints) {
+    // The first operand refers to the node itself, which keeps loop IDs
+    // distinct
+    llvm::SmallVector<llvm::Metadata *, 4> ops{nullptr};
+    auto add_hint = [&](llvm::StringRef name, llvm::Constant *val) {
+        llvm::SmallVector<llvm::Metadata *, 2> hint{
+                llvm::MDString::get(context, name)};
+        if (val)
+            hint.push_back(llvm::ConstantAsMetadata::get(val));
+        ops.push_back(llvm::MDNode::get(context, hint));
+    };
+
+    if (hints.unroll == 1)
+        add_hint("llvm.loop.unroll.disable", nullptr);
+    else if (hints.unroll)
+        add_hint("llvm.loop.unroll.count", builder.getInt32(hints.unroll));
+
+    if (hints.vectorize) {
+        add_hint("llvm.loop.vectorize.width",
+                 builder.getInt32(hints.vectorize));
+        add_hint("llvm.loop.vectorize.enable",
+                 builder.getInt1(hints.vectorize > 1));
+    }
+
+    auto *id = llvm::MDNode::getDistinct(context, ops);
+    id->replaceOperandWith(0, id);
+    return id;
+}
+
+void IRGenerator::gen_bounds_check(llvm::Value *in_bounds) {
+    auto *fn = builder.GetInsertBlock()->getParent();
+    auto *ok = llvm::BasicBlock::Create(context, "", fn);
+    auto *fail = llvm::BasicBlock::Create(context, "", fn);
+    // The weights clang gives `__builtin_expect`
+    auto *weights = llvm::MDBuilder{context}.createBranchWeights(2000, 1);
+    builder.CreateCondBr(in_bounds, ok, fail, weights);
+
+    builder.SetInsertPoint(fail);
+    builder.CreateCall(llvm::Intrinsic::getDeclaration(
+            module.get(), llvm::Intrinsic::trap));
+    builder.CreateUnreachable();
+    builder.SetInsertPoint(ok);
+}
+
+llvm::Value *IRGenerator::gen_len(llvm::Value *val, const Type &type) {
+    if (const auto *array = llvm::dyn_cast<ArrayType>(&type))
+        return builder.getInt32(array->get_size());
+    if (const auto *vec = llvm::dyn_cast<VectorType>(&type))
+        return builder.getInt32(vec->get_lanes());
+    return builder.CreateExtractValue(val, 1);
+}
+
+llvm::Value *IRGenerator::gen_index(llvm::Value *index, const Type &type) {
+    if (llvm::isa<Int32Type>(type))
+        return index;
+    return builder.CreateIntCast(index, builder.getInt64Ty(),
+                                 get_arith_traits(type)->is_signed);
+}
+
+llvm::Value *IRGenerator::gen_element_ptr(const IndexExpr &expr) {
+    IRExprVis base{*this}, index{*this};
+    expr.get_base().accept(base);
+    expr.get_index().accept(index);
+    return gen_element_ptr(base.get_val(), *expr.get_base().get_type(),
+                           index.get_val(), *expr.get_index().get_type(),
+                           bounds_checks
+                                   && (!expr.is_hoisted() || check_hoisted));
+}
+
+llvm::Value *IRGenerator::gen_element_ptr(llvm::Value *base,
+                                          const Type &base_type,
+                                          llvm::Value *index,
+                                          const Type &index_type,
+                                          unsigned count) {
+    index = gen_index(index, index_type);
+    if (count) {
+        // Negative indices wrap around to large unsigned ones
+        auto *len = builder.CreateZExt(gen_len(base, base_type),
+                                       index->getType());
+        auto *in_bounds = builder.CreateICmpULT(index, len);
+        if (count > 1) {
+            // Indices below the length cannot overflow here
+            auto *end = builder.CreateAdd(
+                    index, llvm::ConstantInt::get(index->getType(), count));
+            in_bounds = builder.CreateAnd(in_bounds,
+                                          builder.CreateICmpULE(end, len));
+        }
+        gen_bounds_check(in_bounds);
+    }
+
+    if (const auto *array = llvm::dyn_cast<ArrayType>(&base_type))
+        return builder.CreateInBoundsGEP(get_storage_type(*array), base,
+                                         {builder.getInt32(0), index});
+    const auto *elem = llvm::cast<SliceType>(base_type).get_elem();
+    return builder.CreateInBoundsGEP(get_llvm_type(*elem),
+                                     builder.CreateExtractValue(base, 0),
+                                     index);
+}
+
+llvm::Value *IRGenerator::gen_lane(llvm::Value *index, const Type &type,
+                                   const VectorType &vec) {
+    index = gen_index(index, type);
+    // Lanes out of range yield poison rather than trapping
+    if (bounds_checks)
+        gen_bounds_check(builder.CreateICmpULT(
+                index,
+                llvm::ConstantInt::get(index->getType(), vec.get_lanes())));
+    return index;
+}
+
+llvm::Value *IRGenerator::gen_reduction(Builtin builtin, llvm::Value *vec,
+                                        const Type &lane_type) {
+    const auto &traits = *get_arith_traits(lane_type);
+    if (!traits.is_float) {
+        switch (builtin) {
+            case Builtin::HSUM:
+                return builder.CreateAddReduce(vec);
+            case Builtin::HMUL:
+                return builder.CreateMulReduce(vec);
+            case Builtin::HMIN:
+                return builder.CreateIntMinReduce(vec, traits.is_signed);
+            default:
+                return builder.CreateIntMaxReduce(vec, traits.is_signed);
+        }
+    }
+
+    // Reassociation lets the lanes be added pairwise rather than in order
+    auto *lane_llvm_type = get_llvm_type(lane_type);
+    llvm::CallInst *reduction;
+    switch (builtin) {
+        case Builtin::HSUM:
+            reduction = builder.CreateFAddReduce(
+                    llvm::ConstantFP::getNegativeZero(lane_llvm_type), vec);
+            break;
+        case Builtin::HMUL:
+            reduction = builder.CreateFMulReduce(
+                    llvm::ConstantFP::get(lane_llvm_type, 1.0), vec);
             break;
+        case Builtin::HMIN:
+            return builder.CreateFPMinReduce(vec);
+        default:
+            return builder.CreateFPMaxReduce(vec);
+    }
+    llvm::FastMathFlags flags;
+    flags.setAllowReassoc();
+    reduction->setFastMathFlags(flags);
+    return reduction;
+}
+
+llvm::Value *IRGenerator::gen_in_range(const ForExpr &expr,
+                                       llvm::Value *begin, llvm::Value *end) {
+    const auto &counter_type = *expr.get_begin().get_type();
+    auto *first = gen_index(begin, counter_type);
+    auto *last = gen_index(end, counter_type);
+    auto *in_bounds = builder.CreateICmpSGE(
+            first, llvm::ConstantInt::get(first->getType(), 0));
+    for (const auto *var : expr.get_range_checks()) {
+        IRExprVis var_vis{*this};
+        var->accept(var_vis);
+        auto *len = gen_len(var_vis.get_val(), *var->get_type());
+        in_bounds = builder.CreateAnd(
+                in_bounds,
+                builder.CreateICmpSLE(
+                        last, builder.CreateZExt(len, last->getType())));
     }
+    return in_bounds;
+}
+
+void IRGenerator::gen_for(const ForExpr &expr, llvm::Value *begin,
+                          llvm::Value *end) {
+    if (!bounds_checks || expr.get_range_checks().empty()) {
+        gen_loop(expr, begin, end, false);
+        return;
+    }
+
+    auto *fn = builder.GetInsertBlock()->getParent();
+    auto *unchecked = llvm::BasicBlock::Create(context, "", fn);
+    auto *checked = llvm::BasicBlock::Create(context, "");
+    auto *after = llvm::BasicBlock::Create(context, "");
+    builder.CreateCondBr(gen_in_range(expr, begin, end), unchecked, checked);
+
+    builder.SetInsertPoint(unchecked);
+    gen_loop(expr, begin, end, false);
+    builder.CreateBr(after);
+
+    // Iterations ahead of the first index out of bounds still run
+    fn->getBasicBlockList().push_back(checked);
+    builder.SetInsertPoint(checked);
+    gen_loop(expr, begin, end, true);
+    builder.CreateBr(after);
+
+    fn->getBasicBlockList().push_back(after);
+    builder.SetInsertPoint(after);
+}
 
-    named_values.exit();
+// The loop is rotated such that its exit test follows the body, guarded by a
+// test ahead of the first iteration, which is the shape LLVM's loop passes
+// expect
+void IRGenerator::gen_loop(const ForExpr &expr, llvm::Value *begin,
+                           llvm::Value *end, bool checked) {
+    const auto &counter_type = *expr.get_begin().get_type();
+    const bool is_signed = get_arith_traits(counter_type)->is_signed;
+    const auto less = is_signed ? llvm::CmpInst::Predicate::ICMP_SLT
+                                : llvm::CmpInst::Predicate::ICMP_ULT;
+
+    auto *fn = builder.GetInsertBlock()->getParent();
+    auto *body = llvm::BasicBlock::Create(context, "");
+    auto *after = llvm::BasicBlock::Create(context, "");
+    auto *preheader = builder.GetInsertBlock();
+    builder.CreateCondBr(builder.CreateICmp(less, begin, end), body, after);
+
+    fn->getBasicBlockList().push_back(body);
+    builder.SetInsertPoint(body);
+    const auto name = interner.get_str(expr.get_var());
+    auto *counter = builder.CreatePHI(get_llvm_type(counter_type), 2, name);
+    counter->addIncoming(begin, preheader);
+    locals[expr.get_local()] = counter;
+    const bool outer_checked = check_hoisted;
+    check_hoisted = checked;
+    gen_scope(expr.get_body());
+    check_hoisted = outer_checked;
+
+    // The counter stays below `end` within the body, so the increment
+    // cannot overflow
+    auto *next = builder.CreateAdd(
+            counter, llvm::ConstantInt::get(counter->getType(), 1),
+            name + ".next", !is_signed, is_signed);
+    counter->addIncoming(next, builder.GetInsertBlock());
+    auto *latch = builder.CreateCondBr(builder.CreateICmp(less, next, end),
+                                       body, after);
+    latch->setMetadata(llvm::LLVMContext::MD_loop,
+                       gen_loop_id(expr.get_hints()));
+
+    fn->getBasicBlockList().push_back(after);
+    builder.SetInsertPoint(after);
+}
 
-    if (body.empty() || explicit_void)
-        return {llvm::ConstantPointerNull::get(
-                        llvm::Type::getInt8PtrTy(context)),  // Stub value
-                std::make_shared<VoidType>()};
+// `void body(void *ctx, int64_t lo, int64_t hi, void *acc)`
+static llvm::FunctionType *get_par_body_type(llvm::LLVMContext &context) {
+    auto *ptr = llvm::Type::getInt8PtrTy(context);
+    auto *i64 = llvm::Type::getInt64Ty(context);
+    return llvm::FunctionType::get(llvm::Type::getVoidTy(context),
+                                   {ptr, i64, i64, ptr}, false);
+}
 
-    return body_vis.get_handle();
+// `void combine(void *into, const void *from)`
+static llvm::FunctionType *get_combine_type(llvm::LLVMContext &context) {
+    auto *ptr = llvm::Type::getInt8PtrTy(context);
+    return llvm::FunctionType::get(llvm::Type::getVoidTy(context),
+                                   {ptr, ptr}, false);
+}
+
+void IRGenerator::gen_par_for(const ForExpr &expr, llvm::Value *begin,
+                              llvm::Value *end) {
+    const auto &counter_type = *expr.get_begin().get_type();
+    const bool is_signed = get_arith_traits(counter_type)->is_signed;
+    auto *fn = builder.GetInsertBlock()->getParent();
+
+    // The values of captured variables, the storage of arrays
+    std::vector<llvm::Type *> field_types;
+    std::vector<llvm::Value *> fields;
+    for (const auto *var : expr.get_captures()) {
+        IRExprVis var_vis{*this};
+        var->accept(var_vis);
+        fields.push_back(var_vis.get_val());
+        field_types.push_back(var_vis.get_val()->getType());
+    }
+    auto *ctx_type = llvm::StructType::get(context, field_types);
+    auto *ctx = gen_alloca(ctx_type, "par.ctx");
+    for (unsigned i = 0; i < fields.size(); ++i)
+        builder.CreateStore(fields[i],
+                            builder.CreateStructGEP(ctx_type, ctx, i));
+
+    auto *ptr = builder.getInt8PtrTy();
+    auto *combine_type = get_combine_type(context);
+    llvm::Value *acc = llvm::ConstantPointerNull::get(ptr);
+    llvm::Value *combine
+            = llvm::ConstantPointerNull::get(combine_type->getPointerTo());
+    uint64_t acc_size = 0;
+    const auto &reduction = expr.get_reduction();
+    llvm::AllocaInst *result = nullptr;
+    if (reduction.var) {
+        const auto &type = *reduction.var->get_type();
+        result = gen_alloca(get_llvm_type(type), "par.acc");
+        builder.CreateStore(get_identity(reduction.op, type), result);
+        acc = builder.CreateBitCast(result, ptr);
+        acc_size = module->getDataLayout().getTypeAllocSize(
+                result->getAllocatedType());
+        combine = gen_combine(reduction, fn->getName() + ".combine");
+    }
+
+    auto *i64 = builder.getInt64Ty();
+    auto *par_for_type = llvm::FunctionType::get(
+            builder.getVoidTy(),
+            {i64, i64, i64, get_par_body_type(context)->getPointerTo(), ptr,
+             ptr, i64, combine_type->getPointerTo()},
+            false);
+    auto par_for = module->getOrInsertFunction("hxwk_par_for", par_for_type);
+    llvm::Value *body
+            = gen_par_body(expr, ctx_type, fn->getName() + ".par", false);
+    // Unless the whole range is in bounds, every chunk checks its indices
+    if (bounds_checks && !expr.get_range_checks().empty()) {
+        auto *checked = gen_par_body(expr, ctx_type,
+                                     fn->getName() + ".par.checked", true);
+        body = builder.CreateSelect(gen_in_range(expr, begin, end), body,
+                                    checked);
+    }
+    auto to_i64 = [&](llvm::Value *bound) {
+        return is_signed ? builder.CreateSExt(bound, i64)
+                         : builder.CreateZExt(bound, i64);
+    };
+    builder.CreateCall(par_for,
+                       {to_i64(begin), to_i64(end),
+                        builder.getInt64(expr.get_hints().grain), body,
+                        builder.CreateBitCast(ctx, ptr), acc,
+                        builder.getInt64(acc_size), combine});
+
+    if (!result)
+        return;
+    IRExprVis var_vis{*this};
+    reduction.var->accept(var_vis);
+    builder.CreateStore(
+            gen_reduce(reduction.op, var_vis.get_val(),
+                       builder.CreateLoad(result->getAllocatedType(), result),
+                       *reduction.var->get_type()),
+            locals[reduction.var->get_local()]);
+}
+
+llvm::Function *IRGenerator::gen_par_body(const ForExpr &expr,
+                                          llvm::StructType *ctx_type,
+                                          const llvm::Twine &name,
+                                          bool checked) {
+    auto *fn = llvm::Function::Create(get_par_body_type(context),
+                                      llvm::Function::InternalLinkage, name,
+                                      module.get());
+    const auto ip = builder.saveIP();
+    std::vector<llvm::Value *> outer_locals(locals.size(), nullptr);
+    std::swap(locals, outer_locals);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", fn));
+
+    auto *ctx = builder.CreateBitCast(fn->getArg(0),
+                                      ctx_type->getPointerTo());
+    const auto captures = expr.get_captures();
+    for (unsigned i = 0; i < captures.size(); ++i) {
+        locals[captures[i]->get_local()] = builder.CreateLoad(
+                ctx_type->getElementType(i),
+                builder.CreateStructGEP(ctx_type, ctx, i),
+                interner.get_str(captures[i]->get_id()));
+    }
+
+    // The worker's share of the reduction is accumulated in a register and
+    // combined into its slot once the chunk is done, so that other chunks
+    // the worker runs in between cannot interfere
+    const auto &reduction = expr.get_reduction();
+    llvm::AllocaInst *acc = nullptr;
+    if (reduction.var) {
+        const auto &type = *reduction.var->get_type();
+        acc = gen_alloca(get_llvm_type(type),
+                         interner.get_str(reduction.var->get_id()));
+        builder.CreateStore(get_identity(reduction.op, type), acc);
+        locals[reduction.var->get_local()] = acc;
+    }
+
+    auto *counter_type = get_llvm_type(*expr.get_begin().get_type());
+    gen_loop(expr, builder.CreateTrunc(fn->getArg(1), counter_type),
+             builder.CreateTrunc(fn->getArg(2), counter_type), checked);
+
+    if (acc) {
+        auto *acc_type = acc->getAllocatedType();
+        auto *slot = builder.CreateBitCast(fn->getArg(3),
+                                           acc_type->getPointerTo());
+        builder.CreateStore(
+                gen_reduce(reduction.op, builder.CreateLoad(acc_type, slot),
+                           builder.CreateLoad(acc_type, acc),
+                           *reduction.var->get_type()),
+                slot);
+    }
+    builder.CreateRetVoid();
+
+    std::swap(locals, outer_locals);
+    builder.restoreIP(ip);
+    if (optimizer)
+        optimizer->run_on_function(*fn);
+    return fn;
+}
+
+llvm::Function *IRGenerator::gen_combine(const Reduction &reduction,
+                                         const llvm::Twine &name) {
+    auto *fn = llvm::Function::Create(get_combine_type(context),
+                                      llvm::Function::InternalLinkage, name,
+                                      module.get());
+    const auto ip = builder.saveIP();
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", fn));
+
+    const auto &type = *reduction.var->get_type();
+    auto *acc_type = get_llvm_type(type);
+    auto *into = builder.CreateBitCast(fn->getArg(0),
+                                       acc_type->getPointerTo());
+    auto *from = builder.CreateBitCast(fn->getArg(1),
+                                       acc_type->getPointerTo());
+    builder.CreateStore(gen_reduce(reduction.op,
+                                   builder.CreateLoad(acc_type, into),
+                                   builder.CreateLoad(acc_type, from), type),
+                        into);
+    builder.CreateRetVoid();
+
+    builder.restoreIP(ip);
+    if (optimizer)
+        optimizer->run_on_function(*fn);
+    return fn;
+}
+
+llvm::Value *IRGenerator::gen_reduce(Tok op, llvm::Value *lhs,
+                                     llvm::Value *rhs, const Type &type) {
+    const bool is_float = get_arith_traits(get_lane_type(type))->is_float;
+    if (op == Tok::PLUS)
+        return is_float ? builder.CreateFAdd(lhs, rhs)
+                        : builder.CreateAdd(lhs, rhs);
+    return is_float ? builder.CreateFMul(lhs, rhs)
+                    : builder.CreateMul(lhs, rhs);
+}
+
+llvm::Constant *IRGenerator::get_identity(Tok op, const Type &type) {
+    auto *llvm_type = get_llvm_type(type);
+    const bool is_float = get_arith_traits(get_lane_type(type))->is_float;
+    // Adding -0.0 keeps the sign of every other value, 0.0 does not
+    if (op == Tok::PLUS)
+        return is_float ? llvm::ConstantFP::getNegativeZero(llvm_type)
+                        : llvm::Constant::getNullValue(llvm_type);
+    return is_float ? llvm::ConstantFP::get(llvm_type, 1.0)
+                    : llvm::ConstantInt::get(llvm_type, 1);
+}
+
+// `void call(void *task)`
+static llvm::FunctionType *get_spawn_thunk_type(llvm::LLVMContext &context) {
+    return llvm::FunctionType::get(llvm::Type::getVoidTy(context),
+                                   llvm::Type::getInt8PtrTy(context), false);
+}
+
+// The storage the runtime keeps a spawned task in
+static llvm::Type *get_task_type(llvm::LLVMContext &context) {
+    return llvm::ArrayType::get(llvm::Type::getInt64Ty(context),
+                                hxwk_task_size / sizeof(int64_t));
+}
+
+llvm::StructType *IRGenerator::get_spawn_frame_type(llvm::Function &callee) {
+    std::vector<llvm::Type *> field_types{get_task_type(context)};
+    auto *ret_type = callee.getReturnType();
+    if (!ret_type->isVoidTy())
+        field_types.push_back(ret_type);
+    const auto params = callee.getFunctionType()->params();
+    field_types.insert(field_types.end(), params.begin(), params.end());
+    return llvm::StructType::get(context, field_types);
+}
+
+llvm::Value *IRGenerator::gen_spawn(llvm::Function &callee,
+                                    llvm::ArrayRef<llvm::Value *> args) {
+    auto *frame_type = get_spawn_frame_type(callee);
+    auto *frame = gen_alloca(frame_type, (callee.getName() + ".task").str());
+    const unsigned first_arg = frame_type->getNumElements() - args.size();
+    for (unsigned i = 0; i < args.size(); ++i) {
+        auto *field
+                = builder.CreateStructGEP(frame_type, frame, first_arg + i);
+        builder.CreateStore(args[i], field);
+    }
+
+    auto *ptr = builder.getInt8PtrTy();
+    auto spawn_fn = module->getOrInsertFunction(
+            "hxwk_spawn", builder.getVoidTy(), ptr,
+            get_spawn_thunk_type(context)->getPointerTo());
+    llvm::Value *task = builder.CreateBitCast(frame, ptr);
+    builder.CreateCall(spawn_fn, {task, get_spawn_thunk(callee)});
+    return task;
+}
+
+llvm::Function *IRGenerator::get_spawn_thunk(llvm::Function &callee) {
+    auto &thunk = spawn_thunks[&callee];
+    if (thunk)
+        return thunk;
+
+    thunk = llvm::Function::Create(get_spawn_thunk_type(context),
+                                   llvm::Function::InternalLinkage,
+                                   callee.getName() + ".spawn", module.get());
+    const auto ip = builder.saveIP();
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", thunk));
+
+    auto *frame_type = get_spawn_frame_type(callee);
+    auto *frame = builder.CreateBitCast(thunk->getArg(0),
+                                        frame_type->getPointerTo());
+    const auto num_args = callee.arg_size();
+    const unsigned first_arg = frame_type->getNumElements() - num_args;
+    std::vector<llvm::Value *> args;
+    for (unsigned i = 0; i < num_args; ++i)
+        args.push_back(builder.CreateLoad(
+                frame_type->getElementType(first_arg + i),
+                builder.CreateStructGEP(frame_type, frame, first_arg + i)));
+    auto *result = gen_call(&callee, args);
+    if (!result->getType()->isVoidTy())
+        builder.CreateStore(result,
+                            builder.CreateStructGEP(frame_type, frame, 1));
+    builder.CreateRetVoid();
+
+    builder.restoreIP(ip);
+    if (optimizer)
+        optimizer->run_on_function(*thunk);
+    return thunk;
+}
+
+void IRGenerator::gen_join(llvm::Value *task) {
+    auto await_fn = module->getOrInsertFunction(
+            "hxwk_await", builder.getVoidTy(), builder.getInt8PtrTy());
+    builder.CreateCall(await_fn, task);
+}
+
+llvm::Value *IRGenerator::gen_await(llvm::Value *task, const Type &result) {
+    gen_join(task);
+    if (llvm::isa<VoidType>(result))
+        return get_void_val();
+
+    // The frame's fields up to the result, which all frames of calls with a
+    // result of this type start with
+    auto *result_type = get_llvm_type(result);
+    auto *prefix_type
+            = llvm::StructType::get(get_task_type(context), result_type);
+    auto *prefix
+            = builder.CreateBitCast(task, prefix_type->getPointerTo());
+    return builder.CreateLoad(result_type,
+                              builder.CreateStructGEP(prefix_type, prefix, 1));
+}
+
+void IRGenerator::gen_array_copy(llvm::Value *dst, llvm::Value *src,
+                                 const ArrayType &type) {
+    const auto &layout = module->getDataLayout();
+    auto *storage_type = get_storage_type(type);
+    builder.CreateMemCpy(dst, layout.getPrefTypeAlign(storage_type), src,
+                         layout.getPrefTypeAlign(storage_type),
+                         layout.getTypeAllocSize(storage_type));
+}
+
+void IRGenerator::gen_return(const Expr &expr) {
+    IRExprVis vis{*this, true};
+    expr.accept(vis);
+    if (!vis.has_returned())
+        gen_ret(vis.get_val());
+}
+
+void IRGenerator::gen_ret(llvm::Value *val) {
+    if (builder.getCurrentFunctionReturnType()->isVoidTy())
+        builder.CreateRetVoid();
+    else
+        builder.CreateRet(val);
+}
+
+void IRGenerator::gen_tail_call(llvm::Function *callee,
+                                std::vector<llvm::Value *> args) {
+    auto *fn = builder.GetInsertBlock()->getParent();
+    // Neither a jump back to the entry nor the callee may overwrite arrays
+    // that the arguments refer to
+    if (frame_arrays) {
+        if (report_tail_calls && !callee->isVarArg())
+            Log::note("Tail call from `", fn->getName().str(), "` to `",
+                      callee->getName().str(),
+                      "` cannot be eliminated as the caller has local "
+                      "arrays");
+        gen_ret(gen_call(callee, args));
+        return;
+    }
+    if (callee == fn) {
+        if (!loop_header)
+            loop_header = llvm::BasicBlock::Create(context, "tailrecurse");
+        tail_recursions.push_back({builder.GetInsertBlock(), std::move(args)});
+        builder.CreateBr(loop_header);
+        return;
+    }
+
+    auto *call = gen_call(callee, args);
+    // Reusing the caller's frame is only guaranteed between identical
+    // prototypes
+    if (callee->getFunctionType() == fn->getFunctionType()) {
+        call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+    } else {
+        call->setTailCallKind(llvm::CallInst::TCK_Tail);
+        // Only printf is variadic, it never calls back into the program
+        if (report_tail_calls && !callee->isVarArg())
+            Log::note("Tail call from `", fn->getName().str(), "` to `",
+                      callee->getName().str(),
+                      "` cannot be eliminated as their signatures differ");
+    }
+    gen_ret(call);
+}
+
+llvm::CallInst *IRGenerator::gen_call(llvm::Function *callee,
+                                      llvm::ArrayRef<llvm::Value *> args) {
+    auto *call = builder.CreateCall(callee, args);
+    call->setAttributes(callee->getAttributes());
+    return call;
+}
+
+// The function's code so far moves from its entry block to `loop_header`,
+// whose phis take the place of the parameters. Allocas stay behind.
+void IRGenerator::gen_tail_loop(llvm::Function &fn) {
+    auto &entry = fn.getEntryBlock();
+    auto first = entry.begin();
+    while (llvm::isa<llvm::AllocaInst>(*first))
+        ++first;
+    loop_header->getInstList().splice(loop_header->end(),
+                                      entry.getInstList(), first,
+                                      entry.end());
+    loop_header->insertInto(&fn, entry.getNextNode());
+    loop_header->replaceSuccessorsPhiUsesWith(&entry, loop_header);
+    builder.SetInsertPoint(&entry);
+    builder.CreateBr(loop_header);
+
+    builder.SetInsertPoint(loop_header, loop_header->begin());
+    std::vector<llvm::PHINode *> phis;
+    for (auto &arg : fn.args()) {
+        auto *phi = builder.CreatePHI(arg.getType(),
+                                      tail_recursions.size() + 1,
+                                      arg.getName() + ".tr");
+        arg.replaceAllUsesWith(phi);
+        phi->addIncoming(&arg, &entry);
+        phis.push_back(phi);
+    }
+
+    for (const auto &call : tail_recursions) {
+        auto *block = call.block == &entry ? loop_header : call.block;
+        for (std::size_t i = 0; i < phis.size(); ++i) {
+            auto *val = call.args[i];
+            // Arguments passed on unchanged have been replaced as well
+            if (auto *arg = llvm::dyn_cast<llvm::Argument>(val))
+                val = phis[arg->getArgNo()];
+            phis[i]->addIncoming(val, block);
+        }
+    }
 }
 
 llvm::Type *IRGenerator::get_llvm_type(const Type &type) {
-    if (llvm::isa<BoolType>(type)) {
-        return llvm::Type::getInt1Ty(context);
-    } else if (llvm::isa<Int32Type>(type)) {
-        return llvm::Type::getInt32Ty(context);
-    } else if (llvm::isa<DoubleType>(type)) {
-        return llvm::Type::getDoubleTy(context);
+    if (const auto *traits = get_arith_traits(type)) {
+        if (!traits->is_float)
+            return llvm::Type::getIntNTy(context, traits->bits);
+        return traits->bits == 32 ? llvm::Type::getFloatTy(context)
+                                  : llvm::Type::getDoubleTy(context);
     } else if (llvm::isa<VoidType>(type)) {
         return llvm::Type::getVoidTy(context);
+    } else if (llvm::isa<StrLitType>(type)) {
+        return llvm::Type::getInt8PtrTy(context);
+    } else if (const auto *array = llvm::dyn_cast<ArrayType>(&type)) {
+        return get_storage_type(*array)->getPointerTo();
+    } else if (const auto *slice = llvm::dyn_cast<SliceType>(&type)) {
+        return llvm::StructType::get(
+                get_llvm_type(*slice->get_elem())->getPointerTo(),
+                builder.getInt32Ty());
+    } else if (const auto *vec = llvm::dyn_cast<VectorType>(&type)) {
+        return llvm::FixedVectorType::get(get_llvm_type(*vec->get_elem()),
+                                          vec->get_lanes());
+    } else if (llvm::isa<FutureType>(type)) {
+        return llvm::Type::getInt8PtrTy(context);
     } else {
         return nullptr;
     }
 }
 
+llvm::ArrayType *IRGenerator::get_storage_type(const ArrayType &type) {
+    return llvm::ArrayType::get(get_llvm_type(*type.get_elem()),
+                                type.get_size());
+}
+
+// The instruction follows from the width, kind and signedness of both types,
+// or of their lanes
 llvm::Value *IRGenerator::arit_cast(llvm::Value *val, const Type &from,
                                     const Type &to) {
-    using TypeKind = Type::TypeKind;
-
-    if (from.getKind() == to.getKind())
+    if (&from == &to)
         return val;
 
-    // This really is a mess. There should be a better way of doing things
-    switch (from.getKind()) {
-        case TypeKind::Bool:
-            switch (to.getKind()) {
-                case TypeKind::Int32:
-                    return builder.CreateIntCast(val, get_llvm_type(to),
-                                                 false);
-                case TypeKind::Double:
-                    return builder.CreateUIToFP(val, get_llvm_type(to));
-                default:
-                    break;
-            }
-            break;
-        case TypeKind::Int32:
-            switch (to.getKind()) {
-                case TypeKind::Bool:
-                    return builder.CreateIntCast(val, get_llvm_type(to), true);
-                case TypeKind::Double:
-                    return builder.CreateSIToFP(val, get_llvm_type(to));
-                default:
-                    break;
-            }
-            break;
-        case TypeKind::Double:
-            switch (to.getKind()) {
-                case TypeKind::Bool:
-                    return builder.CreateFPToUI(val, get_llvm_type(to));
-                case TypeKind::Int32:
-                    return builder.CreateFPToSI(val, get_llvm_type(to));
-                default:
-                    break;
-            }
-            break;
-        default:
-            break;
-    }
-    return nullptr;
+    // Scalars are converted to the type of the lanes, then splat
+    const auto *to_vec = llvm::dyn_cast<VectorType>(&to);
+    if (to_vec && !llvm::isa<VectorType>(from))
+        return builder.CreateVectorSplat(
+                to_vec->get_lanes(),
+                arit_cast(val, from, *to_vec->get_elem()));
+
+    auto *to_type = get_llvm_type(to);
+    const auto op = llvm::CastInst::getCastOpcode(
+            val, get_arith_traits(get_lane_type(from))->is_signed, to_type,
+            get_arith_traits(get_lane_type(to))->is_signed);
+    return builder.CreateCast(op, val, to_type);
+}
+
+void IRExprVis::visit(const LiteralExpr<bool> &expr) {
+    val = llvm::ConstantInt::getBool(gen.context, expr.get_val());
 }
 
 void IRExprVis::visit(const LiteralExpr<int32_t> &expr) {
-    handle.reset();
-    handle = {llvm::ConstantInt::get(
-                      gen.context,
-                      llvm::APInt{32, static_cast<uint64_t>(expr.get_val()),
-                                  true}),
-              std::make_shared<Int32Type>()};
+    val = llvm::ConstantInt::get(
+            gen.context,
+            llvm::APInt{32, static_cast<uint64_t>(expr.get_val()), true});
 }
 
-void IRExprVis::visit(const LiteralExpr<double> &expr) {
-    handle.reset();
-    handle = {
-            llvm::ConstantFP::get(gen.context, llvm::APFloat{expr.get_val()}),
-            std::make_shared<DoubleType>()};
+void IRExprVis::visit(const LiteralExpr<int64_t> &expr) {
+    val = llvm::ConstantInt::get(gen.get_llvm_type(*expr.get_type()),
+                                 static_cast<uint64_t>(expr.get_val()), true);
 }
 
-void IRExprVis::visit(const LiteralExpr<std::string> &expr) {
-    handle.reset();
-    handle = {gen.builder.CreateGlobalStringPtr(expr.get_val()),
-              std::make_shared<StrLitType>()};
+void IRExprVis::visit(const LiteralExpr<double> &expr) {
+    // Rounded for `f32`
+    val = llvm::ConstantFP::get(gen.get_llvm_type(*expr.get_type()),
+                                expr.get_val());
 }
 
-void IRExprVis::visit(const IdExpr &expr) {
-    handle.reset();
-    handle = gen.named_values[expr.get_id()];
+void IRExprVis::visit(const LiteralExpr<Symbol> &expr) {
+    val = gen.builder.CreateGlobalStringPtr(
+            gen.interner.get_str(expr.get_val()));
 }
 
-bool is_arit(const Type &type) {
-    return llvm::isa<BoolType>(type) || llvm::isa<Int32Type>(type)
-           || llvm::isa<DoubleType>(type);
+void IRExprVis::visit(const IdExpr &expr) {
+    val = gen.locals[expr.get_local()];
+    if (llvm::isa<ArrayType>(expr.get_type()))
+        return;
+    if (auto *var = llvm::dyn_cast<llvm::AllocaInst>(val))
+        val = gen.builder.CreateLoad(var->getAllocatedType(), var,
+                                     gen.interner.get_str(expr.get_id()));
 }
 
 void IRExprVis::visit(const BinaryExpr &expr) {
-    handle.reset();
-
     IRExprVis lhs{gen}, rhs{gen};
     expr.get_lhs().accept(lhs);
     expr.get_rhs().accept(rhs);
-    if (!lhs.get_val() || !rhs.get_val())
-        return;
-
-    if (!(is_arit(*lhs.get_type()) && is_arit(*rhs.get_type())))
-        return Log::error(
-                "Both parameters of a binary expression must be of arithmetic "
-                "type (`bool`, `i32` or `double`)");
-
-    handle.type = lhs.get_type()->getKind() > rhs.get_type()->getKind()
-                          ? lhs.get_type()
-                          : rhs.get_type();
-
-    auto *lhs_val
-            = gen.arit_cast(lhs.get_val(), *lhs.get_type(), *handle.type);
-    auto *rhs_val
-            = gen.arit_cast(rhs.get_val(), *rhs.get_type(), *handle.type);
 
+    // Sema has converted both operands to the same type
+    const auto &type = *expr.get_lhs().get_type();
     using BinaryOps = llvm::Instruction::BinaryOps;
-    bool is_fp = llvm::isa<DoubleType>(*handle.type);
-    bool is_signed = llvm::isa<Int32Type>(*handle.type);
-    bool is_cmp;
-
-    llvm::Instruction::BinaryOps op;
-    llvm::CmpInst::Predicate op_cmp;
+    using Predicate = llvm::CmpInst::Predicate;
+    const auto &traits = *get_arith_traits(get_lane_type(type));
+    bool is_fp = traits.is_float;
+    bool is_signed = traits.is_signed;
 
+    BinaryOps op;
     switch (expr.get_op()) {
         case Tok::PLUS:
             op = is_fp ? BinaryOps::FAdd : BinaryOps::Add;
-            is_cmp = false;
             break;
         case Tok::MINUS:
             op = is_fp ? BinaryOps::FSub : BinaryOps::Sub;
-            is_cmp = false;
             break;
         case Tok::MULT:
             op = is_fp ? BinaryOps::FMul : BinaryOps::Mul;
-            is_cmp = false;
             break;
         case Tok::SLASH:
             op = is_fp ? BinaryOps::FDiv
                        : (is_signed ? BinaryOps::SDiv : BinaryOps::UDiv);
-            is_cmp = false;
             break;
-        case Tok::CMP_LT:
-            op_cmp = is_fp ? llvm::CmpInst::Predicate::FCMP_ULT
-                           : (is_signed ? llvm::CmpInst::Predicate::ICMP_SLT
-                                        : llvm::CmpInst::Predicate::ICMP_ULT);
-            is_cmp = true;
-            break;
-        default:
-            Log::error("Unknown binary operator");
+        default: {
+            // Tok::CMP_LT, the only comparison
+            auto op_cmp = is_fp ? Predicate::FCMP_ULT
+                                : (is_signed ? Predicate::ICMP_SLT
+                                             : Predicate::ICMP_ULT);
+            val = is_fp ? gen.builder.CreateFCmp(op_cmp, lhs.get_val(),
+                                                 rhs.get_val())
+                        : gen.builder.CreateICmp(op_cmp, lhs.get_val(),
+                                                 rhs.get_val());
             return;
+        }
     }
-
-    if (is_cmp) {
-        handle.val = is_fp ? gen.builder.CreateFCmp(op_cmp, lhs_val, rhs_val)
-                           : gen.builder.CreateICmp(op_cmp, lhs_val, rhs_val);
-        handle.type = std::make_shared<BoolType>();
-    } else {
-        handle.val = gen.builder.CreateBinOp(op, lhs_val, rhs_val);
-    }
+    val = gen.builder.CreateBinOp(op, lhs.get_val(), rhs.get_val());
 }
 
 void IRExprVis::visit(const CallExpr &expr) {
-    handle.reset();
-
-    auto callee_handle = gen.named_values[expr.get_id()];
-    if (!callee_handle.val || !llvm::isa<FunctionType>(*callee_handle.type)) {
-        return Log::error("Undeclared function ", expr.get_id());
-    }
-    auto *callee = static_cast<llvm::Function *>(callee_handle.val);
-
-    const auto *type = llvm::dyn_cast<FunctionType>(callee_handle.type.get());
-    if (!type)
-        return Log::error("`", expr.get_id(), "` is not a function");
-
-    auto expected_arg_n = type->get_args().size();
-    auto given_arg_n = expr.get_args().size();
-    if (expected_arg_n != given_arg_n
-        && !(callee->isVarArg() && expected_arg_n <= given_arg_n))
-        return Log::error("Wrong number of arguments (expected ",
-                          expected_arg_n, " but got ", given_arg_n, ")");
-
-    std::size_t i = 0;
+    // The lanes `shuffle` selects are known at compile time
+    const auto arg_nodes = expr.get_args();
+    const auto num_args = arg_nodes.size()
+                          - (expr.get_builtin() == Builtin::SHUFFLE);
     std::vector<llvm::Value *> args;
-    const auto &callee_params
-            = llvm::cast<FunctionType>(*callee_handle.type).get_args();
-    for (const auto &arg_node : expr.get_args()) {
+    for (std::size_t i = 0; i < num_args; ++i) {
         IRExprVis arg_vis{gen};
-        arg_node->accept(arg_vis);
-        if (!arg_vis.get_val())
-            return;
-        if (i < callee_params.size()
-            && *arg_vis.get_type() != *(callee_params[i++]))
-            return Log::error("Function parameter type mismatch");
+        arg_nodes[i]->accept(arg_vis);
         args.push_back(arg_vis.get_val());
     }
 
-    handle = {gen.builder.CreateCall(callee, std::move(args)),
-              type->get_ret_type()};
+    const auto *vec = arg_nodes.empty() ? nullptr
+                                        : llvm::dyn_cast<VectorType>(
+                                                  arg_nodes[0]->get_type());
+    auto &builder = gen.builder;
+    switch (expr.get_builtin()) {
+        case Builtin::LEN:
+            val = gen.gen_len(args[0], *expr.get_args()[0]->get_type());
+            return;
+        case Builtin::FREE: {
+            auto free_fn = gen.module->getOrInsertFunction(
+                    "free", gen.builder.getVoidTy(),
+                    gen.builder.getInt8PtrTy());
+            auto *elems = gen.builder.CreateExtractValue(args[0], 0);
+            gen.builder.CreateCall(
+                    free_fn, gen.builder.CreatePointerCast(
+                                     elems, gen.builder.getInt8PtrTy()));
+            val = gen.get_void_val();
+            return;
+        }
+        case Builtin::SPLAT:
+            val = builder.CreateVectorSplat(
+                    llvm::cast<VectorType>(expr.get_type())->get_lanes(),
+                    args[0]);
+            return;
+        case Builtin::EXTRACT:
+            val = builder.CreateExtractElement(
+                    args[0],
+                    gen.gen_lane(args[1], *arg_nodes[1]->get_type(), *vec));
+            return;
+        case Builtin::INSERT:
+            val = builder.CreateInsertElement(
+                    args[0], args[2],
+                    gen.gen_lane(args[1], *arg_nodes[1]->get_type(), *vec));
+            return;
+        case Builtin::SHUFFLE: {
+            const auto mask = expr.get_mask();
+            llvm::SmallVector<int, 16> lanes{mask.begin(), mask.end()};
+            val = builder.CreateShuffleVector(
+                    args[0],
+                    num_args == 2 ? args[1]
+                                  : llvm::PoisonValue::get(args[0]->getType()),
+                    lanes);
+            return;
+        }
+        case Builtin::SELECT:
+            val = builder.CreateSelect(args[0], args[1], args[2]);
+            return;
+        case Builtin::HSUM:
+        case Builtin::HMUL:
+        case Builtin::HMIN:
+        case Builtin::HMAX:
+            val = gen.gen_reduction(expr.get_builtin(), args[0],
+                                    *vec->get_elem());
+            return;
+        case Builtin::ANY:
+            val = builder.CreateOrReduce(args[0]);
+            return;
+        case Builtin::ALL:
+            val = builder.CreateAndReduce(args[0]);
+            return;
+        case Builtin::LOAD:
+        case Builtin::STORE: {
+            const bool is_load = expr.get_builtin() == Builtin::LOAD;
+            const auto &data = llvm::cast<VectorType>(
+                    is_load ? *expr.get_type() : *arg_nodes[2]->get_type());
+            auto *data_type = gen.get_llvm_type(data);
+            auto *ptr = builder.CreatePointerCast(
+                    gen.gen_element_ptr(
+                            args[0], *arg_nodes[0]->get_type(), args[1],
+                            *arg_nodes[1]->get_type(),
+                            gen.bounds_checks ? data.get_lanes() : 0),
+                    data_type->getPointerTo());
+            // Vectors start at any element
+            const auto align = gen.module->getDataLayout().getABITypeAlign(
+                    gen.get_llvm_type(*data.get_elem()));
+            if (is_load) {
+                val = builder.CreateAlignedLoad(data_type, ptr, align);
+            } else {
+                builder.CreateAlignedStore(args[2], ptr, align);
+                val = gen.get_void_val();
+            }
+            return;
+        }
+        case Builtin::NONE:
+            break;
+    }
+
+    auto *callee
+            = gen.module->getFunction(gen.interner.get_str(expr.get_id()));
+
+    if (tail) {
+        gen.gen_tail_call(callee, std::move(args));
+        returned = true;
+        return;
+    }
+    val = gen.gen_call(callee, args);
 }
 
 void IRExprVis::visit(const ScopeExpr &expr) {
-    handle.reset();
-    handle = gen.gen_scope(expr, [] {});
+    val = gen.gen_scope(expr, tail);
+    returned = !val;
 }
 
 void IRExprVis::visit(const IfExpr &expr) {
-    handle.reset();
-
     IRExprVis cond_vis{gen};
     expr.get_cond().accept(cond_vis);
-    if (!cond_vis.get_val())
-        return;
-
-    if (!llvm::isa<BoolType>(*cond_vis.get_type()))
-        return Log::error("Condition must be of type `bool`");
 
     auto *fn = gen.builder.GetInsertBlock()->getParent();
     auto *then = llvm::BasicBlock::Create(gen.context, "", fn);
     auto *or_else = llvm::BasicBlock::Create(gen.context, "");
-    auto *merge = llvm::BasicBlock::Create(gen.context, "");
 
     gen.builder.CreateCondBr(cond_vis.get_val(), then, or_else);
 
-    gen.builder.SetInsertPoint(then);
-    auto then_val = gen.gen_scope(expr.get_then(), [] {});
-    if (!then_val.val)
+    if (tail) {
+        // Both branches return on their own, there is nothing to merge
+        gen.builder.SetInsertPoint(then);
+        if (auto *then_val = gen.gen_scope(expr.get_then(), true))
+            gen.gen_ret(then_val);
+        fn->getBasicBlockList().push_back(or_else);
+        gen.builder.SetInsertPoint(or_else);
+        if (auto *else_val = gen.gen_scope(expr.get_else(), true))
+            gen.gen_ret(else_val);
+        returned = true;
         return;
+    }
+
+    auto *merge = llvm::BasicBlock::Create(gen.context, "");
+    gen.builder.SetInsertPoint(then);
+    auto *then_val = gen.gen_scope(expr.get_then());
     gen.builder.CreateBr(merge);
     then = gen.builder.GetInsertBlock();
 
     fn->getBasicBlockList().push_back(or_else);
     gen.builder.SetInsertPoint(or_else);
-    auto else_val = gen.gen_scope(expr.get_else(), [] {});
-    if (!else_val.val)
-        return;
+    auto *else_val = gen.gen_scope(expr.get_else());
     gen.builder.CreateBr(merge);
     or_else = gen.builder.GetInsertBlock();
 
-    if (*then_val.type != *else_val.type)
-        return Log::error("Types of then and else scope do not match");
-
     fn->getBasicBlockList().push_back(merge);
     gen.builder.SetInsertPoint(merge);
 
-    auto *type = gen.get_llvm_type(*then_val.type);
-    if (!type)
-        return Log::error("Invalid type");
+    if (llvm::isa<VoidType>(expr.get_type())) {
+        val = then_val;
+        return;
+    }
 
-    llvm::Value *result;
-    if(llvm::isa<VoidType>(*then_val.type)) {
-        result = then_val.val;
-    } else {
-        auto *phi = gen.builder.CreatePHI(type, 2);
-        phi->addIncoming(then_val.val, then);
-        phi->addIncoming(else_val.val, or_else);
-        result = phi;
+    auto *phi = gen.builder.CreatePHI(gen.get_llvm_type(*expr.get_type()), 2);
+    phi->addIncoming(then_val, then);
+    phi->addIncoming(else_val, or_else);
+    val = phi;
+}
+
+void IRExprVis::visit(const CastExpr &expr) {
+    IRExprVis operand{gen};
+    expr.get_operand().accept(operand);
+
+    // Arrays passed as slices
+    if (const auto *array
+        = llvm::dyn_cast<ArrayType>(expr.get_operand().get_type())) {
+        auto *first = gen.builder.CreateInBoundsGEP(
+                gen.get_storage_type(*array), operand.get_val(),
+                {gen.builder.getInt32(0), gen.builder.getInt32(0)});
+        auto *slice
+                = llvm::UndefValue::get(gen.get_llvm_type(*expr.get_type()));
+        val = gen.builder.CreateInsertValue(
+                gen.builder.CreateInsertValue(slice, first, 0),
+                gen.builder.getInt32(array->get_size()), 1);
+        return;
     }
+    val = gen.arit_cast(operand.get_val(), *expr.get_operand().get_type(),
+                        *expr.get_type());
+}
 
-    handle = {result, then_val.type};
+void IRExprVis::visit(const AssignExpr &expr) {
+    IRExprVis value{gen};
+    expr.get_value().accept(value);
+    val = gen.get_void_val();
+
+    if (const auto *element = expr.get_element()) {
+        gen.builder.CreateStore(value.get_val(),
+                                gen.gen_element_ptr(*element));
+    } else if (const auto *array
+               = llvm::dyn_cast<ArrayType>(expr.get_value().get_type())) {
+        gen.gen_array_copy(gen.locals[expr.get_local()], value.get_val(),
+                           *array);
+    } else {
+        gen.builder.CreateStore(value.get_val(),
+                                gen.locals[expr.get_local()]);
+    }
 }
 
-void IRStatementVis::visit(const Expr &expr) {
-    handle.reset();
+void IRExprVis::visit(const WhileExpr &expr) {
+    auto *fn = gen.builder.GetInsertBlock()->getParent();
+    auto *cond = llvm::BasicBlock::Create(gen.context, "", fn);
+    auto *body = llvm::BasicBlock::Create(gen.context, "");
+    auto *after = llvm::BasicBlock::Create(gen.context, "");
 
-    IRExprVis expr_vis{gen};
-    expr.accept(expr_vis);
-    handle = expr_vis.get_handle();
+    gen.builder.CreateBr(cond);
+    gen.builder.SetInsertPoint(cond);
+    IRExprVis cond_vis{gen};
+    expr.get_cond().accept(cond_vis);
+    gen.builder.CreateCondBr(cond_vis.get_val(), body, after);
+
+    fn->getBasicBlockList().push_back(body);
+    gen.builder.SetInsertPoint(body);
+    gen.gen_scope(expr.get_body());
+    gen.builder.CreateBr(cond);
+
+    fn->getBasicBlockList().push_back(after);
+    gen.builder.SetInsertPoint(after);
+    val = gen.get_void_val();
 }
 
-void IRStatementVis::visit(const VarDecl &decl) {
-    handle.reset();
+void IRExprVis::visit(const ForExpr &expr) {
+    IRExprVis begin{gen}, end{gen};
+    expr.get_begin().accept(begin);
+    expr.get_end().accept(end);
+    if (expr.is_parallel())
+        gen.gen_par_for(expr, begin.get_val(), end.get_val());
+    else
+        gen.gen_for(expr, begin.get_val(), end.get_val());
+    val = gen.get_void_val();
+}
 
-    const auto &id = decl.get_id();
+void IRExprVis::visit(const IndexExpr &expr) {
+    val = gen.builder.CreateLoad(gen.get_llvm_type(*expr.get_type()),
+                                 gen.gen_element_ptr(expr));
+}
 
-    IRExprVis expr_vis{gen};
-    decl.get_rhs().accept(expr_vis);
-    handle = expr_vis.get_handle();
-    if (!handle.val)
+void IRExprVis::visit(const ArrayExpr &expr) {
+    const auto &type = llvm::cast<ArrayType>(*expr.get_type());
+    auto *storage_type = gen.get_storage_type(type);
+    auto *storage = gen.gen_alloca(storage_type, "");
+    val = storage;
+
+    std::vector<llvm::Value *> elems;
+    for (const auto *elem : expr.get_elems()) {
+        IRExprVis elem_vis{gen};
+        elem->accept(elem_vis);
+        elems.push_back(elem_vis.get_val());
+    }
+    auto elem_ptr = [&](llvm::Value *i) {
+        return gen.builder.CreateInBoundsGEP(storage_type, storage,
+                                             {gen.builder.getInt32(0), i});
+    };
+
+    if (elems.size() == type.get_size()) {
+        for (uint32_t i = 0; i < elems.size(); ++i)
+            gen.builder.CreateStore(elems[i],
+                                    elem_ptr(gen.builder.getInt32(i)));
         return;
+    }
 
-    handle.val->setName(id);
+    // `[x; size]`
+    const auto &layout = gen.module->getDataLayout();
+    auto *fill = llvm::dyn_cast<llvm::Constant>(elems[0]);
+    if (fill && fill->isNullValue()) {
+        gen.builder.CreateMemSet(storage, gen.builder.getInt8(0),
+                                 layout.getTypeAllocSize(storage_type),
+                                 layout.getPrefTypeAlign(storage_type));
+        return;
+    }
 
-    gen.named_values.current_scope(id) = handle;
+    auto *fn = gen.builder.GetInsertBlock()->getParent();
+    auto *preheader = gen.builder.GetInsertBlock();
+    auto *loop = llvm::BasicBlock::Create(gen.context, "", fn);
+    auto *after = llvm::BasicBlock::Create(gen.context, "");
+    gen.builder.CreateBr(loop);
+    gen.builder.SetInsertPoint(loop);
+    auto *i = gen.builder.CreatePHI(gen.builder.getInt32Ty(), 2);
+    i->addIncoming(gen.builder.getInt32(0), preheader);
+    gen.builder.CreateStore(elems[0], elem_ptr(i));
+    auto *next = gen.builder.CreateNUWAdd(i, gen.builder.getInt32(1));
+    i->addIncoming(next, loop);
+    gen.builder.CreateCondBr(
+            gen.builder.CreateICmpULT(next,
+                                      gen.builder.getInt32(type.get_size())),
+            loop, after);
+    fn->getBasicBlockList().push_back(after);
+    gen.builder.SetInsertPoint(after);
 }
 
-void IRStatementVis::visit(const FnDecl &decl) {
-    handle.reset();
-
-    auto *ret_type = gen.get_llvm_type(*decl.get_ret_type());
-    if (!ret_type)
-        return Log::error("Invalid type");
+void IRExprVis::visit(const NewExpr &expr) {
+    IRExprVis size_vis{gen};
+    expr.get_size().accept(size_vis);
+    auto *size_type = gen.builder.getInt64Ty();
+    auto *size = gen.builder.CreateIntCast(
+            size_vis.get_val(), size_type,
+            get_arith_traits(*expr.get_size().get_type())->is_signed);
+    // The length of a slice is an `i32`, negative sizes wrap around to
+    // large unsigned ones
+    if (gen.bounds_checks)
+        gen.gen_bounds_check(gen.builder.CreateICmpULE(
+                size, gen.builder.getInt64(INT32_MAX)));
+
+    auto *elem_type = gen.get_llvm_type(*expr.get_elem());
+    auto calloc_fn = gen.module->getOrInsertFunction(
+            "calloc", gen.builder.getInt8PtrTy(), size_type, size_type);
+    auto *elems = gen.builder.CreateCall(
+            calloc_fn, {size, llvm::ConstantExpr::getSizeOf(elem_type)});
+
+    auto *slice = llvm::UndefValue::get(gen.get_llvm_type(*expr.get_type()));
+    val = gen.builder.CreateInsertValue(
+            gen.builder.CreateInsertValue(
+                    slice,
+                    gen.builder.CreatePointerCast(elems,
+                                                  elem_type->getPointerTo()),
+                    0),
+            gen.builder.CreateTrunc(size, gen.builder.getInt32Ty()), 1);
+}
 
-    std::vector<llvm::Type *> types;
-    std::vector<std::shared_ptr<Type>> internal_types;
-    for (const auto &param : decl.get_params()) {
-        internal_types.push_back(param.second);
-        auto type = gen.get_llvm_type(*param.second);
-        if (!type)
-            return Log::error("Invalid type");
-        types.push_back(std::move(type));
+void IRExprVis::visit(const SpawnExpr &expr) {
+    const auto &call = expr.get_call();
+    std::vector<llvm::Value *> args;
+    for (const auto *arg : call.get_args()) {
+        IRExprVis arg_vis{gen};
+        arg->accept(arg_vis);
+        args.push_back(arg_vis.get_val());
     }
+    val = gen.gen_spawn(
+            *gen.module->getFunction(gen.interner.get_str(call.get_id())),
+            args);
+}
 
-    auto *fn_type = llvm::FunctionType::get(ret_type, types, false);
+void IRExprVis::visit(const AwaitExpr &expr) {
+    IRExprVis future_vis{gen};
+    expr.get_future().accept(future_vis);
+    val = gen.gen_await(future_vis.get_val(), *expr.get_type());
+}
 
-    auto *fn = llvm::Function::Create(fn_type, llvm::Function::ExternalLinkage,
-                                      decl.get_id(), &gen.module);
+void IRStatementVis::visit(const Expr &expr) {
+    IRExprVis expr_vis{gen, tail};
+    expr.accept(expr_vis);
+    val = expr_vis.get_val();
+    returned = expr_vis.has_returned();
+}
 
-    std::size_t i = 0;
-    for (auto &arg : fn->args()) {
-        arg.setName(decl.get_params()[i++].first);
+void IRStatementVis::visit(const VarDecl &decl) {
+    IRExprVis expr_vis{gen};
+    decl.get_rhs().accept(expr_vis);
+    val = expr_vis.get_val();
+
+    const auto name = gen.interner.get_str(decl.get_id());
+    // Each array variable holds its own copy
+    const auto *array = llvm::dyn_cast<ArrayType>(decl.get_rhs().get_type());
+    if (array) {
+        auto *storage = gen.gen_alloca(gen.get_storage_type(*array), name);
+        gen.gen_array_copy(storage, val, *array);
+        gen.locals[decl.get_local()] = storage;
+        return;
+    }
+    if (decl.is_mutable()) {
+        auto *var = gen.gen_alloca(val->getType(), name);
+        gen.builder.CreateStore(val, var);
+        gen.locals[decl.get_local()] = var;
+        return;
     }
+    val->setName(name);
+    gen.locals[decl.get_local()] = val;
+}
 
-    handle = {fn, std::make_shared<FunctionType>(
-                          internal_types, std::move(decl.get_ret_type()))};
-    gen.named_values.current_scope(decl.get_id()) = handle;
+void IRStatementVis::visit(const FnDecl &decl) {
+    val = gen.declare(decl);
 }
 
 void IRStatementVis::visit(const FnDef &def) {
-    handle.reset();
+    val = gen.define(def);
+}
 
-    const auto &id = def.get_decl().get_id();
-    auto fn_handle = gen.named_values[id];
+llvm::Function *IRGenerator::declare(const FnDecl &decl) {
+    std::vector<llvm::Type *> param_types;
+    for (const auto &param : decl.get_params())
+        param_types.push_back(get_llvm_type(*param.second));
 
-    if (fn_handle.val && llvm::isa<FunctionType>(*fn_handle.type))
-        return Log::error("Cannot redefine function (`", id, "`)");
+    auto *fn_type = llvm::FunctionType::get(
+            get_llvm_type(*decl.get_ret_type()), param_types, false);
 
-    if (!fn_handle.val) {
-        IRStatementVis decl_vis{gen};
-        def.get_decl().accept(decl_vis);
-        fn_handle = decl_vis.get_handle();
-        if (!fn_handle.val)
-            return;
-    }
+    auto *fn = llvm::Function::Create(fn_type, llvm::Function::ExternalLinkage,
+                                      interner.get_str(decl.get_id()),
+                                      module.get());
 
-    auto *fn = static_cast<llvm::Function *>(fn_handle.val);
+    std::size_t i = 0;
+    for (auto &arg : fn->args())
+        arg.setName(interner.get_str(decl.get_params()[i++].first));
+
+    const auto &effects = decl.get_effects();
+    if (effects.memory == FnEffects::Memory::NONE)
+        fn->setDoesNotAccessMemory();
+    else if (effects.memory == FnEffects::Memory::READ)
+        fn->setOnlyReadsMemory();
+    if (!effects.unwinds)
+        fn->setDoesNotThrow();
+    // Trapping is neither returning nor undefined behaviour
+    if (effects.terminates && !(effects.may_trap && bounds_checks))
+        fn->addFnAttr(llvm::Attribute::WillReturn);
+    if (!effects.recursive)
+        fn->setDoesNotRecurse();
+
+    return fn;
+}
 
-    auto *bb = llvm::BasicBlock::Create(gen.context, "entry", fn);
-    gen.builder.SetInsertPoint(bb);
+llvm::Function *IRGenerator::define(const FnDef &def) {
+    auto *fn = module->getFunction(interner.get_str(def.get_decl().get_id()));
 
-    const auto &types = def.get_decl().get_params();
-    auto body_val = gen.gen_scope(def.get_body_scope(), [fn, types, this] {
-        std::size_t i = 0;
-        for (auto &arg : fn->args()) {
-            gen.named_values.current_scope(arg.getName())
-                    = {&arg, types[i++].second};
-        }
-    });
+    auto *bb = llvm::BasicBlock::Create(context, "entry", fn);
+    builder.SetInsertPoint(bb);
 
-    if (!body_val.val) {
-        fn->eraseFromParent();
-        return;
-    }
+    locals.assign(def.get_num_locals(), nullptr);
+    std::size_t i = 0;
+    for (auto &arg : fn->args())
+        locals[i++] = &arg;
 
-    const auto &ret_type
-            = *(llvm::cast<FunctionType>(*fn_handle.type).get_ret_type());
-    const bool ret_void = llvm::isa<VoidType>(ret_type);
-    if (*body_val.type != ret_type && !ret_void) {
-        fn->eraseFromParent();
-        return Log::error("Returned value does not match function type");
-    }
+    loop_header = nullptr;
+    tail_recursions.clear();
+    frame_arrays = def.has_local_arrays();
+    gen_return(def.get_body_scope());
+    if (loop_header)
+        gen_tail_loop(*fn);
 
-    if (ret_void) {
-        gen.builder.CreateRetVoid();
-    } else {
-        gen.builder.CreateRet(body_val.val);
+    llvm::raw_os_ostream err{std::cerr};
+    if (llvm::verifyFunction(*fn, &err)) {
+        fn->deleteBody();
+        return nullptr;
     }
 
-    llvm::raw_os_ostream err{std::cerr};
-    if (llvm::verifyFunction(*fn, &err))
-        return;
+    if (optimizer)
+        optimizer->run_on_function(*fn);
 
-    handle = std::move(fn_handle);
+    return fn;
 }
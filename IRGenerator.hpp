@@ -2,115 +2,261 @@
 #define HXWK_IRGENERATOR_H
 
 #include "AST.hpp"
+#include "StringInterner.hpp"
 #include "Type.hpp"
 #include "VisitorPattern.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
-#include <map>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace llvm {
+class TargetMachine;
 class Value;
 }
 
-struct IRHandle {
-    llvm::Value *val;
-    std::shared_ptr<Type> type;
-
-    void reset() {
-        val = nullptr;
-        type.reset();
-    };
-};
-
-class IdScoper {
-  public:
-    using value_t = IRHandle;
-    void enter();
-    void exit();
-    value_t operator[](const std::string &id);
-    value_t &current_scope(const std::string &id);
-
-  private:
-    std::vector<std::map<std::string, value_t>> named_values;
-};
+class Optimizer;
 
+// Lowers a tree annotated by Sema to LLVM IR. All checks have been done by
+// then, so lowering cannot fail.
 class IRGenerator {
   public:
     friend class IRExprVis;
     friend class IRStatementVis;
-    IRGenerator(llvm::StringRef name)
-            : builder{context}, module{std::move(name), context} {
-        named_values.enter();
-        named_values.current_scope("printf")
-                = {llvm::Function::Create(
-                           llvm::FunctionType::get(
-                                   llvm::Type::getInt32Ty(context),
-                                   llvm::Type::getInt8PtrTy(context), true),
-                           llvm::Function::ExternalLinkage, "printf", &module),
-                   std::make_shared<FunctionType>(
-                           std::vector<std::shared_ptr<Type>>{
-                                   std::make_shared<StrLitType>()},
-                           std::make_shared<Int32Type>())};
+    // `context` has to outlive the generator and its module
+    IRGenerator(llvm::LLVMContext &context, llvm::StringRef name,
+                StringInterner &interner)
+            : interner{interner},
+              context{context},
+              builder{context},
+              module{std::make_unique<llvm::Module>(name, context)} {
+        llvm::Function::Create(
+                llvm::FunctionType::get(llvm::Type::getInt32Ty(context),
+                                        llvm::Type::getInt8PtrTy(context),
+                                        true),
+                llvm::Function::ExternalLinkage, "printf", module.get());
     };
 
-    void print() const { module.dump(); };
+    // Functions are optimised by `optimizer` as soon as they are complete
+    void set_optimizer(Optimizer *optimizer) { this->optimizer = optimizer; };
+    // Notes each call in tail position which could not be eliminated
+    void set_report_tail_calls(bool report) { report_tail_calls = report; };
+    // Without bounds checks, indexing out of bounds is undefined behaviour
+    void set_bounds_checks(bool checks) { bounds_checks = checks; };
+    llvm::Module &get_module() { return *module; };
+    // Hands over the finished module, the generator must not be used anymore
+    std::unique_ptr<llvm::Module> take_module() { return std::move(module); };
+
+    // Should be set before generating any code, so that the optimiser can
+    // take the target's data layout into account
+    void set_target(llvm::TargetMachine &tm);
+
+    // Every function has to be declared before any definition calling it is
+    // generated
+    llvm::Function *declare(const FnDecl &decl);
+    // Returns nullptr if the generated code is malformed
+    llvm::Function *define(const FnDef &def);
+
+    void print() const { module->dump(); };
     void write_assembly(std::ostream &stream) const;
     void write_bitcode(std::ostream &stream) const;
+    // Native code emission, returns false if `tm` cannot emit the file type
+    bool write_native_assembly(std::ostream &stream, llvm::TargetMachine &tm);
+    bool write_object(std::ostream &stream, llvm::TargetMachine &tm);
 
   private:
-    template <typename SetupT>
-    IRHandle gen_scope(const ScopeExpr &scope, SetupT setup);
+    bool write_native(std::ostream &stream, llvm::TargetMachine &tm,
+                      bool assembly);
+    // In tail position, the scope's value is returned from the function
+    // unless its last statement is a variable declaration. nullptr is
+    // returned if the scope has returned already.
+    llvm::Value *gen_scope(const ScopeExpr &scope, bool tail = false);
+    // Lowers `expr` in tail position and returns its value
+    void gen_return(const Expr &expr);
+    void gen_ret(llvm::Value *val);
+    // Self tail calls become jumps, others reuse the caller's frame if they
+    // can, unless the caller has local arrays
+    void gen_tail_call(llvm::Function *callee,
+                       std::vector<llvm::Value *> args);
+    // Calls carry the attributes EffectAnalysis gave their callee, which
+    // remain once modules are linked and the callee is only declared
+    llvm::CallInst *gen_call(llvm::Function *callee,
+                             llvm::ArrayRef<llvm::Value *> args);
+    void gen_tail_loop(llvm::Function &fn);
+    // Mutable variables live in allocas in the entry block, where mem2reg
+    // and SROA turn them back into registers
+    llvm::AllocaInst *gen_alloca(llvm::Type *type, llvm::StringRef name);
+    // Stands in for values of type `void`
+    llvm::Value *get_void_val();
+    // The `llvm.loop` metadata for the back edge of a `for` loop
+    llvm::MDNode *gen_loop_id(const LoopHints &hints);
+    // Traps unless `in_bounds` holds, which it is expected to
+    void gen_bounds_check(llvm::Value *in_bounds);
+    // The number of elements of the array, slice or vector `val` of type
+    // `type`
+    llvm::Value *gen_len(llvm::Value *val, const Type &type);
+    // Indices of type `i32` are used as they are, those of other integer
+    // types are extended to 64 bits. Lengths are compared to indices after
+    // zero extension to the same width.
+    llvm::Value *gen_index(llvm::Value *index, const Type &type);
+    // The address of an element, bounds checked unless hoisted
+    llvm::Value *gen_element_ptr(const IndexExpr &expr);
+    // The address of element `index` of the array or slice `base`. Unless
+    // `count` is 0, traps if not all of the `count` elements from there on
+    // are in bounds.
+    llvm::Value *gen_element_ptr(llvm::Value *base, const Type &base_type,
+                                 llvm::Value *index, const Type &index_type,
+                                 unsigned count);
+    // `index` of type `type` as an index of a lane of `vec`, checked
+    llvm::Value *gen_lane(llvm::Value *index, const Type &type,
+                          const VectorType &vec);
+    // Whether all values in [begin, end) index each array and slice the
+    // loop is versioned on. Only meaningful if begin < end.
+    llvm::Value *gen_in_range(const ForExpr &expr, llvm::Value *begin,
+                              llvm::Value *end);
+    // Lowers the loop for the range [begin, end) of the counter. Unless the
+    // whole range is in bounds, runs a copy of the loop which checks the
+    // hoisted indices on each iteration.
+    void gen_for(const ForExpr &expr, llvm::Value *begin, llvm::Value *end);
+    // A single copy of the loop, which checks the hoisted indices if
+    // `checked` is true
+    void gen_loop(const ForExpr &expr, llvm::Value *begin, llvm::Value *end,
+                  bool checked);
+    // The body is outlined into a function which runs a chunk of the range,
+    // see `hxwk_par_for` in Runtime.hpp. Captured variables are passed in a
+    // struct.
+    void gen_par_for(const ForExpr &expr, llvm::Value *begin,
+                     llvm::Value *end);
+    llvm::Function *gen_par_body(const ForExpr &expr,
+                                 llvm::StructType *ctx_type,
+                                 const llvm::Twine &name, bool checked);
+    // Combines the value at its second argument into the first
+    llvm::Function *gen_combine(const Reduction &reduction,
+                                const llvm::Twine &name);
+    // `lhs op rhs` for the operators of reductions
+    llvm::Value *gen_reduce(Tok op, llvm::Value *lhs, llvm::Value *rhs,
+                            const Type &type);
+    llvm::Constant *get_identity(Tok op, const Type &type);
+    // Stores the arguments in the frame of the caller, where the runtime
+    // keeps the task and the thunk stores the result, and starts the call.
+    // Returns the future, the frame's address.
+    llvm::Value *gen_spawn(llvm::Function &callee,
+                           llvm::ArrayRef<llvm::Value *> args);
+    // The task, followed by the result unless it is `void`, followed by the
+    // arguments
+    llvm::StructType *get_spawn_frame_type(llvm::Function &callee);
+    // Calls `callee` with the arguments of a frame, see `hxwk_spawn` in
+    // Runtime.hpp
+    llvm::Function *get_spawn_thunk(llvm::Function &callee);
+    // Waits for the task of a future to finish
+    void gen_join(llvm::Value *task);
+    // Joins and returns the result of type `result`
+    llvm::Value *gen_await(llvm::Value *task, const Type &result);
+    // Lowers `hsum`, `hmul`, `hmin` and `hmax`
+    llvm::Value *gen_reduction(Builtin builtin, llvm::Value *vec,
+                               const Type &lane_type);
+    void gen_array_copy(llvm::Value *dst, llvm::Value *src,
+                        const ArrayType &type);
+    // Arrays are passed around as pointers to their storage, slices as
+    // pairs of a pointer to their first element and their length
     llvm::Type *get_llvm_type(const Type &type);
+    llvm::ArrayType *get_storage_type(const ArrayType &type);
     llvm::Value *arit_cast(llvm::Value *val, const Type &from, const Type &to);
+    std::string get_name(Symbol sym) const {
+        return interner.get_str(sym).str();
+    };
 
-    llvm::LLVMContext context;
+    StringInterner &interner;
+    llvm::LLVMContext &context;
     llvm::IRBuilder<> builder;
-    llvm::Module module;
-    IdScoper named_values;
+    std::unique_ptr<llvm::Module> module;
+    // Values of the current function's locals, indexed as assigned by Sema.
+    // Mutable variables are represented by their alloca, array variables by
+    // their storage.
+    std::vector<llvm::Value *> locals;
+    Optimizer *optimizer{nullptr};
+    bool report_tail_calls{false};
+    bool bounds_checks{true};
+    // Whether the body being generated belongs to the copy of its loop which
+    // checks the hoisted indices
+    bool check_hoisted{false};
+
+    // Self tail calls of the current function jump back to `loop_header`,
+    // which is only inserted once the whole body has been generated
+    struct TailRecursion {
+        llvm::BasicBlock *block;
+        std::vector<llvm::Value *> args;
+    };
+    llvm::BasicBlock *loop_header{nullptr};
+    std::vector<TailRecursion> tail_recursions;
+    // Calls in tail position are regular calls, see FnDef::has_local_arrays
+    bool frame_arrays{false};
+    // The thunks of spawned functions, generated once per module
+    llvm::DenseMap<llvm::Function *, llvm::Function *> spawn_thunks;
 };
 
 class IRExprVis : public ExprVis {
   public:
-    IRExprVis(IRGenerator &gen) : gen{gen} {};
+    // An expression in tail position returns its value from the function
+    // itself if it can do so more efficiently than the caller
+    IRExprVis(IRGenerator &gen, bool tail = false) : gen{gen}, tail{tail} {};
 
+    VISIT(LiteralExpr<bool>);
     VISIT(LiteralExpr<int32_t>);
+    VISIT(LiteralExpr<int64_t>);
     VISIT(LiteralExpr<double>);
-    VISIT(LiteralExpr<std::string>);
+    VISIT(LiteralExpr<Symbol>);
     VISIT(IdExpr);
     VISIT(BinaryExpr);
     VISIT(CallExpr);
     VISIT(ScopeExpr);
     VISIT(IfExpr);
+    VISIT(CastExpr);
+    VISIT(AssignExpr);
+    VISIT(WhileExpr);
+    VISIT(ForExpr);
+    VISIT(IndexExpr);
+    VISIT(ArrayExpr);
+    VISIT(NewExpr);
+    VISIT(SpawnExpr);
+    VISIT(AwaitExpr);
 
-    const IRHandle &get_handle() const { return handle; };
-    llvm::Value *get_val() const { return handle.val; };
-    const std::shared_ptr<Type> &get_type() const { return handle.type; };
+    llvm::Value *get_val() const { return val; };
+    bool has_returned() const { return returned; };
 
   private:
     IRGenerator &gen;
-    IRHandle handle;
+    bool tail;
+    bool returned{false};
+    llvm::Value *val{nullptr};
 };
 
 class IRStatementVis : public StatementVis {
   public:
-    IRStatementVis(IRGenerator &gen) : gen{gen} {};
+    // See IRExprVis, variable declarations are never in tail position
+    IRStatementVis(IRGenerator &gen, bool tail = false)
+            : gen{gen}, tail{tail} {};
 
     VISIT(Expr);
     VISIT(VarDecl);
     VISIT(FnDecl);
     VISIT(FnDef);
 
-    const IRHandle &get_handle() const { return handle; };
-    llvm::Value *get_val() const { return handle.val; };
-    const std::shared_ptr<Type> &get_type() const { return handle.type; };
+    // nullptr if a function definition failed to verify
+    llvm::Value *get_val() const { return val; };
+    bool has_returned() const { return returned; };
 
   private:
     IRGenerator &gen;
-    IRHandle handle;
+    bool tail;
+    bool returned{false};
+    llvm::Value *val{nullptr};
 };
 
 #endif
@@ -0,0 +1,132 @@
+#ifndef HXWK_IDSCOPER_H
+#define HXWK_IDSCOPER_H
+
+#include "StringInterner.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Maps identifiers to the value of their innermost binding. All scopes share
+// one open-addressing hash table holding only the visible binding of each
+// identifier; shadowed bindings are saved in an undo log and restored when
+// their shadowing scope is exited. Lookups are therefore O(1) regardless of
+// nesting depth, and neither lookups nor scope changes allocate once the
+// table has warmed up.
+template <typename Value>
+class IdScoper {
+  public:
+    using value_t = Value;
+
+    IdScoper() : slots(16) {};
+
+    void enter() { scopes.push_back(undo_log.size()); };
+
+    void exit() {
+        const auto mark = scopes.back();
+        scopes.pop_back();
+
+        while (undo_log.size() > mark) {
+            auto &undo = undo_log.back();
+            auto &slot = slots[find_or_insert(undo.id)];
+            slot.depth = undo.depth;
+            slot.val = std::move(undo.val);
+            undo_log.pop_back();
+        }
+    };
+
+    // Returns a default constructed value for unbound identifiers
+    value_t operator[](Symbol id) const {
+        const auto *slot = find(id);
+        return slot && slot->depth != 0 ? slot->val : value_t{};
+    };
+
+    // Binds `id` in the innermost scope, shadowing any outer binding. The
+    // reference is invalidated by the next call to current_scope().
+    value_t &current_scope(Symbol id) {
+        auto &slot = slots[find_or_insert(id)];
+        const auto depth = static_cast<std::uint32_t>(scopes.size());
+        if (slot.depth != depth) {
+            undo_log.push_back({id, slot.depth, std::move(slot.val)});
+            slot.depth = depth;
+            slot.val = value_t{};
+        }
+        return slot.val;
+    };
+
+  private:
+    struct Slot {
+        Symbol id;
+        // Nesting depth of the visible binding, 0 if there is none
+        std::uint32_t depth{0};
+        value_t val{};
+    };
+
+    struct Undo {
+        Symbol id;
+        std::uint32_t depth;
+        value_t val;
+    };
+
+    // Fibonacci hashing spreads the dense symbol ids over the whole table
+    std::size_t home(Symbol id) const {
+        return (id.get_id() * std::uint64_t{0x9E3779B97F4A7C15}) >> shift;
+    };
+
+    const Slot *find(Symbol id) const {
+        const auto mask = slots.size() - 1;
+        for (auto i = home(id);; i = (i + 1) & mask) {
+            if (slots[i].id == id)
+                return &slots[i];
+            if (!slots[i].id)
+                return nullptr;
+        }
+    };
+
+    std::size_t find_or_insert(Symbol id) {
+        auto mask = slots.size() - 1;
+        auto i = home(id);
+        for (; slots[i].id; i = (i + 1) & mask) {
+            if (slots[i].id == id)
+                return i;
+        }
+
+        if (4 * (used + 1) > 3 * slots.size()) {
+            grow();
+            return find_or_insert(id);
+        }
+
+        ++used;
+        slots[i].id = id;
+        return i;
+    };
+
+    // Unbound identifiers are dropped while rehashing, exit() re-inserts the
+    // ones which still have a binding to restore.
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        --shift;
+        used = 0;
+
+        const auto mask = slots.size() - 1;
+        for (auto &slot : old) {
+            if (slot.depth == 0)
+                continue;
+            auto i = home(slot.id);
+            while (slots[i].id)
+                i = (i + 1) & mask;
+            slots[i] = std::move(slot);
+            ++used;
+        }
+    };
+
+    std::vector<Slot> slots;
+    std::size_t used{0};
+    unsigned shift{64 - 4};
+    std::vector<Undo> undo_log;
+    // Size of the undo log on entering each scope
+    std::vector<std::size_t> scopes;
+};
+
+#endif
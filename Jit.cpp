@@ -0,0 +1,174 @@
+#include "Jit.hpp"
+#include "Log.hpp"
+#include "Optimizer.hpp"
+#include "Runtime.hpp"
+#include "Target.hpp"
+#include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+
+Jit::Jit(std::unique_ptr<llvm::orc::LLJIT> jit,
+         llvm::orc::JITTargetMachineBuilder jtmb,
+         std::unique_ptr<llvm::TargetMachine> tm, bool lazy)
+        : jit{std::move(jit)},
+          jtmb{std::move(jtmb)},
+          tm{std::move(tm)},
+          lazy{lazy} {
+    if (!lazy)
+        return;
+
+    // The lazy JIT splits modules so that each partition holds a single
+    // requested function, which passes through here right before codegen.
+    this->jit->getIRTransformLayer().setTransform(
+            [this](llvm::orc::ThreadSafeModule tsm,
+                   const llvm::orc::MaterializationResponsibility &)
+                    -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+                bool ok = tsm.withModuleDo([this](llvm::Module &module) {
+                    return !optimizer || optimizer->run_on_module(module);
+                });
+                if (!ok)
+                    return llvm::make_error<llvm::StringError>(
+                            "Malformed function",
+                            llvm::inconvertibleErrorCode());
+                return tsm;
+            });
+}
+
+template <typename BuilderT>
+static auto build_jit(llvm::orc::JITTargetMachineBuilder jtmb,
+                      llvm::ObjectCache *cache) {
+    BuilderT builder;
+    builder.setJITTargetMachineBuilder(std::move(jtmb));
+    if (cache) {
+        builder.setCompileFunctionCreator(
+                [cache](llvm::orc::JITTargetMachineBuilder jtmb)
+                        -> llvm::Expected<std::unique_ptr<
+                                llvm::orc::IRCompileLayer::IRCompiler>> {
+                    auto tm = jtmb.createTargetMachine();
+                    if (!tm)
+                        return tm.takeError();
+                    return std::make_unique<
+                            llvm::orc::TMOwningSimpleCompiler>(
+                            std::move(*tm), cache);
+                });
+    }
+    return builder.create();
+}
+
+std::unique_ptr<Jit> Jit::create(unsigned opt_level, bool lazy,
+                                 llvm::ObjectCache *cache) {
+    initialize_targets();
+
+    auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb) {
+        Log::error("Cannot detect host: ", llvm::toString(jtmb.takeError()));
+        return nullptr;
+    }
+    jtmb->setCodeGenOptLevel(get_codegen_level(opt_level));
+
+    auto tm = jtmb->createTargetMachine();
+    if (!tm) {
+        Log::error("Cannot create target machine for host: ",
+                   llvm::toString(tm.takeError()));
+        return nullptr;
+    }
+
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    llvm::Error err = llvm::Error::success();
+    if (lazy) {
+        auto lazy_jit = build_jit<llvm::orc::LLLazyJITBuilder>(*jtmb, cache);
+        if (lazy_jit)
+            jit = std::move(*lazy_jit);
+        else
+            err = lazy_jit.takeError();
+    } else {
+        auto eager_jit = build_jit<llvm::orc::LLJITBuilder>(*jtmb, cache);
+        if (eager_jit)
+            jit = std::move(*eager_jit);
+        else
+            err = eager_jit.takeError();
+    }
+    if (err) {
+        Log::error("Cannot create JIT: ", llvm::toString(std::move(err)));
+        return nullptr;
+    }
+
+    auto &main_dylib = jit->getMainJITDylib();
+    auto process_symbols
+            = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                    jit->getDataLayout().getGlobalPrefix());
+    if (!process_symbols) {
+        Log::error("Cannot resolve host symbols: ",
+                   llvm::toString(process_symbols.takeError()));
+        return nullptr;
+    }
+    main_dylib.addGenerator(std::move(*process_symbols));
+
+    // The runtime is linked into the compiler, which need not export it
+    llvm::orc::SymbolMap runtime_symbols;
+    auto add_runtime_symbol = [&](llvm::StringRef name, auto *fn) {
+        runtime_symbols[jit->mangleAndIntern(name)]
+                = llvm::JITEvaluatedSymbol::fromPointer(
+                        fn, llvm::JITSymbolFlags::Exported
+                                    | llvm::JITSymbolFlags::Callable);
+    };
+    add_runtime_symbol("hxwk_par_for", &hxwk_par_for);
+    add_runtime_symbol("hxwk_spawn", &hxwk_spawn);
+    add_runtime_symbol("hxwk_await", &hxwk_await);
+    if (auto err = main_dylib.define(
+                llvm::orc::absoluteSymbols(std::move(runtime_symbols)))) {
+        Log::error("Cannot define runtime symbols: ",
+                   llvm::toString(std::move(err)));
+        return nullptr;
+    }
+
+    return std::unique_ptr<Jit>{
+            new Jit{std::move(jit), std::move(*jtmb), std::move(*tm), lazy}};
+}
+
+std::unique_ptr<llvm::TargetMachine> Jit::create_target_machine() {
+    auto tm = jtmb.createTargetMachine();
+    if (!tm) {
+        Log::error("Cannot create target machine for host: ",
+                   llvm::toString(tm.takeError()));
+        return nullptr;
+    }
+    return std::move(*tm);
+}
+
+bool Jit::add_module(std::unique_ptr<llvm::Module> module,
+                     std::unique_ptr<llvm::LLVMContext> context) {
+    llvm::orc::ThreadSafeModule tsm{std::move(module), std::move(context)};
+    auto err = lazy ? static_cast<llvm::orc::LLLazyJIT &>(*jit)
+                              .addLazyIRModule(std::move(tsm))
+                    : jit->addIRModule(std::move(tsm));
+    if (err)
+        return Log::error_val<bool>("Cannot add module to JIT: ",
+                                    llvm::toString(std::move(err)));
+    return true;
+}
+
+bool Jit::add_object(std::unique_ptr<llvm::MemoryBuffer> object) {
+    if (auto err = jit->addObjectFile(std::move(object)))
+        return Log::error_val<bool>("Cannot add object code to JIT: ",
+                                    llvm::toString(std::move(err)));
+    return true;
+}
+
+void *Jit::lookup(llvm::StringRef name) {
+    auto symbol = jit->lookup(name);
+    if (!symbol)
+        return Log::error_val<void *>("Cannot find `", name.str(), "`: ",
+                                      llvm::toString(symbol.takeError()));
+    return llvm::jitTargetAddressToPointer<void *>(symbol->getAddress());
+}
@@ -0,0 +1,68 @@
+#ifndef HXWK_JIT_H
+#define HXWK_JIT_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include <memory>
+
+namespace llvm {
+class LLVMContext;
+class MemoryBuffer;
+class Module;
+class ObjectCache;
+class TargetMachine;
+}
+
+class Optimizer;
+
+// Compiles modules for the host in-process with ORC's LLJIT. Symbols which
+// are not defined by any added module, like `printf`, are resolved against
+// the running process.
+//
+// A lazy JIT compiles each function only when it is first called. Calls go
+// through stubs which start out pointing at the compiler, so functions that
+// are never called are never optimised or turned into machine code.
+class Jit {
+  public:
+    // Returns nullptr after reporting an error if the host is not supported.
+    // Object code is looked up in and added to `cache` if one is given.
+    static std::unique_ptr<Jit> create(unsigned opt_level, bool lazy = false,
+                                       llvm::ObjectCache *cache = nullptr);
+
+    Jit(const Jit &) = delete;
+    Jit &operator=(const Jit &) = delete;
+
+    // Describes the host the same way the JIT compiles for it, so modules
+    // should be given its triple and data layout and be optimised for it.
+    llvm::TargetMachine &get_target_machine() { return *tm; };
+    // Another such target machine, e.g. for use on a different thread
+    std::unique_ptr<llvm::TargetMachine> create_target_machine();
+    bool is_lazy() const { return lazy; };
+    // Only used by a lazy JIT, which optimises every function right before
+    // compiling it instead of expecting the added modules to be optimised.
+    void set_optimizer(Optimizer *optimizer) { this->optimizer = optimizer; };
+
+    // The module must have been created within `context`, which the JIT takes
+    // over along with it.
+    bool add_module(std::unique_ptr<llvm::Module> module,
+                    std::unique_ptr<llvm::LLVMContext> context);
+    // Adds object code compiled for the host earlier
+    bool add_object(std::unique_ptr<llvm::MemoryBuffer> object);
+    // Compiles what is necessary to call `name`, returns nullptr after
+    // reporting an error if it cannot be found.
+    void *lookup(llvm::StringRef name);
+
+  private:
+    Jit(std::unique_ptr<llvm::orc::LLJIT> jit,
+        llvm::orc::JITTargetMachineBuilder jtmb,
+        std::unique_ptr<llvm::TargetMachine> tm, bool lazy);
+
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    llvm::orc::JITTargetMachineBuilder jtmb;
+    std::unique_ptr<llvm::TargetMachine> tm;
+    bool lazy;
+    Optimizer *optimizer{nullptr};
+};
+
+#endif
@@ -1,151 +1,154 @@
 #include "Lexer.hpp"
 #include "Log.hpp"
+#include "TokenTable.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/SHA1.h"
 #include <cctype>
-#include <iostream>
+#include <cstdint>
+#include <cstdlib>
 
 #define error_inv(...) Log::error_val<Tok, Tok::INVALID>(cur_loc, __VA_ARGS__)
 
-int Lexer::get_char() {
-    int cur_char = std::cin.get();
-
-    if (cur_char == '\n') {
-        ++cur_loc.line;
-        cur_loc.col = 0;
-    } else {
-        ++cur_loc.col;
-    }
-
-    return cur_char;
-}
-
-int Lexer::peek_char() {
-    return std::cin.peek();
+void Lexer::update_digest() {
+    // The length keeps token boundaries apart, `ab` differs from `a b`
+    const auto len = static_cast<uint32_t>(cur - tok_begin);
+    uint8_t header[5] = {static_cast<uint8_t>(cur_tok)};
+    llvm::support::endian::write32le(header + 1, len);
+    digest->update(llvm::ArrayRef<uint8_t>{header});
+    digest->update(llvm::StringRef{tok_begin, len});
 }
 
 Tok Lexer::get_next_tok() {
     if (cur_tok == Tok::END)
         return cur_tok;
+    if (digest && tok_begin)
+        update_digest();
+
+    // Whitespace and line comments
+    while (true) {
+        advance_over(scan.skip_space(cur, end));
+        if (cur == end || cur[0] != '/' || cur[1] != '/')
+            break;
+
+        // The carriage return preceding a newline on e.g. Windows machines
+        // is part of the skipped comment and should theoretically not bother
+        // the lexing, but this behaviour remains to be tested.
+        const auto *newline = static_cast<const char *>(
+                std::memchr(cur, '\n', end - cur));
+        advance_to(newline ? newline : end);
+    }
 
-    int cur_char;
-    while (std::isspace(cur_char = get_char()))
-        ;
+    tok_begin = cur;
+    int cur_char = get_char();
 
     switch (cur_char) {
-        case '/':
-            if (peek_char() == '/') {
-                // The carriage return preceding a newline on e.g. Windows
-                // machines should just be consumed by getchar and
-                // theoretically not bother the lexing, but this behaviour
-                // remains to be tested.
-                while ((cur_char = get_char()) != '\n' && cur_char != eof)
-                    ;
-                return get_next_tok();
-            }
-            return cur_tok = Tok::SLASH;
         case eof:
             return cur_tok = Tok::END;
-        case ',':
-            return cur_tok = Tok::COMMA;
-        case ':':
-            return cur_tok = Tok::COLON;
-        case ';':
-            return cur_tok = Tok::SEMICOLON;
-        case '=':
-            return cur_tok = Tok::EQ;
-        case '+':
-            return cur_tok = Tok::PLUS;
-        case '-':
-            if (peek_char() == '>') {
+        case '"': {
+            // Literals without escape sequences or line breaks are interned
+            // straight from the source buffer.
+            const char *lit_end = cur;
+            while (lit_end != end && *lit_end != '"' && *lit_end != '\\'
+                   && *lit_end != '\n')
+                ++lit_end;
+
+            if (lit_end == end || *lit_end == '"') {
+                id = interner.intern({cur, std::size_t(lit_end - cur)});
+                advance_to(lit_end);
                 get_char();
-                return cur_tok = Tok::RARROW;
+                return cur_tok = Tok::L_STR;
             }
-            return cur_tok = Tok::MINUS;
-        case '*':
-            return cur_tok = Tok::MULT;
-        case '<':
-            return cur_tok = Tok::CMP_LT;
-        case '(':
-            return cur_tok = Tok::P_OPEN;
-        case ')':
-            return cur_tok = Tok::P_CLOSE;
-        case '{':
-            return cur_tok = Tok::BR_OPEN;
-        case '}':
-            return cur_tok = Tok::BR_CLOSE;
-        case '"':
-            id.clear();
+
+            str_buf.assign(cur, lit_end);
+            advance_to(lit_end);
             while ((cur_char = get_char()) != '"' && cur_char != eof) {
                 if (cur_char == '\n')
                     continue;
 
                 if (cur_char != '\\') {
-                    id += cur_char;
+                    str_buf += cur_char;
                     continue;
                 }
 
                 switch (get_char()) {
                     case 'n':
-                        id += '\n';
+                        str_buf += '\n';
                         break;
                     case '\\':
-                        id += '\\';
+                        str_buf += '\\';
                         break;
                     case '"':
-                        id += '"';
+                        str_buf += '"';
                         break;
                 }
             }
+            id = interner.intern(str_buf);
             return cur_tok = Tok::L_STR;
+        }
     }
 
-    if (std::isalpha(cur_char)) {
-        id = cur_char;
-        while (std::isalnum(peek_char()))
-            id += get_char();
-
-        if (id == "let")
-            return cur_tok = Tok::LET;
-
-        if (id == "if")
-            return cur_tok = Tok::IF;
+    if (const auto *op = find_operator(tok_begin)) {
+        advance_to(tok_begin + spelling_length(*op));
+        return cur_tok = op->tok;
+    }
 
-        if (id == "else")
-            return cur_tok = Tok::ELSE;
+    if (std::isalpha(cur_char)) {
+        const char *id_end = scan.skip_alnum(cur, end);
+        advance_to(id_end);
+        const std::size_t len = id_end - tok_begin;
 
-        if (id == "fn")
-            return cur_tok = Tok::FN;
+        if (const auto *kw = find_keyword(tok_begin, len)) {
+            type_kind = kw->type_kind;
+            return cur_tok = kw->tok;
+        }
 
+        id = interner.intern({tok_begin, len});
         return cur_tok = Tok::ID;
     }
 
     const bool is_point = (cur_char == '.');
 
     if (std::isdigit(cur_char) || is_point) {
-        // TODO: Find out, why the following line doesn't work as intended
-        // std::string number{1, static_cast<char>(cur_char)};
-        std::string number;
-        number = cur_char;
-
-        if (!is_point) {
-            while (std::isdigit(peek_char()))
-                number += get_char();
-
-            if (peek_char() != '.') {
-                l_int32 = std::stoi(number);
-                return cur_tok = Tok::L_INT32;
+        const char *num_end = scan.skip_digits(cur, end);
+
+        // `1..` starts a range, not a floating point literal
+        if (!is_point
+            && (num_end == end || *num_end != '.'
+                || (num_end + 1 != end && num_end[1] == '.'))) {
+            advance_to(num_end);
+
+            std::int64_t val = 0;
+            for (const char *digit = tok_begin; digit != num_end; ++digit) {
+                if (val > (INT64_MAX - (*digit - '0')) / 10)
+                    return error_inv("Integer literal out of range");
+                val = val * 10 + (*digit - '0');
+            }
+            if (val > INT32_MAX) {
+                l_int64 = val;
+                return cur_tok = Tok::L_INT64;
             }
-            number += get_char();
+            l_int32 = static_cast<int32_t>(val);
+            return cur_tok = Tok::L_INT32;
         }
 
-        while (std::isdigit(peek_char()))
-            number += get_char();
+        if (!is_point)
+            num_end = scan.skip_digits(num_end + 1, end);
+        advance_to(num_end);
 
-        if (number == ".")
+        if (num_end - tok_begin == 1 && is_point)
             return error_inv(
                     "Expected numbers following or preceding decimal mark "
                     "`.`");
 
-        l_double = std::stod(number);
+        // strtod would happily consume exponents or hexadecimal notation
+        // following the literal, so it only gets to see the scanned digits.
+        // Only unusually long literals are copied to the heap.
+        llvm::SmallString<64> number{
+                llvm::StringRef(tok_begin, num_end - tok_begin)};
+        l_double = std::strtod(number.c_str(), nullptr);
         return cur_tok = Tok::L_DOUBLE;
     }
     return error_inv("Invalid character `", static_cast<char>(cur_char), "`");
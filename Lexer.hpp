@@ -1,8 +1,19 @@
 #ifndef HXWK_LEXER_H
 #define HXWK_LEXER_H
 
+#include "CharScan.hpp"
+#include "SourceBuffer.hpp"
+#include "StringInterner.hpp"
+#include "Type.hpp"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <cstring>
 #include <string>
 
+namespace llvm {
+class SHA1;
+}
+
 enum class Tok {
     INVALID,
     END,
@@ -10,15 +21,27 @@ enum class Tok {
     COLON,
     SEMICOLON,
     LET,
+    MUT,
     IF,
     ELSE,
+    WHILE,
+    FOR,
+    PAR,
+    IN,
+    NEW,
+    SPAWN,
+    AWAIT,
+    AS,
+    VEC,
     EQ,
     PLUS,
     MINUS,
     MULT,
     SLASH,
     CMP_LT,
+    CMP_GT,
     L_INT32,
+    L_INT64,
     L_DOUBLE,
     L_STR,
     ID,
@@ -27,7 +50,13 @@ enum class Tok {
     P_CLOSE,
     BR_OPEN,
     BR_CLOSE,
+    SQ_OPEN,
+    SQ_CLOSE,
+    ATTR_OPEN,
+    DOTDOT,
     RARROW,
+    TYPE,
+    NUM_TOKS
 };
 
 struct CodeLocation {
@@ -36,22 +65,74 @@ struct CodeLocation {
 
 class Lexer {
   public:
-    Lexer() { get_next_tok(); };
+    Lexer(const SourceBuffer &src, StringInterner &interner)
+            : cur{src.begin()}, end{src.end()}, interner{interner} {
+        get_next_tok();
+    };
     Tok get_tok() const { return cur_tok; };
     Tok get_next_tok();
-    std::string get_id() const { return id; };
+    // Payload of `Tok::ID` and `Tok::L_STR`
+    Symbol get_id() const { return id; };
+    llvm::StringRef get_id_str() const { return interner.get_str(id); };
+    // Payload of `Tok::TYPE`
+    Type::TypeKind get_type_kind() const { return type_kind; };
     int32_t get_int32() const { return l_int32; };
+    // Payload of `Tok::L_INT64`, integer literals too large for `i32`
+    int64_t get_int64() const { return l_int64; };
     double get_double() const { return l_double; };
     CodeLocation get_loc() const { return cur_loc; };
+    // Feeds the kind and spelling of every token passed over into `digest`,
+    // until it is set to nullptr again. Whitespace and comments are left
+    // out, so reformatting does not change the digest.
+    void set_digest(llvm::SHA1 *digest) { this->digest = digest; };
 
   private:
     static constexpr int eof = std::char_traits<char>::eof();
-    int get_char();
-    int peek_char();
+    int get_char() {
+        if (cur == end)
+            return eof;
+
+        const char cur_char = *cur++;
+        if (cur_char == '\n') {
+            ++cur_loc.line;
+            cur_loc.col = 0;
+        } else {
+            ++cur_loc.col;
+        }
+        return static_cast<unsigned char>(cur_char);
+    };
+    int peek_char() const {
+        return cur == end ? eof : static_cast<unsigned char>(*cur);
+    };
+    // Consumes characters up to `pos`, which must not cross a newline.
+    void advance_to(const char *pos) {
+        cur_loc.col += pos - cur;
+        cur = pos;
+    };
+    // Consumes characters up to `pos`, keeping track of line breaks.
+    void advance_over(const char *pos) {
+        while (const auto *newline = static_cast<const char *>(
+                       std::memchr(cur, '\n', pos - cur))) {
+            ++cur_loc.line;
+            cur_loc.col = 0;
+            cur = newline + 1;
+        }
+        advance_to(pos);
+    };
+    void update_digest();
 
+    const char *cur;
+    const char *end;
+    const char *tok_begin{nullptr};
+    llvm::SHA1 *digest{nullptr};
+    StringInterner &interner;
+    const CharScanner &scan{CharScanner::best()};
     Tok cur_tok{Tok::INVALID};
-    std::string id;
+    Symbol id;
+    std::string str_buf;
+    Type::TypeKind type_kind;
     int32_t l_int32;
+    int64_t l_int64;
     double l_double;
     CodeLocation cur_loc{1, 0};
 };
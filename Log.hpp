@@ -12,12 +12,14 @@ class Log {
     template <typename... Args>
     static void error(Args &&... args) {
         std::cerr << "Error: ";
-#ifdef __cpp_fold_expressions
-        (std::cerr << ... << std::forward<Args>(args)) << '\n';
-#else
-        fold_helper((std::cerr << std::forward<Args>(args))...);
-        std::cerr << '\n';
-#endif
+        write_line(std::forward<Args>(args)...);
+    }
+
+    // For diagnostics which do not stop compilation
+    template <typename... Args>
+    static void note(Args &&... args) {
+        std::cerr << "Note: ";
+        write_line(std::forward<Args>(args)...);
     }
 
     template <typename... Args>
@@ -39,9 +41,20 @@ class Log {
     }
 
   private:
-#ifndef __cpp_fold_expressions
     template <typename... Args>
-    static void fold_helper(Args &&...) {}
+    static void write_line(Args &&... args) {
+#ifdef __cpp_fold_expressions
+        (std::cerr << ... << std::forward<Args>(args)) << '\n';
+#else
+        // Braced initialisers are evaluated left to right, unlike function
+        // arguments
+        fold_helper{0, ((std::cerr << std::forward<Args>(args)), 0)...};
+        std::cerr << '\n';
+#endif
+    }
+
+#ifndef __cpp_fold_expressions
+    using fold_helper = int[];
 #endif
 };
 
@@ -0,0 +1,56 @@
+#include "Optimizer.hpp"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_os_ostream.h"
+#include <iostream>
+
+static llvm::OptimizationLevel get_opt_level(unsigned level) {
+    switch (level) {
+        case 0:
+            return llvm::OptimizationLevel::O0;
+        case 1:
+            return llvm::OptimizationLevel::O1;
+        case 2:
+            return llvm::OptimizationLevel::O2;
+        default:
+            return llvm::OptimizationLevel::O3;
+    }
+}
+
+Optimizer::Optimizer(unsigned level, llvm::TargetMachine *tm)
+        : level{level}, builder{tm} {
+    builder.registerModuleAnalyses(mam);
+    builder.registerCGSCCAnalyses(cgam);
+    builder.registerFunctionAnalyses(fam);
+    builder.registerLoopAnalyses(lam);
+    builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    auto opt_level = get_opt_level(level);
+    if (level == 0) {
+        mpm = builder.buildO0DefaultPipeline(opt_level);
+    } else {
+        fpm = builder.buildFunctionSimplificationPipeline(
+                opt_level, llvm::ThinOrFullLTOPhase::None);
+        mpm = builder.buildPerModuleDefaultPipeline(opt_level);
+    }
+}
+
+void Optimizer::run_on_function(llvm::Function &fn) {
+    if (level == 0)
+        return;
+
+    fpm.run(fn, fam);
+    // Later functions change the module the cached results are based on
+    fam.clear();
+}
+
+bool Optimizer::run_on_module(llvm::Module &module) {
+    llvm::raw_os_ostream err{std::cerr};
+    if (llvm::verifyModule(module, &err))
+        return false;
+
+    mpm.run(module, mam);
+    mam.clear();
+    return true;
+}
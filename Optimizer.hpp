@@ -0,0 +1,43 @@
+#ifndef HXWK_OPTIMIZER_H
+#define HXWK_OPTIMIZER_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+
+namespace llvm {
+class Function;
+class Module;
+class TargetMachine;
+}
+
+// Runs LLVM's default pipelines for an optimisation level of 0 to 3. Functions
+// can be simplified on their own as soon as they are complete, so that work
+// overlaps with parsing the rest of the file; the module pipeline then does
+// the interprocedural work once everything has been generated.
+class Optimizer {
+  public:
+    // Without a target machine, passes fall back to generic cost models
+    Optimizer(unsigned level, llvm::TargetMachine *tm = nullptr);
+    Optimizer(const Optimizer &) = delete;
+    Optimizer &operator=(const Optimizer &) = delete;
+
+    unsigned get_level() const { return level; };
+
+    void run_on_function(llvm::Function &fn);
+    // Returns false if the module is malformed
+    bool run_on_module(llvm::Module &module);
+
+  private:
+    unsigned level;
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+    llvm::PassBuilder builder;
+
+    llvm::FunctionPassManager fpm;
+    llvm::ModulePassManager mpm;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "ParallelCodegen.hpp"
+#include "AST.hpp"
+#include "IRGenerator.hpp"
+#include "Optimizer.hpp"
+#include "StringInterner.hpp"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Target/TargetMachine.h"
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+ParallelCodegen::ParallelCodegen(llvm::ArrayRef<const FnDecl *> decls,
+                                 llvm::ArrayRef<const FnDef *> defs,
+                                 StringInterner &interner, unsigned opt_level,
+                                 TargetFactory create_target)
+        : interner{interner},
+          opt_level{opt_level},
+          create_target{std::move(create_target)},
+          decls{decls},
+          defs{defs} {}
+
+bool ParallelCodegen::run_worker(llvm::ArrayRef<const FnDef *> defs,
+                                 Output kind, std::string &output) const {
+    std::unique_ptr<llvm::TargetMachine> tm;
+    {
+        std::lock_guard<std::mutex> lock{create_target_mutex};
+        tm = create_target();
+    }
+    if (!tm)
+        return false;
+
+    llvm::LLVMContext context;
+    IRGenerator gen{context, "Hexenwerk", interner};
+    gen.set_target(*tm);
+    gen.set_report_tail_calls(report_tail_calls);
+    gen.set_bounds_checks(bounds_checks);
+    Optimizer optimizer{opt_level, tm.get()};
+    gen.set_optimizer(&optimizer);
+    for (const auto *decl : decls)
+        gen.declare(*decl);
+    for (const auto *def : defs) {
+        if (!gen.define(*def))
+            return false;
+    }
+    if (!optimizer.run_on_module(gen.get_module()))
+        return false;
+
+    std::ostringstream stream;
+    bool ok = true;
+    if (kind == Output::OBJECT)
+        ok = gen.write_object(stream, *tm);
+    else
+        gen.write_bitcode(stream);
+    output = stream.str();
+    return ok;
+}
+
+bool ParallelCodegen::run(unsigned jobs, Output kind) {
+    // Neighbouring definitions tend to call each other, so each worker gets
+    // a contiguous range to keep inlining opportunities together
+    jobs = std::max(1u, std::min<unsigned>(jobs, defs.size()));
+    outputs.assign(jobs, {});
+    std::vector<char> ok(jobs, false);
+
+    {
+        llvm::ThreadPool pool{llvm::hardware_concurrency(jobs)};
+        const std::size_t per_job = (defs.size() + jobs - 1) / jobs;
+        for (unsigned i = 0; i < jobs; ++i) {
+            const std::size_t begin = std::min(i * per_job, defs.size());
+            const std::size_t end = std::min(begin + per_job, defs.size());
+            llvm::ArrayRef<const FnDef *> share{defs.data() + begin,
+                                                 end - begin};
+            pool.async([this, share, kind, &ok, i] {
+                ok[i] = run_worker(share, kind, outputs[i]);
+            });
+        }
+        pool.wait();
+    }
+
+    return std::all_of(ok.begin(), ok.end(), [](char ok) { return ok; });
+}
@@ -0,0 +1,64 @@
+#ifndef HXWK_PARALLELCODEGEN_H
+#define HXWK_PARALLELCODEGEN_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class TargetMachine;
+}
+
+class FnDecl;
+class FnDef;
+class StringInterner;
+
+// Generates, optimises and emits function definitions on several threads.
+// Once Sema has annotated the tree, function bodies are independent of each
+// other, so each worker gets its own LLVMContext, module, optimiser and
+// target machine. The workers only share the tree and the interner, both of
+// which are just read from.
+//
+// Every worker declares all functions, calls between workers are resolved by
+// linking the outputs. The optimiser can only inline within a worker.
+class ParallelCodegen {
+  public:
+    enum class Output { OBJECT, BITCODE };
+    using TargetFactory
+            = std::function<std::unique_ptr<llvm::TargetMachine>()>;
+
+    // `decls` and `defs` are as collected by Sema, they must stay alive
+    // until `run` returns
+    ParallelCodegen(llvm::ArrayRef<const FnDecl *> decls,
+                    llvm::ArrayRef<const FnDef *> defs,
+                    StringInterner &interner, unsigned opt_level,
+                    TargetFactory create_target);
+    void set_report_tail_calls(bool report) { report_tail_calls = report; };
+    void set_bounds_checks(bool checks) { bounds_checks = checks; };
+    // Splits the definitions among `jobs` workers, each of which produces
+    // one output. Returns false after errors were reported.
+    bool run(unsigned jobs, Output kind);
+
+    // One object file or bitcode module per worker, in a deterministic order
+    const std::vector<std::string> &get_outputs() const { return outputs; };
+
+  private:
+    bool run_worker(llvm::ArrayRef<const FnDef *> defs, Output kind,
+                    std::string &output) const;
+
+    StringInterner &interner;
+    unsigned opt_level;
+    bool report_tail_calls{false};
+    bool bounds_checks{true};
+    // The factory need not be thread-safe
+    mutable std::mutex create_target_mutex;
+    TargetFactory create_target;
+    llvm::ArrayRef<const FnDecl *> decls;
+    llvm::ArrayRef<const FnDef *> defs;
+    std::vector<std::string> outputs;
+};
+
+#endif
@@ -1,22 +1,23 @@
 #include "Parser.hpp"
 #include "AST.hpp"
-#include "C++11Compat.hpp"
 #include "Log.hpp"
 #include "Type.hpp"
-#include <map>
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Casting.h"
 #include <string>
 #include <tuple>
-#include <vector>
 
 #define error_null(...)                                                       \
     Log::error_val<std::nullptr_t>(lex.get_loc(), __VA_ARGS__)
 
-static std::map<Tok, std::pair<int, Assoc>> binary_precedence{
-        {Tok::EQ, {10, Assoc::RIGHT}},  {Tok::CMP_LT, {17, Assoc::LEFT}},
-        {Tok::PLUS, {20, Assoc::LEFT}}, {Tok::MINUS, {20, Assoc::LEFT}},
-        {Tok::MULT, {30, Assoc::LEFT}}, {Tok::SLASH, {30, Assoc::LEFT}}};
+std::pair<int, Assoc> Parser::get_precedence(Tok tok) {
+    const auto *op = find_operator(tok);
+    if (!op)
+        return {0, Assoc::LEFT};
+    return {op->precedence, op->assoc};
+}
 
-std::unique_ptr<Statement> Parser::parse() {
+Statement *Parser::parse() {
     switch (lex.get_tok()) {
         case Tok::SEMICOLON:
             lex.get_next_tok();
@@ -32,26 +33,53 @@ std::unique_ptr<Statement> Parser::parse() {
 
 // Differs from the other functions as it does not expect its first token to be
 // valid.
-std::unique_ptr<Type> Parser::parse_type() {
-    if (lex.get_tok() != Tok::ID)
+const Type *Parser::parse_type() {
+    if (lex.get_tok() == Tok::SQ_OPEN) {
+        lex.get_next_tok();
+        const auto *elem = parse_type();
+        if (!elem)
+            return nullptr;
+        if (lex.get_next_tok() != Tok::SQ_CLOSE)
+            return error_null("Expected closing bracket `]`");
+        return types.get_slice(elem);
+    }
+    if (lex.get_tok() == Tok::VEC) {
+        if (lex.get_next_tok() != Tok::CMP_LT)
+            return error_null("Expected `<` following `vec`");
+        lex.get_next_tok();
+        const auto *elem = parse_type();
+        if (!elem)
+            return nullptr;
+        if (!get_arith_traits(*elem))
+            return error_null("Lanes of a vector must be of arithmetic type");
+
+        // Without a number of lanes, the vector fills a register
+        if (lex.get_next_tok() == Tok::CMP_GT) {
+            if (llvm::isa<BoolType>(elem))
+                return error_null("Vectors of `bool` need a number of lanes");
+            return types.get_vector(elem, types.get_native_lanes(*elem));
+        }
+        if (lex.get_tok() != Tok::COMMA)
+            return error_null("Expected comma `,` or `>`");
+        if (lex.get_next_tok() != Tok::L_INT32 || lex.get_int32() < 1)
+            return error_null("Expected positive integer literal");
+        const auto lanes = static_cast<uint32_t>(lex.get_int32());
+        if (lex.get_next_tok() != Tok::CMP_GT)
+            return error_null("Expected `>` closing the vector type");
+        return types.get_vector(elem, lanes);
+    }
+    if (lex.get_tok() == Tok::ID)
+        return error_null("Unknown type identifier ", lex.get_id_str().str());
+    if (lex.get_tok() != Tok::TYPE)
         return error_null("Expected type identifier");
 
-    auto type_id = lex.get_id();
-
-    if (type_id == "double") {
-        return std::make_unique<DoubleType>();
-    } else if (type_id == "i32") {
-        return std::make_unique<Int32Type>();
-    } else if (type_id == "bool") {
-        return std::make_unique<BoolType>();
-    } else if (type_id == "void") {
-        return std::make_unique<VoidType>();
-    } else {
-        return error_null("Unknown type identifier ", type_id);
-    }
+    const auto *type = types.get_simple(lex.get_type_kind());
+    if (!type)
+        return error_null("Unknown type identifier");
+    return type;
 }
 
-std::unique_ptr<Statement> Parser::parse_fn() {
+Statement *Parser::parse_fn() {
     Tok cur_tok = lex.get_next_tok();
     if (cur_tok != Tok::ID)
         return error_null("Expected identifier");
@@ -60,7 +88,7 @@ std::unique_ptr<Statement> Parser::parse_fn() {
     if ((cur_tok = lex.get_next_tok()) != Tok::P_OPEN)
         return error_null("Expected opening parenthesis `(`");
 
-    std::vector<FnDecl::Param_t> params;
+    llvm::SmallVector<FnDecl::Param_t, 4> params;
 
     if ((cur_tok = lex.get_next_tok()) == Tok::ID) {
         do {
@@ -70,11 +98,11 @@ std::unique_ptr<Statement> Parser::parse_fn() {
                 return error_null("Expected colon `:`");
             lex.get_next_tok();
 
-            auto type = parse_type();
+            const auto *type = parse_type();
             if (!type)
                 return nullptr;
 
-            params.push_back({std::move(id), std::move(type)});
+            params.push_back({id, type});
         } while ((cur_tok = lex.get_next_tok()) == Tok::COMMA
                  && (cur_tok = lex.get_next_tok()) == Tok::ID);
     }
@@ -86,11 +114,12 @@ std::unique_ptr<Statement> Parser::parse_fn() {
         return error_null("Expected right arrow `->`");
 
     lex.get_next_tok();
-    auto ret_type = parse_type();
+    const auto *ret_type = parse_type();
+    if (!ret_type)
+        return nullptr;
 
     if ((cur_tok = lex.get_next_tok()) == Tok::SEMICOLON)
-        return std::make_unique<FnDecl>(std::move(id), std::move(params),
-                                        std::move(ret_type));
+        return arena.make<FnDecl>(id, arena.copy(params), ret_type);
 
     if (cur_tok != Tok::BR_OPEN)
         return error_null("Expected opening brace `{`");
@@ -99,12 +128,11 @@ std::unique_ptr<Statement> Parser::parse_fn() {
     if (!fn_body_scope)
         return nullptr;
 
-    auto decl = std::make_unique<FnDecl>(std::move(id), std::move(params),
-                                         std::move(ret_type));
-    return std::make_unique<FnDef>(std::move(decl), std::move(fn_body_scope));
+    auto *decl = arena.make<FnDecl>(id, arena.copy(params), ret_type);
+    return arena.make<FnDef>(decl, fn_body_scope);
 }
 
-std::unique_ptr<Statement> Parser::parse_scope_body() {
+Statement *Parser::parse_scope_body() {
     switch (Tok cur_tok = lex.get_tok()) {
         case Tok::SEMICOLON:
             lex.get_next_tok();
@@ -112,10 +140,19 @@ std::unique_ptr<Statement> Parser::parse_scope_body() {
         case Tok::LET:
             return parse_var_decl();
         case Tok::IF:
+        case Tok::WHILE:
+        case Tok::FOR:
+        case Tok::PAR:
+        case Tok::ATTR_OPEN:
+        case Tok::NEW:
+        case Tok::SPAWN:
+        case Tok::AWAIT:
+        case Tok::SQ_OPEN:
         case Tok::BR_OPEN:
         case Tok::P_OPEN:
         case Tok::ID:
         case Tok::L_INT32:
+        case Tok::L_INT64:
         case Tok::L_DOUBLE:
         case Tok::L_STR:
             return parse_expr();
@@ -124,8 +161,11 @@ std::unique_ptr<Statement> Parser::parse_scope_body() {
     }
 }
 
-std::unique_ptr<VarDecl> Parser::parse_var_decl() {
+VarDecl *Parser::parse_var_decl() {
     Tok cur_tok = lex.get_next_tok();
+    bool is_mut = cur_tok == Tok::MUT;
+    if (is_mut)
+        cur_tok = lex.get_next_tok();
     if (cur_tok != Tok::ID)
         return error_null("Expected identifier");
 
@@ -140,57 +180,67 @@ std::unique_ptr<VarDecl> Parser::parse_var_decl() {
     if (!expr)
         return nullptr;
 
-    return std::make_unique<VarDecl>(id, std::move(expr));
+    return arena.make<VarDecl>(id, expr, is_mut);
 }
 
-std::unique_ptr<Expr> Parser::parse_expr() {
-    return parse_expr_rhs(0, parse_primary());
+Expr *Parser::parse_expr() {
+    auto *lhs = parse_postfix(parse_primary());
+    if (!lhs)
+        return nullptr;
+    return parse_expr_rhs(0, lhs);
 }
 
-std::unique_ptr<Expr> Parser::parse_expr_rhs(int expr_prec,
-                                             std::unique_ptr<Expr> lhs) {
+Expr *Parser::parse_expr_rhs(int expr_prec, Expr *lhs) {
     while (true) {
         Tok op = lex.get_tok();
         int op_prec;
         Assoc lr_ass;
-        std::tie(op_prec, lr_ass) = binary_precedence[op];
+        std::tie(op_prec, lr_ass) = get_precedence(op);
 
         if (op_prec == 0 || op_prec < expr_prec)
             return lhs;
 
         lex.get_next_tok();
 
-        auto rhs = parse_primary();
+        auto rhs = parse_postfix(parse_primary());
         if (!rhs)
             return nullptr;
 
         Tok new_op = lex.get_tok();
-        int new_op_prec = binary_precedence[new_op].first;
+        int new_op_prec = get_precedence(new_op).first;
 
         if (new_op_prec > op_prec
             || (new_op_prec != 0 && new_op_prec == op_prec
                 && lr_ass == Assoc::RIGHT)) {
-            rhs = parse_expr_rhs(op_prec, std::move(rhs));
+            rhs = parse_expr_rhs(op_prec, rhs);
         }
 
-        lhs = std::make_unique<BinaryExpr>(op, std::move(lhs), std::move(rhs));
+        // Sema checks that only variables are assigned to
+        if (op == Tok::EQ)
+            lhs = arena.make<AssignExpr>(lhs, rhs);
+        else
+            lhs = arena.make<BinaryExpr>(op, lhs, rhs);
     }
 }
 
-std::unique_ptr<Expr> Parser::parse_primary() {
+Expr *Parser::parse_primary() {
     Tok cur_tok = lex.get_tok();
     if (cur_tok == Tok::L_DOUBLE) {
         auto val = lex.get_double();
         lex.get_next_tok();
-        return std::make_unique<LiteralExpr<double>>(val);
+        return arena.make<LiteralExpr<double>>(val);
     } else if (cur_tok == Tok::L_INT32) {
         auto val = lex.get_int32();
         lex.get_next_tok();
-        return std::make_unique<LiteralExpr<int32_t>>(val);
+        return arena.make<LiteralExpr<int32_t>>(val);
+    } else if (cur_tok == Tok::L_INT64) {
+        auto val = lex.get_int64();
+        lex.get_next_tok();
+        return arena.make<LiteralExpr<int64_t>>(val);
     } else if (cur_tok == Tok::L_STR) {
         auto str_lit = lex.get_id();
         lex.get_next_tok();
-        return std::make_unique<LiteralExpr<std::string>>(std::move(str_lit));
+        return arena.make<LiteralExpr<Symbol>>(str_lit);
     } else if (cur_tok == Tok::P_OPEN) {
         lex.get_next_tok();
         auto expr = parse_expr();
@@ -222,20 +272,74 @@ std::unique_ptr<Expr> Parser::parse_primary() {
         if (!or_else)
             return nullptr;
 
-        return std::make_unique<IfExpr>(std::move(cond), std::move(then),
-                                        std::move(or_else));
+        return arena.make<IfExpr>(cond, then, or_else);
+    } else if (cur_tok == Tok::WHILE) {
+        lex.get_next_tok();
+        auto cond = parse_expr();
+        if (!cond)
+            return nullptr;
+
+        if (lex.get_tok() != Tok::BR_OPEN)
+            return error_null("Expected opening brace `{`");
+        auto body = parse_scope();
+        if (!body)
+            return nullptr;
+
+        return arena.make<WhileExpr>(cond, body);
+    } else if (cur_tok == Tok::FOR || cur_tok == Tok::PAR
+               || cur_tok == Tok::ATTR_OPEN) {
+        return parse_for();
+    } else if (cur_tok == Tok::SQ_OPEN) {
+        return parse_array();
+    } else if (cur_tok == Tok::NEW) {
+        if (lex.get_next_tok() != Tok::SQ_OPEN)
+            return error_null("Expected opening bracket `[`");
+        lex.get_next_tok();
+        const auto *elem = parse_type();
+        if (!elem)
+            return nullptr;
+        if (lex.get_next_tok() != Tok::SEMICOLON)
+            return error_null("Expected semicolon `;`");
+
+        lex.get_next_tok();
+        auto size = parse_expr();
+        if (!size)
+            return nullptr;
+        if (lex.get_tok() != Tok::SQ_CLOSE)
+            return error_null("Expected closing bracket `]`");
+        lex.get_next_tok();
+        return arena.make<NewExpr>(elem, size);
+    } else if (cur_tok == Tok::SPAWN) {
+        if (lex.get_next_tok() != Tok::ID)
+            return error_null("Expected function call after `spawn`");
+        auto id = lex.get_id();
+        if (lex.get_next_tok() != Tok::P_OPEN)
+            return error_null("Expected function call after `spawn`");
+        auto *call = parse_call(id);
+        if (!call)
+            return nullptr;
+        return arena.make<SpawnExpr>(call);
+    } else if (cur_tok == Tok::AWAIT) {
+        if (lex.get_next_tok() != Tok::ID)
+            return error_null("Expected future to await");
+        auto *future = arena.make<IdExpr>(lex.get_id());
+        lex.get_next_tok();
+        return arena.make<AwaitExpr>(future);
     } else if (cur_tok != Tok::ID) {
         return error_null("Expected primary expression");
     }
 
+    auto id = lex.get_id();
     lex.get_next_tok();
 
-    std::string id = lex.get_id();
     if (lex.get_tok() != Tok::P_OPEN)
-        return std::make_unique<IdExpr>(std::move(id));
+        return arena.make<IdExpr>(id);
+    return parse_call(id);
+}
 
-    std::vector<std::unique_ptr<Expr>> args;
-    if ((cur_tok = lex.get_next_tok()) != Tok::P_CLOSE) {
+CallExpr *Parser::parse_call(Symbol id) {
+    llvm::SmallVector<Expr *, 8> args;
+    if (lex.get_next_tok() != Tok::P_CLOSE) {
         do {
             args.push_back(parse_expr());
             if (!args.back())
@@ -245,13 +349,149 @@ std::unique_ptr<Expr> Parser::parse_primary() {
     }
 
     lex.get_next_tok();
-    return std::make_unique<CallExpr>(std::move(id), std::move(args));
+    return arena.make<CallExpr>(id, arena.copy(args));
+}
+
+Expr *Parser::parse_postfix(Expr *base) {
+    while (base) {
+        if (lex.get_tok() == Tok::AS) {
+            lex.get_next_tok();
+            const auto *type = parse_type();
+            if (!type)
+                return nullptr;
+            lex.get_next_tok();
+            base = arena.make<CastExpr>(base, type, true);
+            continue;
+        }
+        if (lex.get_tok() != Tok::SQ_OPEN)
+            break;
+
+        lex.get_next_tok();
+        auto index = parse_expr();
+        if (!index)
+            return nullptr;
+        if (lex.get_tok() != Tok::SQ_CLOSE)
+            return error_null("Expected closing bracket `]`");
+        lex.get_next_tok();
+        base = arena.make<IndexExpr>(base, index);
+    }
+    return base;
+}
+
+Expr *Parser::parse_array() {
+    lex.get_next_tok();
+    llvm::SmallVector<Expr *, 8> elems;
+    elems.push_back(parse_expr());
+    if (!elems.back())
+        return nullptr;
+
+    uint32_t size = 1;
+    if (lex.get_tok() == Tok::SEMICOLON) {
+        if (lex.get_next_tok() != Tok::L_INT32 || lex.get_int32() < 1)
+            return error_null("Expected positive integer literal");
+        size = lex.get_int32();
+        lex.get_next_tok();
+    } else {
+        while (lex.get_tok() == Tok::COMMA) {
+            lex.get_next_tok();
+            elems.push_back(parse_expr());
+            if (!elems.back())
+                return nullptr;
+        }
+        size = elems.size();
+    }
+
+    if (lex.get_tok() != Tok::SQ_CLOSE)
+        return error_null("Expected closing bracket `]`");
+    lex.get_next_tok();
+    return arena.make<ArrayExpr>(arena.copy(elems), size);
+}
+
+Expr *Parser::parse_for() {
+    LoopHints hints;
+    while (lex.get_tok() == Tok::ATTR_OPEN) {
+        if (lex.get_next_tok() != Tok::ID)
+            return error_null("Expected attribute name");
+
+        const auto name = lex.get_id_str();
+        unsigned *hint = name == "unroll"      ? &hints.unroll
+                         : name == "vectorize" ? &hints.vectorize
+                         : name == "grain"     ? &hints.grain
+                                               : nullptr;
+        if (!hint)
+            return error_null("Unknown attribute `", name.str(), "`");
+
+        if (lex.get_next_tok() != Tok::P_OPEN)
+            return error_null("Expected opening parenthesis `(`");
+        if (lex.get_next_tok() != Tok::L_INT32 || lex.get_int32() < 1)
+            return error_null("Expected positive integer literal");
+        *hint = lex.get_int32();
+        if (hint == &hints.vectorize && (*hint & (*hint - 1)))
+            return error_null("Vectorisation width must be a power of two");
+
+        if (lex.get_next_tok() != Tok::P_CLOSE)
+            return error_null("Expected closing parenthesis `)`");
+        if (lex.get_next_tok() != Tok::SQ_CLOSE)
+            return error_null("Expected closing bracket `]`");
+        lex.get_next_tok();
+    }
+
+    const bool parallel = lex.get_tok() == Tok::PAR;
+    if (parallel)
+        lex.get_next_tok();
+    else if (hints.grain)
+        return error_null("Only `par for` loops have a grain");
+    if (lex.get_tok() != Tok::FOR)
+        return error_null("Attributes can only be applied to `for` loops");
+    if (lex.get_next_tok() != Tok::ID)
+        return error_null("Expected identifier");
+    auto var = lex.get_id();
+
+    if (lex.get_next_tok() != Tok::IN)
+        return error_null("Expected keyword `in`");
+    lex.get_next_tok();
+    auto begin = parse_expr();
+    if (!begin)
+        return nullptr;
+
+    if (lex.get_tok() != Tok::DOTDOT)
+        return error_null("Expected range `..`");
+    lex.get_next_tok();
+    auto end = parse_expr();
+    if (!end)
+        return nullptr;
+
+    // `reduce` is only a keyword in this position
+    Reduction reduction;
+    if (parallel && lex.get_tok() == Tok::ID
+        && lex.get_id_str() == "reduce") {
+        if (lex.get_next_tok() != Tok::P_OPEN)
+            return error_null("Expected opening parenthesis `(`");
+        reduction.op = lex.get_next_tok();
+        if (reduction.op != Tok::PLUS && reduction.op != Tok::MULT)
+            return error_null("Expected `+` or `*` to reduce with");
+        if (lex.get_next_tok() != Tok::P_CLOSE)
+            return error_null("Expected closing parenthesis `)`");
+        if (lex.get_next_tok() != Tok::ID)
+            return error_null("Expected identifier");
+        reduction.var = arena.make<IdExpr>(lex.get_id());
+        lex.get_next_tok();
+    }
+
+    if (lex.get_tok() != Tok::BR_OPEN)
+        return error_null("Expected opening brace `{`");
+    auto body = parse_scope();
+    if (!body)
+        return nullptr;
+
+    return arena.make<ForExpr>(var, begin, end, body, hints, parallel,
+                               reduction);
 }
 
-std::unique_ptr<ScopeExpr> Parser::parse_scope() {
+ScopeExpr *Parser::parse_scope() {
     lex.get_next_tok();
 
-    std::vector<std::unique_ptr<Statement>> body;
+    llvm::SmallVector<Statement *, 16> body;
     body.push_back(nullptr);
 
     while (lex.get_tok() != Tok::BR_CLOSE) {
@@ -268,5 +508,5 @@ std::unique_ptr<ScopeExpr> Parser::parse_scope() {
     }
 
     lex.get_next_tok();
-    return std::make_unique<ScopeExpr>(std::move(body));
+    return arena.make<ScopeExpr>(arena.copy(body));
 }
@@ -1,36 +1,54 @@
 #ifndef HXWK_PARSER_H
 #define HXWK_PARSER_H
 
+#include "Arena.hpp"
 #include "Lexer.hpp"
-#include <memory>
+#include "TokenTable.hpp"
 #include <utility>
 
+class CallExpr;
 class Expr;
 class Statement;
 class Type;
+class TypeContext;
 class VarDecl;
 class ScopeExpr;
 
-enum class Assoc { LEFT, RIGHT };
-
 class Parser {
   public:
-    Parser(Lexer lex) : lex(std::move(lex)){};
+    // All nodes are allocated in `arena`, the returned trees live as long as
+    // its contents.
+    Parser(Lexer lex, Arena &arena, TypeContext &types)
+            : lex(std::move(lex)), arena(arena), types(types){};
     std::pair<int, Assoc> get_precedence(Tok tok);
-    std::unique_ptr<Statement> parse();
-    std::unique_ptr<Type> parse_type();
-    std::unique_ptr<Statement> parse_fn();
-    std::unique_ptr<Statement> parse_scope_body();
-    std::unique_ptr<VarDecl> parse_var_decl();
-    std::unique_ptr<Expr> parse_top_expr();
-    std::unique_ptr<Expr> parse_expr();
-    std::unique_ptr<Expr> parse_expr_rhs(int precedence,
-                                         std::unique_ptr<Expr> lhs);
-    std::unique_ptr<Expr> parse_primary();
-    std::unique_ptr<ScopeExpr> parse_scope();
+    // Returns nullptr at the end of the input or on errors
+    Statement *parse();
+    bool at_end() const { return lex.get_tok() == Tok::END; };
+    // See Lexer::set_digest, the first token of the next statement is fed
+    // in once parsing it starts.
+    void set_digest(llvm::SHA1 *digest) { lex.set_digest(digest); };
+    const Type *parse_type();
+    Statement *parse_fn();
+    Statement *parse_scope_body();
+    VarDecl *parse_var_decl();
+    Expr *parse_top_expr();
+    Expr *parse_expr();
+    Expr *parse_expr_rhs(int precedence, Expr *lhs);
+    Expr *parse_primary();
+    // The arguments of a call to `id`, starting at the opening parenthesis
+    CallExpr *parse_call(Symbol id);
+    // Indices and `as` casts following `base`, passes nullptr on
+    Expr *parse_postfix(Expr *base);
+    // `[a, b, c]` or `[a; size]`
+    Expr *parse_array();
+    // A `for` loop and the attributes preceding it
+    Expr *parse_for();
+    ScopeExpr *parse_scope();
 
   private:
     Lexer lex;
+    Arena &arena;
+    TypeContext &types;
 };
 
 #endif
@@ -0,0 +1,393 @@
+#include "Runtime.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class Worker;
+
+// A unit of work, which deletes itself once it has run
+class Task {
+  public:
+    virtual ~Task() = default;
+    virtual void run(Worker &worker) = 0;
+};
+
+class Pool;
+
+// Owns a deque of tasks. The worker pushes and pops at the back, others
+// steal from the front, where the oldest tasks are. Split ranges leave their
+// largest halves there, so a theft takes as much work as possible.
+class Worker {
+  public:
+    Worker(Pool &pool, unsigned index)
+            : pool{pool}, index{index}, seed{index * 2654435761u + 1} {};
+
+    unsigned get_index() const { return index; };
+    void push(Task *task);
+    // Both return nullptr if the deque is empty
+    Task *pop();
+    Task *steal();
+    bool is_empty();
+    // Runs tasks, its own first and then stolen ones, until `done` returns
+    // true. Waiting this way cannot deadlock on tasks queued behind the
+    // waiting one.
+    template <typename Done>
+    void help_until(Done done);
+    // Picks victims to steal from
+    uint32_t next_random() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+  private:
+    Pool &pool;
+    unsigned index;
+    uint32_t seed;
+    std::mutex mutex;
+    std::deque<Task *> tasks;
+};
+
+// Rounds of looking for tasks in vain before an idle worker goes to sleep
+constexpr unsigned spin_rounds = 1024;
+
+class Pool {
+  public:
+    // Created on first use and never destroyed, its threads keep waiting for
+    // work until the process exits
+    static Pool &get() {
+        static Pool *pool = new Pool{get_num_workers()};
+        return *pool;
+    };
+
+    unsigned get_size() const { return workers.size(); };
+    Worker &get_worker(unsigned index) { return *workers[index]; };
+    // Takes a task from any worker but `thief`, nullptr if there is none
+    Task *steal(Worker &thief);
+    // Wakes sleeping workers, has to follow every push
+    void notify();
+
+    // Threads outside the pool share worker 0, one at a time
+    std::mutex outside;
+
+  private:
+    explicit Pool(unsigned size);
+    static unsigned get_num_workers();
+    void work(Worker &self);
+    // Blocks until a task may have been pushed
+    void sleep();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<unsigned> sleepers{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    // Counts notifications, guarded by `sleep_mutex`
+    uint64_t epoch{0};
+};
+
+thread_local Worker *current_worker = nullptr;
+
+void Worker::push(Task *task) {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        tasks.push_back(task);
+    }
+    pool.notify();
+}
+
+Task *Worker::pop() {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (tasks.empty())
+        return nullptr;
+    auto *task = tasks.back();
+    tasks.pop_back();
+    return task;
+}
+
+Task *Worker::steal() {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (tasks.empty())
+        return nullptr;
+    auto *task = tasks.front();
+    tasks.pop_front();
+    return task;
+}
+
+bool Worker::is_empty() {
+    std::lock_guard<std::mutex> lock{mutex};
+    return tasks.empty();
+}
+
+template <typename Done>
+void Worker::help_until(Done done) {
+    while (!done()) {
+        auto *task = pop();
+        if (!task)
+            task = pool.steal(*this);
+        if (task)
+            task->run(*this);
+        else
+            std::this_thread::yield();
+    }
+}
+
+Pool::Pool(unsigned size) {
+    for (unsigned i = 0; i < size; ++i)
+        workers.push_back(std::make_unique<Worker>(*this, i));
+    for (unsigned i = 1; i < size; ++i)
+        std::thread{[this, i] { work(*workers[i]); }}.detach();
+}
+
+unsigned Pool::get_num_workers() {
+    if (const char *threads = std::getenv("HXWK_THREADS")) {
+        char *end = nullptr;
+        auto num = std::strtoul(threads, &end, 10);
+        if (*threads && !*end && num > 0 && num <= 1024)
+            return num;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+Task *Pool::steal(Worker &thief) {
+    const unsigned size = get_size();
+    const unsigned first = thief.next_random() % size;
+    for (unsigned i = 0; i < size; ++i) {
+        auto &victim = *workers[(first + i) % size];
+        if (&victim == &thief)
+            continue;
+        if (auto *task = victim.steal())
+            return task;
+    }
+    return nullptr;
+}
+
+void Pool::notify() {
+    if (!sleepers.load())
+        return;
+    {
+        std::lock_guard<std::mutex> lock{sleep_mutex};
+        ++epoch;
+    }
+    wake.notify_all();
+}
+
+void Pool::work(Worker &self) {
+    current_worker = &self;
+    unsigned idle = 0;
+    for (;;) {
+        auto *task = self.pop();
+        if (!task)
+            task = steal(self);
+        if (task) {
+            task->run(self);
+            idle = 0;
+        } else if (++idle < spin_rounds) {
+            std::this_thread::yield();
+        } else {
+            sleep();
+            idle = 0;
+        }
+    }
+}
+
+void Pool::sleep() {
+    std::unique_lock<std::mutex> lock{sleep_mutex};
+    // A push either happened early enough to be seen below, or late enough
+    // to see the count and notify, which cannot happen before the wait as
+    // long as `sleep_mutex` is held
+    sleepers.fetch_add(1);
+    bool has_work = false;
+    for (const auto &worker : workers)
+        has_work = has_work || !worker->is_empty();
+    if (!has_work) {
+        const auto seen = epoch;
+        wake.wait(lock, [this, seen] { return epoch != seen; });
+    }
+    sleepers.fetch_sub(1);
+}
+
+// Makes the calling thread a worker while it is alive. Threads of the pool
+// keep their own worker, others take worker 0.
+class Entry {
+  public:
+    explicit Entry(Pool &pool) : worker{current_worker} {
+        if (worker)
+            return;
+        lock = std::unique_lock<std::mutex>{pool.outside};
+        worker = current_worker = &pool.get_worker(0);
+    };
+    ~Entry() {
+        if (lock)
+            current_worker = nullptr;
+    };
+    Entry(const Entry &) = delete;
+    Entry &operator=(const Entry &) = delete;
+
+    Worker &get_worker() { return *worker; };
+
+  private:
+    Worker *worker;
+    std::unique_lock<std::mutex> lock;
+};
+
+// Shared by the chunks of a `par for` loop
+struct Loop {
+    Loop(void (*body)(void *, int64_t, int64_t, void *), void *ctx,
+         uint64_t grain, char *slots, std::size_t stride, uint64_t size)
+            : body{body},
+              ctx{ctx},
+              grain{grain},
+              slots{slots},
+              stride{stride},
+              remaining{size} {};
+
+    void *get_slot(const Worker &worker) const {
+        return slots ? slots + worker.get_index() * stride : nullptr;
+    };
+
+    void (*body)(void *, int64_t, int64_t, void *);
+    void *ctx;
+    uint64_t grain;
+    // The accumulators of the workers, each on cache lines of its own
+    char *slots;
+    std::size_t stride;
+    // Iterations which have not run yet
+    std::atomic<uint64_t> remaining;
+};
+
+// Ranges are never empty, their lengths are computed unsigned so that they
+// can span all of `int64_t`
+uint64_t get_length(int64_t lo, int64_t hi) {
+    return static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
+}
+
+void run_range(Loop &loop, int64_t lo, int64_t hi, Worker &worker);
+
+class RangeTask : public Task {
+  public:
+    RangeTask(Loop &loop, int64_t lo, int64_t hi)
+            : loop{loop}, lo{lo}, hi{hi} {};
+
+    void run(Worker &worker) override {
+        run_range(loop, lo, hi, worker);
+        delete this;
+    };
+
+  private:
+    Loop &loop;
+    int64_t lo, hi;
+};
+
+// Splits off the upper half until the range is no longer than the grain,
+// which leaves the worker with the lowest chunk, next to the one it will pop
+// after that
+void run_range(Loop &loop, int64_t lo, int64_t hi, Worker &worker) {
+    while (get_length(lo, hi) > loop.grain) {
+        const int64_t mid = lo + static_cast<int64_t>(get_length(lo, hi) / 2);
+        worker.push(new RangeTask{loop, mid, hi});
+        hi = mid;
+    }
+    loop.body(loop.ctx, lo, hi, loop.get_slot(worker));
+    // Publishes the body's writes to the thread waiting for the loop
+    loop.remaining.fetch_sub(get_length(lo, hi), std::memory_order_acq_rel);
+}
+
+// Lives in storage of the spawning function's frame, so it is neither
+// deleted nor touched after it is done
+class SpawnTask : public Task {
+  public:
+    explicit SpawnTask(void (*call)(void *)) : call{call} {};
+
+    void run(Worker &) override {
+        call(this);
+        // Publishes the call's writes to the thread awaiting it
+        done.store(true, std::memory_order_release);
+    };
+    bool is_done() const { return done.load(std::memory_order_acquire); };
+
+  private:
+    void (*call)(void *);
+    std::atomic<bool> done{false};
+};
+
+static_assert(sizeof(SpawnTask) <= hxwk_task_size
+                      && alignof(SpawnTask) <= alignof(int64_t),
+              "A spawned task does not fit the storage compiled code "
+              "reserves for it");
+
+} // end anonymous namespace
+
+void hxwk_par_for(int64_t begin, int64_t end, int64_t grain,
+                  void (*body)(void *, int64_t, int64_t, void *), void *ctx,
+                  void *acc, uint64_t acc_size,
+                  void (*combine)(void *, const void *)) {
+    if (begin >= end)
+        return;
+
+    auto &pool = Pool::get();
+    const unsigned num_workers = pool.get_size();
+    const uint64_t length = get_length(begin, end);
+    const uint64_t chunk
+            = grain > 0 ? static_cast<uint64_t>(grain)
+                        : std::max<uint64_t>(1, length / (8 * num_workers));
+    // Nothing to share, the body combines into `acc` itself
+    if (num_workers == 1 || length <= chunk) {
+        body(ctx, begin, end, acc);
+        return;
+    }
+
+    constexpr std::size_t line = 64;
+    const std::size_t stride = (acc_size + line - 1) / line * line;
+    std::unique_ptr<char[]> storage;
+    char *slots = nullptr;
+    if (acc) {
+        storage.reset(new char[stride * num_workers + line]);
+        const auto addr = reinterpret_cast<uintptr_t>(storage.get());
+        slots = storage.get() + (-addr & (line - 1));
+        for (unsigned i = 0; i < num_workers; ++i)
+            std::memcpy(slots + i * stride, acc, acc_size);
+    }
+
+    Entry entry{pool};
+    Loop loop{body, ctx, chunk, slots, stride, length};
+    run_range(loop, begin, end, entry.get_worker());
+    entry.get_worker().help_until([&loop] {
+        return loop.remaining.load(std::memory_order_acquire) == 0;
+    });
+
+    for (unsigned i = 0; acc && i < num_workers; ++i)
+        combine(acc, slots + i * stride);
+}
+
+void hxwk_spawn(void *task, void (*call)(void *)) {
+    auto *spawned = new (task) SpawnTask{call};
+    auto &pool = Pool::get();
+    // Nobody could steal the task, running it late only costs a push and pop
+    if (pool.get_size() == 1) {
+        spawned->run(pool.get_worker(0));
+        return;
+    }
+    Entry entry{pool};
+    entry.get_worker().push(spawned);
+}
+
+void hxwk_await(void *task) {
+    auto &spawned = *static_cast<SpawnTask *>(task);
+    if (spawned.is_done())
+        return;
+    Entry entry{Pool::get()};
+    entry.get_worker().help_until([&spawned] { return spawned.is_done(); });
+}
@@ -0,0 +1,51 @@
+#ifndef HXWK_RUNTIME_H
+#define HXWK_RUNTIME_H
+
+#include <cstdint>
+
+// The support library compiled programs call into. It is built as
+// `libhxwk_rt.a`, which executables are linked against, and is also linked
+// into the compiler itself, where the JIT resolves calls to it.
+//
+// Parallel constructs run on a work-stealing pool with one worker per core,
+// or `HXWK_THREADS` workers if that is set. The pool starts with the first
+// parallel construct; the thread entering it from outside joins in as a
+// worker until the construct is done.
+//
+// Names start with `hxwk_`, which no identifier of the language can clash
+// with.
+
+// The bytes `hxwk_spawn` needs to keep a task in, which have to be aligned
+// like `int64_t`
+constexpr uint64_t hxwk_task_size = 32;
+
+extern "C" {
+
+// Lowers `par for`. Calls `body(ctx, lo, hi, acc)` for chunks [lo, hi) which
+// together cover [begin, end), splitting ranges in half while they are
+// longer than `grain`. A `grain` of 0 picks one which gives each worker a few
+// chunks to balance the load with.
+//
+// Reductions pass `acc`, holding the identity of the reduction, its size and
+// a function combining the value at its second argument into the first. Each
+// worker accumulates into a copy of the identity of its own, `body` combines
+// into the copy it is given. Once all chunks are done, the copies are
+// combined into `acc`. Without a reduction, `acc` and `combine` are nullptr.
+void hxwk_par_for(int64_t begin, int64_t end, int64_t grain,
+                  void (*body)(void *, int64_t, int64_t, void *), void *ctx,
+                  void *acc, uint64_t acc_size,
+                  void (*combine)(void *, const void *));
+
+// Lowers `spawn`. Queues a task running `call(task)`, which the calling
+// worker or a thief runs later. The task is kept in the first
+// `hxwk_task_size` bytes at `task`, the rest is left to `call`. The storage
+// has to stay valid until `hxwk_await` returns for it. With a single worker,
+// the task is run right away.
+void hxwk_spawn(void *task, void (*call)(void *));
+// Returns once the task at `task` has run. Until then, the calling thread
+// runs other tasks, those it queued itself first. Afterwards, the storage is
+// no longer used by the runtime.
+void hxwk_await(void *task);
+}
+
+#endif
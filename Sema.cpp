@@ -0,0 +1,1021 @@
+#include "Sema.hpp"
+#include "Log.hpp"
+#include "llvm/Support/Casting.h"
+#include <utility>
+
+// Declares every top level function before any body is checked
+class SemaSignatureVis : public MutStatementVis {
+  public:
+    SemaSignatureVis(Sema &sema, std::vector<FnDef *> &defs)
+            : sema{sema}, defs{defs} {};
+
+    // Not found at the top level
+    void visit(Expr &) override{};
+    void visit(VarDecl &) override{};
+    VISIT_MUT(FnDecl) { ok = sema.declare(visitable, false); };
+    VISIT_MUT(FnDef) {
+        ok = sema.declare(visitable.get_decl(), true);
+        defs.push_back(&visitable);
+    };
+
+    bool get_ok() const { return ok; };
+
+  private:
+    Sema &sema;
+    std::vector<FnDef *> &defs;
+    bool ok{true};
+};
+
+namespace {
+
+// Finds the variable or element an expression refers to, i.e. what an
+// assignment may store to
+class TargetVis : public MutExprVis {
+  public:
+    void visit(LiteralExpr<bool> &) override{};
+    void visit(LiteralExpr<int32_t> &) override{};
+    void visit(LiteralExpr<int64_t> &) override{};
+    void visit(LiteralExpr<double> &) override{};
+    void visit(LiteralExpr<Symbol> &) override{};
+    VISIT_MUT(IdExpr) { target = &visitable; };
+    void visit(BinaryExpr &) override{};
+    void visit(CallExpr &) override{};
+    void visit(ScopeExpr &) override{};
+    void visit(IfExpr &) override{};
+    void visit(CastExpr &) override{};
+    void visit(AssignExpr &) override{};
+    void visit(WhileExpr &) override{};
+    void visit(ForExpr &) override{};
+    VISIT_MUT(IndexExpr) { element = &visitable; };
+    void visit(ArrayExpr &) override{};
+    void visit(NewExpr &) override{};
+    void visit(SpawnExpr &) override{};
+    void visit(AwaitExpr &) override{};
+
+    // nullptr if the target is not a variable
+    IdExpr *get_target() const { return target; };
+    // nullptr if the target is not an element
+    IndexExpr *get_element() const { return element; };
+
+  private:
+    IdExpr *target{nullptr};
+    IndexExpr *element{nullptr};
+};
+
+// Collects the lanes selected by a `shuffle`, which have to be given as an
+// array literal of integer literals
+class MaskVis : public MutExprVis {
+  public:
+    void visit(LiteralExpr<bool> &) override { valid = false; };
+    VISIT_MUT(LiteralExpr<int32_t>) {
+        valid = valid && in_array;
+        lanes.push_back(static_cast<uint32_t>(visitable.get_val()));
+    };
+    void visit(LiteralExpr<int64_t> &) override { valid = false; };
+    void visit(LiteralExpr<double> &) override { valid = false; };
+    void visit(LiteralExpr<Symbol> &) override { valid = false; };
+    void visit(IdExpr &) override { valid = false; };
+    void visit(BinaryExpr &) override { valid = false; };
+    void visit(CallExpr &) override { valid = false; };
+    void visit(ScopeExpr &) override { valid = false; };
+    void visit(IfExpr &) override { valid = false; };
+    void visit(CastExpr &) override { valid = false; };
+    void visit(AssignExpr &) override { valid = false; };
+    void visit(WhileExpr &) override { valid = false; };
+    void visit(ForExpr &) override { valid = false; };
+    void visit(IndexExpr &) override { valid = false; };
+    VISIT_MUT(ArrayExpr) {
+        valid = valid && !in_array;
+        in_array = true;
+        for (auto *elem : visitable.get_elems())
+            elem->accept(*this);
+        // `[i; n]` repeats its only element
+        if (valid && visitable.get_elems().size() == 1)
+            lanes.resize(visitable.get_size(), lanes[0]);
+    };
+    void visit(NewExpr &) override { valid = false; };
+    void visit(SpawnExpr &) override { valid = false; };
+    void visit(AwaitExpr &) override { valid = false; };
+
+    bool is_valid() const { return valid && in_array; };
+    const llvm::SmallVectorImpl<uint32_t> &get_lanes() const {
+        return lanes;
+    };
+
+  private:
+    bool valid{true};
+    bool in_array{false};
+    llvm::SmallVector<uint32_t, 16> lanes;
+};
+
+struct BuiltinInfo {
+    const char *name;
+    Builtin builtin;
+    unsigned min_args, max_args;
+};
+
+constexpr BuiltinInfo builtin_infos[] = {
+        {"len", Builtin::LEN, 1, 1},
+        {"free", Builtin::FREE, 1, 1},
+        {"splat", Builtin::SPLAT, 1, 1},
+        {"extract", Builtin::EXTRACT, 2, 2},
+        {"insert", Builtin::INSERT, 3, 3},
+        {"shuffle", Builtin::SHUFFLE, 2, 3},
+        {"select", Builtin::SELECT, 3, 3},
+        {"hsum", Builtin::HSUM, 1, 1},
+        {"hmul", Builtin::HMUL, 1, 1},
+        {"hmin", Builtin::HMIN, 1, 1},
+        {"hmax", Builtin::HMAX, 1, 1},
+        {"any", Builtin::ANY, 1, 1},
+        {"all", Builtin::ALL, 1, 1},
+        {"load", Builtin::LOAD, 2, 2},
+        {"store", Builtin::STORE, 3, 3},
+};
+
+const BuiltinInfo &get_info(Builtin builtin) {
+    for (const auto &info : builtin_infos) {
+        if (info.builtin == builtin)
+            return info;
+    }
+    return builtin_infos[0];
+}
+
+bool is_arit(const Type &type) { return get_arith_traits(type) != nullptr; }
+
+// Arithmetic types besides `bool`
+bool is_number(const Type &type) {
+    return is_arit(type) && !llvm::isa<BoolType>(type);
+}
+
+// Arithmetic types besides `bool` and floating point types
+bool is_integer(const Type &type) {
+    const auto *traits = get_arith_traits(type);
+    return traits && !traits->is_float && !llvm::isa<BoolType>(type);
+}
+
+// Types of parameters and return values besides `void`
+bool is_param_type(const Type &type) {
+    const auto *slice = llvm::dyn_cast<SliceType>(&type);
+    return is_arit(type) || llvm::isa<VectorType>(type)
+           || (slice && is_arit(*slice->get_elem()));
+}
+
+// Arrays are passed to functions as slices of their elements
+bool is_array_of_slice(const Type &array, const Type &slice) {
+    return llvm::isa<ArrayType>(array) && llvm::isa<SliceType>(slice)
+           && llvm::cast<ArrayType>(array).get_elem()
+                      == llvm::cast<SliceType>(slice).get_elem();
+}
+
+}
+
+Sema::Sema(StringInterner &interner, TypeContext &types, Arena &arena)
+        : interner{interner},
+          types{types},
+          arena{arena} {
+    for (const auto &info : builtin_infos)
+        builtins[interner.intern(info.name).get_id()] = info.builtin;
+    names.enter();
+    names.current_scope(interner.intern("printf"))
+            = {types.get_function({types.get_str_lit()}, types.get_int32()),
+               0, true, false};
+}
+
+bool Sema::run(llvm::ArrayRef<Statement *> statements) {
+    std::vector<FnDef *> bodies;
+    SemaSignatureVis signatures{*this, bodies};
+    for (auto *statement : statements) {
+        statement->accept(signatures);
+        if (!signatures.get_ok())
+            return false;
+    }
+
+    for (auto *def : bodies) {
+        if (!check(*def))
+            return false;
+        defs.push_back(def);
+    }
+    return true;
+}
+
+const FunctionType *Sema::get_signature(const FnDecl &decl) {
+    std::vector<const Type *> param_types;
+    for (const auto &param : decl.get_params()) {
+        if (!is_param_type(*param.second))
+            return Log::error_val<const FunctionType *>(
+                    "Invalid type of parameter `", get_name(param.first),
+                    "`");
+        param_types.push_back(param.second);
+    }
+
+    const auto *ret_type = decl.get_ret_type();
+    if (!is_param_type(*ret_type) && !llvm::isa<VoidType>(ret_type))
+        return Log::error_val<const FunctionType *>("Invalid return type");
+
+    return types.get_function(std::move(param_types), ret_type);
+}
+
+bool Sema::declare(FnDecl &decl, bool is_def) {
+    const auto id = decl.get_id();
+    const auto *type = get_signature(decl);
+    if (!type)
+        return false;
+
+    // The function may have been declared before, but not defined
+    const auto declared = names[id];
+    if (declared.type) {
+        if (is_def && !defined.insert(id.get_id()).second)
+            return Log::error_val<bool>("Cannot redefine function (`",
+                                        get_name(id), "`)");
+        if (declared.type != type)
+            return Log::error_val<bool>(is_def ? "Definition" : "Declaration",
+                                        " of `", get_name(id),
+                                        "` does not match its declaration");
+        return true;
+    }
+
+    if (is_def)
+        defined.insert(id.get_id());
+    names.current_scope(id) = {type, 0, false, false};
+    decls.push_back(&decl);
+    return true;
+}
+
+bool Sema::check(FnDef &def) {
+    const auto &decl = def.get_decl();
+    const auto *type = llvm::cast<FunctionType>(names[decl.get_id()].type);
+
+    names.enter();
+    num_locals = 0;
+    local_arrays = false;
+    for (const auto &param : decl.get_params())
+        names.current_scope(param.first)
+                = {param.second, num_locals++, false, false};
+    const auto *body_type = check_scope(def.get_body_scope());
+    names.exit();
+
+    if (!body_type)
+        return false;
+    def.set_num_locals(num_locals);
+    def.set_local_arrays(local_arrays);
+
+    const auto *ret_type = type->get_ret_type();
+    if (body_type != ret_type && !llvm::isa<VoidType>(ret_type))
+        return Log::error_val<bool>("Returned value does not match function "
+                                    "type");
+    return true;
+}
+
+const Type *Sema::check_scope(ScopeExpr &scope) {
+    const auto &body = scope.get_body();
+    bool explicit_void = !body.empty() && !body.back();
+
+    names.enter();
+    futures.emplace_back();
+    SemaStatementVis body_vis{*this};
+    bool ok = true;
+    for (auto i = body.begin(); ok && i != body.end() - explicit_void; ++i) {
+        (*i)->accept(body_vis);
+        ok = body_vis.get_type();
+    }
+    names.exit();
+    scope.set_futures(arena.copy(futures.back()));
+    futures.pop_back();
+    if (!ok)
+        return nullptr;
+
+    const Type *type = body.empty() || explicit_void ? types.get_void()
+                                                     : body_vis.get_type();
+    // The future would outlive the scope awaiting it
+    if (llvm::isa<FutureType>(type))
+        return Log::error_val<const Type *>(
+                "A scope cannot evaluate to a future");
+    scope.set_type(type);
+    return type;
+}
+
+const Type *Sema::check_builtin(CallExpr &expr, Builtin builtin) {
+    const auto &info = get_info(builtin);
+    const auto args = expr.get_args();
+    if (args.size() < info.min_args || args.size() > info.max_args) {
+        if (info.min_args == info.max_args)
+            return Log::error_val<const Type *>(
+                    "Wrong number of arguments (expected ", info.min_args,
+                    " but got ", args.size(), ")");
+        return Log::error_val<const Type *>(
+                "Wrong number of arguments (expected ", info.min_args, " to ",
+                info.max_args, " but got ", args.size(), ")");
+    }
+
+    llvm::SmallVector<const Type *, 3> arg_types;
+    for (auto *arg : args) {
+        // The lanes `shuffle` selects are not stored as an array
+        const bool is_mask = builtin == Builtin::SHUFFLE && arg == args.back();
+        const bool had_local_arrays = local_arrays;
+        SemaExprVis arg_vis{*this};
+        arg->accept(arg_vis);
+        if (!arg_vis.get_type())
+            return nullptr;
+        arg_types.push_back(arg_vis.get_type());
+        if (is_mask)
+            local_arrays = had_local_arrays;
+    }
+
+    expr.set_builtin(builtin);
+    const auto *type = check_builtin_args(expr, builtin, arg_types);
+    if (type)
+        expr.set_type(type);
+    return type;
+}
+
+const Type *Sema::check_builtin_args(CallExpr &expr, Builtin builtin,
+                                     llvm::ArrayRef<const Type *> arg_types) {
+    const auto &info = get_info(builtin);
+    const auto args = expr.get_args();
+    const auto *vec = llvm::dyn_cast<VectorType>(arg_types[0]);
+    const auto *elem = vec ? vec->get_elem() : nullptr;
+    const auto *slice = llvm::dyn_cast<SliceType>(arg_types[0]);
+    const auto *array = llvm::dyn_cast<ArrayType>(arg_types[0]);
+    if (array)
+        elem = array->get_elem();
+    if (slice)
+        elem = slice->get_elem();
+
+    switch (info.builtin) {
+        case Builtin::LEN:
+            if (!array && !slice && !vec)
+                return Log::error_val<const Type *>(
+                        "`len` expects an array, slice or vector");
+            return types.get_int32();
+        case Builtin::FREE:
+            if (!slice)
+                return Log::error_val<const Type *>("`free` expects a slice");
+            return types.get_void();
+        case Builtin::SPLAT:
+            if (!is_number(*arg_types[0]))
+                return Log::error_val<const Type *>(
+                        "`splat` expects a number");
+            return types.get_vector(arg_types[0],
+                                    types.get_native_lanes(*arg_types[0]));
+        default:
+            break;
+    }
+
+    // Elements of arrays and slices
+    if (info.builtin == Builtin::LOAD || info.builtin == Builtin::STORE) {
+        if (info.builtin == Builtin::LOAD ? !array && !slice : !slice)
+            return Log::error_val<const Type *>(
+                    "`", info.name, "` expects a ",
+                    info.builtin == Builtin::LOAD ? "array or slice" : "slice",
+                    " first");
+        // Lanes of `bool` are packed into bits rather than bytes
+        if (!is_number(*elem))
+            return Log::error_val<const Type *>(
+                    "`", info.name, "` expects elements of a number type");
+        if (!is_integer(*arg_types[1]))
+            return Log::error_val<const Type *>("Indices must be integers");
+        if (info.builtin == Builtin::LOAD)
+            return types.get_vector(elem, types.get_native_lanes(*elem));
+
+        const auto *value = llvm::dyn_cast<VectorType>(arg_types[2]);
+        const auto *stored
+                = value ? types.get_vector(elem, value->get_lanes()) : nullptr;
+        if (!value
+            || (value != stored && !widens_to(*value, *stored)))
+            return Log::error_val<const Type *>(
+                    "`store` expects a vector of the element type");
+        args[2] = convert(*args[2], stored);
+        return types.get_void();
+    }
+
+    // Lanes of vectors
+    if (!vec)
+        return Log::error_val<const Type *>("`", info.name,
+                                            "` expects a vector first");
+    switch (info.builtin) {
+        case Builtin::EXTRACT:
+        case Builtin::INSERT:
+            if (!is_integer(*arg_types[1]))
+                return Log::error_val<const Type *>(
+                        "Indices must be integers");
+            if (info.builtin == Builtin::EXTRACT)
+                return elem;
+            if (arg_types[2] != elem && !widens_to(*arg_types[2], *elem))
+                return Log::error_val<const Type *>(
+                        "Inserted value does not match the lane type");
+            args[2] = convert(*args[2], elem);
+            return vec;
+        case Builtin::SHUFFLE: {
+            const bool two_inputs = args.size() == 3;
+            if (two_inputs && arg_types[1] != vec)
+                return Log::error_val<const Type *>(
+                        "`shuffle` expects vectors of the same type");
+
+            MaskVis mask;
+            args.back()->accept(mask);
+            if (!mask.is_valid())
+                return Log::error_val<const Type *>(
+                        "`shuffle` expects an array of integer literals "
+                        "selecting lanes");
+            const auto num_lanes = vec->get_lanes() << two_inputs;
+            for (auto lane : mask.get_lanes()) {
+                if (lane >= num_lanes)
+                    return Log::error_val<const Type *>(
+                            "Lane ", lane, " out of range for `shuffle`");
+            }
+            expr.set_mask(arena.copy(mask.get_lanes()));
+            return types.get_vector(elem, mask.get_lanes().size());
+        }
+        case Builtin::SELECT: {
+            if (!llvm::isa<BoolType>(elem))
+                return Log::error_val<const Type *>(
+                        "`select` expects a vector of `bool` first");
+            if (!is_arit(get_lane_type(*arg_types[1]))
+                || !is_arit(get_lane_type(*arg_types[2])))
+                return Log::error_val<const Type *>(
+                        "`select` expects vectors or numbers to select from");
+            // Scalars are splat like the operands of binary expressions
+            const auto *common = types.get_common(*arg_types[1],
+                                                  *arg_types[2]);
+            if (common && !llvm::isa<VectorType>(common))
+                common = types.get_vector(common, vec->get_lanes());
+            if (!common
+                || llvm::cast<VectorType>(common)->get_lanes()
+                           != vec->get_lanes())
+                return Log::error_val<const Type *>(
+                        "Vectors of different lengths cannot be combined");
+            args[1] = convert(*args[1], common);
+            args[2] = convert(*args[2], common);
+            return common;
+        }
+        case Builtin::ANY:
+        case Builtin::ALL:
+            if (!llvm::isa<BoolType>(elem))
+                return Log::error_val<const Type *>(
+                        "`", info.name, "` expects a vector of `bool`");
+            return types.get_bool();
+        default:
+            // The reductions of numbers
+            if (!is_number(*elem))
+                return Log::error_val<const Type *>(
+                        "`", info.name, "` expects a vector of numbers");
+            return elem;
+    }
+}
+
+void Sema::hoist_range_check(IndexExpr &expr) {
+    if (loops.empty() || loops.back().depth != cond_depth)
+        return;
+    auto &loop = loops.back();
+
+    TargetVis index, base;
+    expr.get_index().accept(index);
+    expr.get_base().accept(base);
+    const auto *counter = index.get_target();
+    const auto *var = base.get_target();
+    if (!counter || !var || counter->get_local() != loop.loop->get_local())
+        return;
+
+    // Locals are numbered in order of declaration, so `var` was declared
+    // ahead of the loop. Assigning to an array keeps its length.
+    if (var->get_local() >= loop.loop->get_local()
+        || (!llvm::isa<ArrayType>(var->get_type())
+            && names[var->get_id()].is_mutable))
+        return;
+
+    expr.set_hoisted(true);
+    for (const auto *checked : loop.range_checks) {
+        if (checked->get_local() == var->get_local())
+            return;
+    }
+    loop.range_checks.push_back(var);
+}
+
+void Sema::capture(const IdExpr &var) {
+    for (auto &loop : loops) {
+        const auto *reduced = loop.loop->get_reduction().var;
+        if (!loop.loop->is_parallel()
+            || var.get_local() >= loop.loop->get_local()
+            || (reduced && reduced->get_local() == var.get_local()))
+            continue;
+
+        bool captured = false;
+        for (const auto *other : loop.captures)
+            captured = captured || other->get_local() == var.get_local();
+        if (!captured)
+            loop.captures.push_back(&var);
+    }
+}
+
+bool Sema::check_unshared(const IdExpr &var) {
+    for (const auto &loop : loops) {
+        const auto *reduced = loop.loop->get_reduction().var;
+        if (loop.loop->is_parallel()
+            && var.get_local() < loop.loop->get_local()
+            && !(reduced && reduced->get_local() == var.get_local()))
+            return Log::error_val<bool>("Cannot assign to `",
+                                        get_name(var.get_id()),
+                                        "` within `par for` unless it is "
+                                        "the loop's reduction variable");
+    }
+    return true;
+}
+
+Expr *Sema::convert(Expr &expr, const Type *type) {
+    if (expr.get_type() == type)
+        return &expr;
+    return arena.make<CastExpr>(&expr, type);
+}
+
+void SemaExprVis::visit(LiteralExpr<bool> &expr) {
+    type = sema.types.get_bool();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(LiteralExpr<int32_t> &expr) {
+    type = sema.types.get_int32();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(LiteralExpr<int64_t> &expr) {
+    type = sema.types.get_int64();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(LiteralExpr<double> &expr) {
+    type = sema.types.get_double();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(LiteralExpr<Symbol> &expr) {
+    type = sema.types.get_str_lit();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(IdExpr &expr) {
+    type = nullptr;
+
+    const auto binding = sema.names[expr.get_id()];
+    if (!binding.type)
+        return Log::error("Undeclared variable `",
+                          sema.get_name(expr.get_id()), "`");
+    if (llvm::isa<FunctionType>(binding.type))
+        return Log::error("`", sema.get_name(expr.get_id()),
+                          "` is not a variable");
+    if (llvm::isa<FutureType>(binding.type))
+        return Log::error("Future `", sema.get_name(expr.get_id()),
+                          "` can only be awaited");
+
+    type = binding.type;
+    expr.set_type(type);
+    expr.set_local(binding.local);
+    sema.capture(expr);
+}
+
+void SemaExprVis::visit(BinaryExpr &expr) {
+    type = nullptr;
+
+    SemaExprVis lhs{sema}, rhs{sema};
+    expr.get_lhs().accept(lhs);
+    expr.get_rhs().accept(rhs);
+    if (!lhs.get_type() || !rhs.get_type())
+        return;
+
+    if (!(is_arit(get_lane_type(*lhs.get_type()))
+          && is_arit(get_lane_type(*rhs.get_type()))))
+        return Log::error(
+                "Both parameters of a binary expression must be of arithmetic "
+                "type (`bool`, an integer or a floating point type) or "
+                "vectors thereof");
+
+    // Both operands are promoted to the least type they both widen to,
+    // vectors apply the operator lane by lane
+    const auto *operand_type
+            = sema.types.get_common(*lhs.get_type(), *rhs.get_type());
+    if (!operand_type)
+        return Log::error("Vectors of different lengths cannot be combined");
+    expr.set_lhs(sema.convert(expr.get_lhs(), operand_type));
+    expr.set_rhs(sema.convert(expr.get_rhs(), operand_type));
+
+    switch (expr.get_op()) {
+        case Tok::PLUS:
+        case Tok::MINUS:
+        case Tok::MULT:
+        case Tok::SLASH:
+            type = operand_type;
+            break;
+        case Tok::CMP_LT:
+            type = sema.types.get_bool();
+            if (const auto *vec = llvm::dyn_cast<VectorType>(operand_type))
+                type = sema.types.get_vector(type, vec->get_lanes());
+            break;
+        default:
+            return Log::error("Unknown binary operator");
+    }
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(CallExpr &expr) {
+    type = nullptr;
+
+    const auto callee = sema.names[expr.get_id()];
+    if (!callee.type) {
+        auto builtin = sema.builtins.find(expr.get_id().get_id());
+        if (builtin != sema.builtins.end()) {
+            type = sema.check_builtin(expr, builtin->second);
+            return;
+        }
+    }
+    if (!callee.type)
+        return Log::error("Undeclared function `",
+                          sema.get_name(expr.get_id()), "`");
+
+    const auto *fn_type = llvm::dyn_cast<FunctionType>(callee.type);
+    if (!fn_type)
+        return Log::error("`", sema.get_name(expr.get_id()),
+                          "` is not a function");
+
+    auto expected_arg_n = fn_type->get_args().size();
+    auto given_arg_n = expr.get_args().size();
+    if (expected_arg_n != given_arg_n
+        && !(callee.variadic && expected_arg_n <= given_arg_n))
+        return Log::error("Wrong number of arguments (expected ",
+                          expected_arg_n, " but got ", given_arg_n, ")");
+
+    std::size_t i = 0;
+    const auto &callee_params = fn_type->get_args();
+    for (auto &arg : expr.get_args()) {
+        SemaExprVis arg_vis{sema};
+        arg->accept(arg_vis);
+        const auto *arg_type = arg_vis.get_type();
+        if (!arg_type)
+            return;
+
+        if (i == callee_params.size()) {
+            if (!is_arit(*arg_type) && !llvm::isa<StrLitType>(arg_type))
+                return Log::error("Invalid type of variadic argument");
+            // C promotes variadic arguments to `int` or `double`
+            if (widens_to(*arg_type, *sema.types.get_int32()))
+                arg = sema.convert(*arg, sema.types.get_int32());
+            else if (llvm::isa<FloatType>(arg_type))
+                arg = sema.convert(*arg, sema.types.get_double());
+            continue;
+        }
+        const auto *param_type = callee_params[i++];
+        if (is_array_of_slice(*arg_type, *param_type))
+            arg = sema.convert(*arg, param_type);
+        else if (arg_type != param_type)
+            return Log::error("Function parameter type mismatch");
+    }
+
+    type = fn_type->get_ret_type();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(ScopeExpr &expr) {
+    type = sema.check_scope(expr);
+}
+
+void SemaExprVis::visit(IfExpr &expr) {
+    type = nullptr;
+
+    SemaExprVis cond_vis{sema};
+    expr.get_cond().accept(cond_vis);
+    if (!cond_vis.get_type())
+        return;
+
+    if (!llvm::isa<BoolType>(*cond_vis.get_type()))
+        return Log::error("Condition must be of type `bool`");
+
+    ++sema.cond_depth;
+    const auto *then_type = sema.check_scope(expr.get_then());
+    const auto *else_type
+            = then_type ? sema.check_scope(expr.get_else()) : nullptr;
+    --sema.cond_depth;
+    if (!else_type)
+        return;
+
+    if (then_type != else_type)
+        return Log::error("Types of then and else scope do not match");
+
+    type = then_type;
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(CastExpr &expr) {
+    type = nullptr;
+
+    // Implicit conversions are inserted by Sema once their operand has been
+    // checked
+    if (expr.is_explicit()) {
+        SemaExprVis operand{sema};
+        expr.get_operand().accept(operand);
+        if (!operand.get_type())
+            return;
+
+        // Scalars are splat to vectors, vectors convert lane by lane
+        const auto &from = get_lane_type(*operand.get_type());
+        const auto &to = get_lane_type(*expr.get_type());
+        if (!is_arit(from) || !is_arit(to))
+            return Log::error("Only arithmetic types and vectors can be "
+                              "converted");
+        const auto *from_vec = llvm::dyn_cast<VectorType>(operand.get_type());
+        const auto *to_vec = llvm::dyn_cast<VectorType>(expr.get_type());
+        if (from_vec
+            && (!to_vec || to_vec->get_lanes() != from_vec->get_lanes()))
+            return Log::error("Vectors only convert to vectors of as many "
+                              "lanes");
+        // Truncating to the lowest bit is hardly ever what was meant
+        if (llvm::isa<BoolType>(to) && !llvm::isa<BoolType>(from))
+            return Log::error("Cannot convert to `bool`, compare instead");
+    }
+    type = expr.get_type();
+}
+
+void SemaExprVis::visit(AssignExpr &expr) {
+    type = nullptr;
+
+    TargetVis target_vis;
+    expr.get_target().accept(target_vis);
+    auto *element = target_vis.get_element();
+    auto *target = target_vis.get_target();
+    if (!element && !target)
+        return Log::error("Only variables and elements can be assigned to");
+
+    SemaExprVis var{sema}, value{sema};
+    expr.get_target().accept(var);
+    if (!var.get_type())
+        return;
+
+    // Elements of arrays belong to the variable holding the array, slices
+    // only refer to theirs
+    if (element && llvm::isa<ArrayType>(element->get_base().get_type())) {
+        TargetVis base_vis;
+        element->get_base().accept(base_vis);
+        target = base_vis.get_target();
+        if (!target)
+            return Log::error("Only elements of array variables can be "
+                              "assigned to");
+    }
+    if (target && !sema.names[target->get_id()].is_mutable)
+        return Log::error("Cannot assign to immutable variable `",
+                          sema.get_name(target->get_id()), "`");
+    // Elements of arrays are not shared, unlike the variable as a whole
+    if (!element && !sema.check_unshared(*target))
+        return;
+
+    expr.get_value().accept(value);
+    if (!value.get_type())
+        return;
+
+    // Values are only converted to wider arithmetic types
+    if (value.get_type() != var.get_type()
+        && !widens_to(*value.get_type(), *var.get_type())) {
+        if (element)
+            return Log::error("Assigned value does not match the element "
+                              "type");
+        return Log::error("Assigned value does not match the type of `",
+                          sema.get_name(target->get_id()), "`");
+    }
+    expr.set_value(sema.convert(expr.get_value(), var.get_type()));
+    if (element)
+        expr.set_element(element);
+    else
+        expr.set_local(target->get_local());
+
+    type = sema.types.get_void();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(WhileExpr &expr) {
+    type = nullptr;
+
+    SemaExprVis cond_vis{sema};
+    expr.get_cond().accept(cond_vis);
+    if (!cond_vis.get_type())
+        return;
+
+    if (!llvm::isa<BoolType>(*cond_vis.get_type()))
+        return Log::error("Condition must be of type `bool`");
+
+    ++sema.cond_depth;
+    const auto *body_type = sema.check_scope(expr.get_body());
+    --sema.cond_depth;
+    if (!body_type)
+        return;
+
+    type = sema.types.get_void();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(ForExpr &expr) {
+    type = nullptr;
+
+    SemaExprVis begin{sema}, end{sema};
+    expr.get_begin().accept(begin);
+    if (!begin.get_type())
+        return;
+    expr.get_end().accept(end);
+    if (!end.get_type())
+        return;
+
+    if (!is_integer(*begin.get_type()) || !is_integer(*end.get_type()))
+        return Log::error("Bounds of a `for` loop must be integers");
+    const auto *counter_type
+            = sema.types.get_common(*begin.get_type(), *end.get_type());
+    expr.set_begin(sema.convert(expr.get_begin(), counter_type));
+    expr.set_end(sema.convert(expr.get_end(), counter_type));
+
+    // The result is assigned after the loop, outside of its body
+    if (auto *reduced = expr.get_reduction().var) {
+        SemaExprVis reduced_vis{sema};
+        reduced->accept(reduced_vis);
+        const auto *reduced_type = reduced_vis.get_type();
+        if (!reduced_type)
+            return;
+        if (!sema.names[reduced->get_id()].is_mutable)
+            return Log::error("Reduction variable `",
+                              sema.get_name(reduced->get_id()),
+                              "` must be mutable");
+        if (!is_number(get_lane_type(*reduced_type)))
+            return Log::error("Only numbers and vectors of numbers can be "
+                              "reduced");
+        if (!sema.check_unshared(*reduced))
+            return;
+    }
+
+    // The counter is bound in a scope of its own around the body
+    expr.set_local(sema.num_locals++);
+    sema.names.enter();
+    sema.names.current_scope(expr.get_var())
+            = {counter_type, expr.get_local(), false, false};
+    sema.loops.push_back({&expr, ++sema.cond_depth, {}, {}});
+    const auto *body_type = sema.check_scope(expr.get_body());
+    expr.set_range_checks(sema.arena.copy(sema.loops.back().range_checks));
+    expr.set_captures(sema.arena.copy(sema.loops.back().captures));
+    sema.loops.pop_back();
+    --sema.cond_depth;
+    sema.names.exit();
+    if (!body_type)
+        return;
+
+    type = sema.types.get_void();
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(IndexExpr &expr) {
+    type = nullptr;
+
+    SemaExprVis base{sema}, index{sema};
+    expr.get_base().accept(base);
+    if (!base.get_type())
+        return;
+    expr.get_index().accept(index);
+    if (!index.get_type())
+        return;
+
+    if (const auto *array = llvm::dyn_cast<ArrayType>(base.get_type()))
+        type = array->get_elem();
+    else if (const auto *slice = llvm::dyn_cast<SliceType>(base.get_type()))
+        type = slice->get_elem();
+    else
+        return Log::error("Only arrays and slices can be indexed");
+
+    if (!is_integer(*index.get_type())) {
+        type = nullptr;
+        return Log::error("Indices must be integers");
+    }
+
+    sema.hoist_range_check(expr);
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(ArrayExpr &expr) {
+    type = nullptr;
+
+    // Like the operands of binary expressions, elements are promoted to the
+    // least type they all widen to
+    const Type *elem_type = nullptr;
+    for (auto *elem : expr.get_elems()) {
+        SemaExprVis elem_vis{sema};
+        elem->accept(elem_vis);
+        if (!elem_vis.get_type())
+            return;
+        if (!is_arit(*elem_vis.get_type()))
+            return Log::error("Array elements must be of arithmetic type");
+        elem_type = elem_type
+                            ? sema.types.get_common(*elem_type,
+                                                    *elem_vis.get_type())
+                            : elem_vis.get_type();
+    }
+    for (auto &elem : expr.get_elems())
+        elem = sema.convert(*elem, elem_type);
+
+    type = sema.types.get_array(elem_type, expr.get_size());
+    expr.set_type(type);
+    // Every array stems from an array expression in the function holding it
+    sema.local_arrays = true;
+}
+
+void SemaExprVis::visit(NewExpr &expr) {
+    type = nullptr;
+
+    if (!is_arit(*expr.get_elem()))
+        return Log::error("Array elements must be of arithmetic type");
+
+    SemaExprVis size{sema};
+    expr.get_size().accept(size);
+    if (!size.get_type())
+        return;
+    if (!is_integer(*size.get_type()))
+        return Log::error("Sizes must be integers");
+
+    type = sema.types.get_slice(expr.get_elem());
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(SpawnExpr &expr) {
+    type = nullptr;
+    if (sema.spawn_init != &expr)
+        return Log::error("`spawn` can only initialise an immutable "
+                          "variable");
+    sema.spawn_init = nullptr;
+
+    auto &call = expr.get_call();
+    const auto callee = sema.names[call.get_id()];
+    if (!llvm::isa_and_nonnull<FunctionType>(callee.type) || callee.variadic)
+        return Log::error("Only functions of the program can be spawned (`",
+                          sema.get_name(call.get_id()), "`)");
+
+    SemaExprVis call_vis{sema};
+    call.accept(call_vis);
+    if (!call_vis.get_type())
+        return;
+
+    type = sema.types.get_future(call_vis.get_type());
+    expr.set_type(type);
+}
+
+void SemaExprVis::visit(AwaitExpr &expr) {
+    type = nullptr;
+
+    auto &future = expr.get_future();
+    const auto binding = sema.names[future.get_id()];
+    if (!binding.type)
+        return Log::error("Undeclared variable `",
+                          sema.get_name(future.get_id()), "`");
+    const auto *future_type = llvm::dyn_cast<FutureType>(binding.type);
+    if (!future_type)
+        return Log::error("`", sema.get_name(future.get_id()),
+                          "` is not a future");
+
+    future.set_type(future_type);
+    future.set_local(binding.local);
+    sema.capture(future);
+    type = future_type->get_result();
+    expr.set_type(type);
+}
+
+void SemaStatementVis::visit(Expr &expr) {
+    SemaExprVis expr_vis{sema};
+    expr.accept(expr_vis);
+    type = expr_vis.get_type();
+}
+
+void SemaStatementVis::visit(VarDecl &decl) {
+    SemaExprVis expr_vis{sema};
+    sema.spawn_init = &decl.get_rhs();
+    decl.get_rhs().accept(expr_vis);
+    sema.spawn_init = nullptr;
+    type = expr_vis.get_type();
+    if (!type)
+        return;
+
+    if (decl.is_mutable() && llvm::isa<VoidType>(type)) {
+        type = nullptr;
+        return Log::error("Mutable variable `", sema.get_name(decl.get_id()),
+                          "` cannot be of type `void`");
+    }
+    const bool is_future = llvm::isa<FutureType>(type);
+    if (decl.is_mutable() && is_future) {
+        type = nullptr;
+        return Log::error("Future `", sema.get_name(decl.get_id()),
+                          "` cannot be mutable");
+    }
+
+    decl.set_local(sema.num_locals++);
+    if (is_future)
+        sema.futures.back().push_back(decl.get_local());
+    sema.names.current_scope(decl.get_id())
+            = {type, decl.get_local(), false, decl.is_mutable()};
+}
+
+void SemaStatementVis::visit(FnDecl &) {
+    type = nullptr;
+    Log::error("Functions can only be declared at the top level");
+}
+
+void SemaStatementVis::visit(FnDef &) {
+    type = nullptr;
+    Log::error("Functions can only be defined at the top level");
+}
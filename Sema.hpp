@@ -0,0 +1,155 @@
+#ifndef HXWK_SEMA_H
+#define HXWK_SEMA_H
+
+#include "AST.hpp"
+#include "Arena.hpp"
+#include "IdScoper.hpp"
+#include "StringInterner.hpp"
+#include "Type.hpp"
+#include "VisitorPattern.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Checks a whole translation unit and annotates its tree for IRGenerator:
+// every Expr gets its type, identifiers are resolved to the local they refer
+// to and implicit arithmetic conversions become explicit CastExprs. All
+// signatures are collected before any body is checked, so functions may be
+// called ahead of their definition.
+class Sema {
+  public:
+    friend class SemaExprVis;
+    friend class SemaStatementVis;
+    friend class SemaSignatureVis;
+    // Conversion nodes are allocated in `arena`
+    Sema(StringInterner &interner, TypeContext &types, Arena &arena);
+
+    // Returns false after errors were reported
+    bool run(llvm::ArrayRef<Statement *> statements);
+
+    // The first declaration of each function, in order of appearance.
+    // Declarations and definitions are handed out mutable for later passes
+    // over the tree.
+    llvm::ArrayRef<FnDecl *> get_decls() const { return decls; };
+    llvm::ArrayRef<FnDef *> get_defs() const { return defs; };
+
+  private:
+    struct Binding {
+        // nullptr for unbound identifiers
+        const Type *type;
+        unsigned local;
+        bool variadic;
+        bool is_mutable;
+    };
+    // A `for` loop whose body is being checked
+    struct CountedLoop {
+        ForExpr *loop;
+        // `cond_depth` within the body
+        unsigned depth;
+        llvm::SmallVector<const IdExpr *, 4> range_checks;
+        // Only for `par for` loops
+        llvm::SmallVector<const IdExpr *, 4> captures;
+    };
+
+    bool declare(FnDecl &decl, bool is_def);
+    bool check(FnDef &def);
+    const Type *check_scope(ScopeExpr &scope);
+    // Checks a call to a builtin with no function of its name declared
+    const Type *check_builtin(CallExpr &expr, Builtin builtin);
+    // Takes the types of the checked arguments
+    const Type *check_builtin_args(CallExpr &expr, Builtin builtin,
+                                   llvm::ArrayRef<const Type *> arg_types);
+    // Leaves the bounds check of `expr` to the innermost `for` loop if the
+    // loop's counter is the index and the array or slice cannot change
+    // within the loop. Only elements accessed on every iteration qualify,
+    // so an out of bounds loop traps before its first iteration.
+    void hoist_range_check(IndexExpr &expr);
+    // Adds `var` to the captures of each enclosing `par for` loop it was
+    // declared outside of
+    void capture(const IdExpr &var);
+    // Reports an error if assigning to `var` would write to a variable
+    // shared by the iterations of an enclosing `par for` loop
+    bool check_unshared(const IdExpr &var);
+    // Wraps `expr` in a conversion to `type` unless it already has that type
+    Expr *convert(Expr &expr, const Type *type);
+    const FunctionType *get_signature(const FnDecl &decl);
+    std::string get_name(Symbol sym) const {
+        return interner.get_str(sym).str();
+    };
+
+    StringInterner &interner;
+    TypeContext &types;
+    Arena &arena;
+    IdScoper<Binding> names;
+    llvm::DenseSet<uint32_t> defined;
+    // Builtins by symbol id
+    llvm::DenseMap<uint32_t, Builtin> builtins;
+    unsigned num_locals{0};
+    // Whether the definition being checked creates arrays
+    bool local_arrays{false};
+    std::vector<CountedLoop> loops;
+    // The futures declared in each enclosing scope, innermost last
+    std::vector<llvm::SmallVector<unsigned, 2>> futures;
+    // The initialiser of the variable being declared while it is checked,
+    // the only place where a `spawn` may appear
+    const Expr *spawn_init{nullptr};
+    // Number of enclosing scopes which are not evaluated unconditionally
+    unsigned cond_depth{0};
+    std::vector<FnDecl *> decls;
+    std::vector<FnDef *> defs;
+};
+
+class SemaExprVis : public MutExprVis {
+  public:
+    SemaExprVis(Sema &sema) : sema{sema} {};
+
+    VISIT_MUT(LiteralExpr<bool>);
+    VISIT_MUT(LiteralExpr<int32_t>);
+    VISIT_MUT(LiteralExpr<int64_t>);
+    VISIT_MUT(LiteralExpr<double>);
+    VISIT_MUT(LiteralExpr<Symbol>);
+    VISIT_MUT(IdExpr);
+    VISIT_MUT(BinaryExpr);
+    VISIT_MUT(CallExpr);
+    VISIT_MUT(ScopeExpr);
+    VISIT_MUT(IfExpr);
+    VISIT_MUT(CastExpr);
+    VISIT_MUT(AssignExpr);
+    VISIT_MUT(WhileExpr);
+    VISIT_MUT(ForExpr);
+    VISIT_MUT(IndexExpr);
+    VISIT_MUT(ArrayExpr);
+    VISIT_MUT(NewExpr);
+    VISIT_MUT(SpawnExpr);
+    VISIT_MUT(AwaitExpr);
+
+    // nullptr after errors
+    const Type *get_type() const { return type; };
+
+  private:
+    Sema &sema;
+    const Type *type{nullptr};
+};
+
+class SemaStatementVis : public MutStatementVis {
+  public:
+    SemaStatementVis(Sema &sema) : sema{sema} {};
+
+    VISIT_MUT(Expr);
+    VISIT_MUT(VarDecl);
+    VISIT_MUT(FnDecl);
+    VISIT_MUT(FnDef);
+
+    // The type of the statement's value, nullptr after errors
+    const Type *get_type() const { return type; };
+
+  private:
+    Sema &sema;
+    const Type *type{nullptr};
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "SourceBuffer.hpp"
+#include "C++11Compat.hpp"
+#include "Log.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define error_null(...) Log::error_val<std::nullptr_t>(__VA_ARGS__)
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped_size != 0)
+        ::munmap(const_cast<char *>(first), mapped_size);
+}
+
+std::unique_ptr<SourceBuffer>
+SourceBuffer::from_file(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return error_null("Cannot open `", path, "`: ", std::strerror(errno));
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        return error_null("Cannot stat `", path, "`: ", std::strerror(errno));
+    }
+
+    const auto size = static_cast<std::size_t>(info.st_size);
+    const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    // The zero-filled tail of the last mapped page doubles as the terminating
+    // NUL, which does not exist if the file ends exactly on a page boundary.
+    if (S_ISREG(info.st_mode) && size != 0 && size % page_size != 0) {
+        void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            ::close(fd);
+            ::madvise(mapping, size, MADV_SEQUENTIAL);
+            return std::unique_ptr<SourceBuffer>{new SourceBuffer{
+                    static_cast<const char *>(mapping), size}};
+        }
+    }
+
+    auto buf = from_fd(fd);
+    ::close(fd);
+    return buf;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::from_stdin() {
+    return from_fd(STDIN_FILENO);
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::from_fd(int fd) {
+    constexpr std::size_t chunk_size = 1 << 16;
+
+    std::string contents;
+    std::size_t len = 0;
+    while (true) {
+        contents.resize(len + chunk_size);
+        auto n = ::read(fd, &contents[len], chunk_size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return error_null("Cannot read input: ", std::strerror(errno));
+        }
+        if (n == 0)
+            break;
+        len += static_cast<std::size_t>(n);
+    }
+    contents.resize(len);
+
+    return std::make_unique<SourceBuffer>(std::move(contents));
+}
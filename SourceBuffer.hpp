@@ -0,0 +1,42 @@
+#ifndef HXWK_SOURCEBUFFER_H
+#define HXWK_SOURCEBUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Contiguous, read-only view of a whole source file. Regular files are
+// memory-mapped where possible, everything else (pipes, stdin, files whose
+// size is a multiple of the page size) is slurped into an owned string.
+// Either way the byte at end() is guaranteed to be '\0', so scanners may
+// look one character past the last one without a bounds check.
+class SourceBuffer {
+  public:
+    static std::unique_ptr<SourceBuffer> from_file(const std::string &path);
+    static std::unique_ptr<SourceBuffer> from_stdin();
+
+    SourceBuffer(std::string contents) : storage{std::move(contents)} {
+        first = storage.data();
+        last = first + storage.size();
+    };
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+    ~SourceBuffer();
+
+    const char *begin() const { return first; };
+    const char *end() const { return last; };
+    std::size_t size() const { return last - first; };
+
+  private:
+    SourceBuffer(const char *mapping, std::size_t size)
+            : first{mapping}, last{mapping + size}, mapped_size{size} {};
+
+    static std::unique_ptr<SourceBuffer> from_fd(int fd);
+
+    std::string storage;
+    const char *first;
+    const char *last;
+    std::size_t mapped_size{0};
+};
+
+#endif
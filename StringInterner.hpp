@@ -0,0 +1,64 @@
+#ifndef HXWK_STRINGINTERNER_H
+#define HXWK_STRINGINTERNER_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Handle to a string stored in a StringInterner. Two symbols from the same
+// interner are equal iff their spellings are, so comparing and hashing names
+// never touches their characters.
+class Symbol {
+  public:
+    Symbol() = default;
+
+    std::uint32_t get_id() const { return id; };
+    explicit operator bool() const { return id != 0; };
+
+    bool operator==(Symbol rhs) const { return id == rhs.id; };
+    bool operator!=(Symbol rhs) const { return id != rhs.id; };
+    bool operator<(Symbol rhs) const { return id < rhs.id; };
+
+  private:
+    friend class StringInterner;
+    explicit Symbol(std::uint32_t id) : id{id} {};
+
+    // 0 is reserved for the empty, invalid symbol
+    std::uint32_t id{0};
+};
+
+namespace std {
+template <>
+struct hash<Symbol> {
+    std::size_t operator()(Symbol sym) const { return sym.get_id(); };
+};
+}
+
+class StringInterner {
+  public:
+    StringInterner() { strings.emplace_back(); };
+    StringInterner(const StringInterner &) = delete;
+    StringInterner &operator=(const StringInterner &) = delete;
+
+    Symbol intern(llvm::StringRef str) {
+        auto entry = map.try_emplace(str, Symbol{});
+        if (entry.second) {
+            entry.first->second = Symbol{
+                    static_cast<std::uint32_t>(strings.size())};
+            strings.push_back(entry.first->first());
+        }
+        return entry.first->second;
+    };
+
+    // The returned reference stays valid as long as the interner lives.
+    llvm::StringRef get_str(Symbol sym) const { return strings[sym.id]; };
+
+  private:
+    llvm::StringMap<Symbol, llvm::BumpPtrAllocator> map;
+    std::vector<llvm::StringRef> strings;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "Target.hpp"
+#include "Log.hpp"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+void initialize_targets() {
+    static bool initialized = [] {
+        llvm::InitializeAllTargetInfos();
+        llvm::InitializeAllTargets();
+        llvm::InitializeAllTargetMCs();
+        llvm::InitializeAllAsmPrinters();
+        llvm::InitializeAllAsmParsers();
+        return true;
+    }();
+    (void)initialized;
+}
+
+llvm::CodeGenOpt::Level get_codegen_level(unsigned opt_level) {
+    switch (opt_level) {
+        case 0:
+            return llvm::CodeGenOpt::None;
+        case 1:
+            return llvm::CodeGenOpt::Less;
+        case 2:
+            return llvm::CodeGenOpt::Default;
+        default:
+            return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+std::unique_ptr<llvm::TargetMachine>
+create_target_machine(const TargetSpec &spec) {
+    initialize_targets();
+
+    llvm::Triple triple{llvm::sys::getDefaultTargetTriple()};
+    std::string cpu = spec.cpu;
+    std::string features;
+
+    // Like GCC, accept `-march=native` as a synonym for `-mcpu=native`
+    std::string arch = spec.arch;
+    if (arch == "native") {
+        arch.clear();
+        cpu = "native";
+    }
+
+    std::string error;
+    const auto *target
+            = llvm::TargetRegistry::lookupTarget(arch, triple, error);
+    if (!target) {
+        Log::error("Unsupported target architecture `",
+                   arch.empty() ? triple.getTriple() : arch, "`");
+        return nullptr;
+    }
+
+    if (cpu == "native") {
+        cpu = llvm::sys::getHostCPUName().str();
+
+        llvm::SubtargetFeatures host_features;
+        llvm::StringMap<bool> feature_map;
+        if (llvm::sys::getHostCPUFeatures(feature_map)) {
+            for (const auto &feature : feature_map)
+                host_features.AddFeature(feature.first(), feature.second);
+        }
+        features = host_features.getString();
+    } else if (cpu.empty()) {
+        cpu = "generic";
+    }
+
+    llvm::TargetOptions options;
+    auto *tm = target->createTargetMachine(
+            triple.getTriple(), cpu, features, options, llvm::Reloc::PIC_,
+            llvm::None, get_codegen_level(spec.opt_level));
+    if (!tm)
+        Log::error("Cannot create target machine for ", triple.getTriple());
+    return std::unique_ptr<llvm::TargetMachine>{tm};
+}
+
+unsigned get_native_vector_bits(llvm::TargetMachine &tm) {
+    // Cost queries are answered per function, as functions may be compiled
+    // for subtargets of their own. This one has the target's defaults.
+    llvm::LLVMContext context;
+    llvm::Module module{"vector-width", context};
+    auto *fn = llvm::Function::Create(
+            llvm::FunctionType::get(llvm::Type::getVoidTy(context), false),
+            llvm::GlobalValue::ExternalLinkage, "f", module);
+    const auto bits
+            = tm.getTargetTransformInfo(*fn)
+                      .getRegisterBitWidth(
+                              llvm::TargetTransformInfo::RGK_FixedWidthVector)
+                      .getFixedSize();
+    return bits ? static_cast<unsigned>(bits) : 128;
+}
+
+bool emit_native(llvm::Module &module, llvm::TargetMachine &tm, bool assembly,
+                 llvm::SmallVectorImpl<char> &out) {
+    // Object emission needs a seekable stream
+    llvm::raw_svector_ostream out_stream{out};
+
+    llvm::legacy::PassManager pm;
+    if (tm.addPassesToEmitFile(pm, out_stream, nullptr,
+                               assembly ? llvm::CGFT_AssemblyFile
+                                        : llvm::CGFT_ObjectFile)) {
+        Log::error("Target cannot emit this file type");
+        return false;
+    }
+    pm.run(module);
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef HXWK_TARGET_H
+#define HXWK_TARGET_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CodeGen.h"
+#include <memory>
+#include <string>
+
+namespace llvm {
+class Module;
+class TargetMachine;
+}
+
+// Target selection as given on the command line. An empty `arch` means the
+// host's architecture, `cpu` may be `native` to tune for and use all
+// features of the host CPU.
+struct TargetSpec {
+    std::string arch;
+    std::string cpu;
+    unsigned opt_level{0};
+};
+
+// Registers every target LLVM was built with, may be called repeatedly
+void initialize_targets();
+llvm::CodeGenOpt::Level get_codegen_level(unsigned opt_level);
+
+// Returns nullptr after reporting an error if the target is unknown
+std::unique_ptr<llvm::TargetMachine>
+create_target_machine(const TargetSpec &spec);
+
+// The width in bits of the vector registers of `tm`'s target
+unsigned get_native_vector_bits(llvm::TargetMachine &tm);
+
+// Appends native assembly or object code for `module` to `out`, returns false
+// after reporting an error if `tm` cannot emit that file type
+bool emit_native(llvm::Module &module, llvm::TargetMachine &tm, bool assembly,
+                 llvm::SmallVectorImpl<char> &out);
+
+#endif
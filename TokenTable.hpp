@@ -0,0 +1,222 @@
+#ifndef HXWK_TOKENTABLE_H
+#define HXWK_TOKENTABLE_H
+
+#include "Lexer.hpp"
+#include "Type.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Spellings with a fixed meaning, shared by the Lexer (to classify words and
+// punctuation) and the Parser (to map type names and operator precedences).
+// Both word and operator lookups go through perfect hash tables generated at
+// compile time, so recognising a keyword costs one hash and one memcmp.
+
+enum class Assoc { LEFT, RIGHT };
+
+struct Keyword {
+    const char *spelling;
+    Tok tok;
+    // Only meaningful for `Tok::TYPE`
+    Type::TypeKind type_kind;
+};
+
+struct Operator {
+    const char *spelling;
+    Tok tok;
+    // Binary operators have a non-zero precedence
+    int precedence;
+    Assoc assoc;
+};
+
+constexpr Keyword keywords[] = {
+        {"let", Tok::LET, Type::TypeKind::Simple},
+        {"mut", Tok::MUT, Type::TypeKind::Simple},
+        {"if", Tok::IF, Type::TypeKind::Simple},
+        {"else", Tok::ELSE, Type::TypeKind::Simple},
+        {"while", Tok::WHILE, Type::TypeKind::Simple},
+        {"for", Tok::FOR, Type::TypeKind::Simple},
+        {"par", Tok::PAR, Type::TypeKind::Simple},
+        {"in", Tok::IN, Type::TypeKind::Simple},
+        {"new", Tok::NEW, Type::TypeKind::Simple},
+        {"spawn", Tok::SPAWN, Type::TypeKind::Simple},
+        {"await", Tok::AWAIT, Type::TypeKind::Simple},
+        {"as", Tok::AS, Type::TypeKind::Simple},
+        {"vec", Tok::VEC, Type::TypeKind::Simple},
+        {"fn", Tok::FN, Type::TypeKind::Simple},
+        {"void", Tok::TYPE, Type::TypeKind::Void},
+        {"bool", Tok::TYPE, Type::TypeKind::Bool},
+        {"u8", Tok::TYPE, Type::TypeKind::UInt8},
+        {"i32", Tok::TYPE, Type::TypeKind::Int32},
+        {"u32", Tok::TYPE, Type::TypeKind::UInt32},
+        {"i64", Tok::TYPE, Type::TypeKind::Int64},
+        {"f32", Tok::TYPE, Type::TypeKind::Float},
+        {"double", Tok::TYPE, Type::TypeKind::Double},
+};
+
+constexpr Operator operators[] = {
+        {",", Tok::COMMA, 0, Assoc::LEFT},
+        {":", Tok::COLON, 0, Assoc::LEFT},
+        {";", Tok::SEMICOLON, 0, Assoc::LEFT},
+        {"(", Tok::P_OPEN, 0, Assoc::LEFT},
+        {")", Tok::P_CLOSE, 0, Assoc::LEFT},
+        {"{", Tok::BR_OPEN, 0, Assoc::LEFT},
+        {"}", Tok::BR_CLOSE, 0, Assoc::LEFT},
+        {"[", Tok::SQ_OPEN, 0, Assoc::LEFT},
+        {"]", Tok::SQ_CLOSE, 0, Assoc::LEFT},
+        {"#[", Tok::ATTR_OPEN, 0, Assoc::LEFT},
+        {"->", Tok::RARROW, 0, Assoc::LEFT},
+        {"..", Tok::DOTDOT, 0, Assoc::LEFT},
+        {"=", Tok::EQ, 10, Assoc::RIGHT},
+        {"<", Tok::CMP_LT, 17, Assoc::LEFT},
+        // Only closes the parameters of `vec<T, N>` so far
+        {">", Tok::CMP_GT, 0, Assoc::LEFT},
+        {"+", Tok::PLUS, 20, Assoc::LEFT},
+        {"-", Tok::MINUS, 20, Assoc::LEFT},
+        {"*", Tok::MULT, 30, Assoc::LEFT},
+        {"/", Tok::SLASH, 30, Assoc::LEFT},
+};
+
+namespace detail {
+
+constexpr std::size_t length(const char *str) {
+    std::size_t len = 0;
+    while (str[len] != '\0')
+        ++len;
+    return len;
+}
+
+constexpr std::uint32_t hash(std::uint32_t seed, const char *str,
+                             std::size_t len) {
+    std::uint32_t h = static_cast<std::uint32_t>(len);
+    h = h * seed + static_cast<unsigned char>(str[0]);
+    h = h * seed + static_cast<unsigned char>(str[len / 2]);
+    h = h * seed + static_cast<unsigned char>(str[len - 1]);
+    return h ^ (h >> 11);
+}
+
+// Open table of `Size` slots holding indices into an entry array. The seed is
+// searched for at compile time such that no two spellings share a slot.
+template <std::size_t Size>
+struct PerfectHash {
+    static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+    std::uint32_t seed{0};
+    std::size_t min_len{~std::size_t{0}}, max_len{0};
+    std::int8_t slots[Size]{};
+
+    constexpr std::size_t slot(const char *str, std::size_t len) const {
+        return hash(seed, str, len) & (Size - 1);
+    }
+};
+
+template <std::size_t Size, typename Entry, std::size_t N>
+constexpr PerfectHash<Size> make_perfect_hash(const Entry (&entries)[N],
+                                              std::size_t only_len = 0) {
+    PerfectHash<Size> table{};
+    for (std::uint32_t seed = 1; seed != 0; ++seed) {
+        table.seed = seed;
+        for (auto &slot : table.slots)
+            slot = -1;
+
+        bool collision = false;
+        for (std::size_t i = 0; i < N && !collision; ++i) {
+            auto len = length(entries[i].spelling);
+            if (only_len != 0 && len != only_len)
+                continue;
+
+            auto &slot = table.slots[table.slot(entries[i].spelling, len)];
+            collision = slot != -1;
+            slot = static_cast<std::int8_t>(i);
+            table.min_len = len < table.min_len ? len : table.min_len;
+            table.max_len = len > table.max_len ? len : table.max_len;
+        }
+
+        if (!collision)
+            return table;
+    }
+    return table;
+}
+
+constexpr auto keyword_hash = make_perfect_hash<32>(keywords);
+// Single character operators are looked up directly by their character.
+constexpr auto operator_hash = make_perfect_hash<16>(operators, 2);
+
+struct CharTable {
+    std::int8_t slots[128]{};
+};
+
+constexpr CharTable make_char_table() {
+    CharTable table{};
+    for (auto &slot : table.slots)
+        slot = -1;
+    for (std::size_t i = 0; i < sizeof(operators) / sizeof(*operators); ++i) {
+        if (length(operators[i].spelling) == 1)
+            table.slots[static_cast<unsigned char>(operators[i].spelling[0])]
+                    = static_cast<std::int8_t>(i);
+    }
+    return table;
+}
+
+constexpr auto operator_chars = make_char_table();
+
+struct PrecedenceTable {
+    const Operator *ops[static_cast<std::size_t>(Tok::NUM_TOKS)]{};
+};
+
+constexpr PrecedenceTable make_precedence_table() {
+    PrecedenceTable table{};
+    for (const auto &op : operators)
+        table.ops[static_cast<std::size_t>(op.tok)] = &op;
+    return table;
+}
+
+constexpr auto operator_by_tok = make_precedence_table();
+
+}
+
+static_assert(detail::keyword_hash.seed != 0, "No perfect hash for keywords");
+static_assert(detail::operator_hash.seed != 0,
+              "No perfect hash for operators");
+
+// Returns the keyword spelled by [str, str + len) or nullptr
+inline const Keyword *find_keyword(const char *str, std::size_t len) {
+    const auto &table = detail::keyword_hash;
+    if (len < table.min_len || len > table.max_len)
+        return nullptr;
+
+    auto i = table.slots[table.slot(str, len)];
+    if (i < 0)
+        return nullptr;
+
+    const auto &kw = keywords[i];
+    return std::strncmp(kw.spelling, str, len) == 0 && kw.spelling[len] == '\0'
+                   ? &kw
+                   : nullptr;
+}
+
+// Returns the longest operator starting at `str` or nullptr. `str` must be
+// followed by at least one more readable character (e.g. a terminating NUL).
+inline const Operator *find_operator(const char *str) {
+    const auto &table = detail::operator_hash;
+    auto i = table.slots[table.slot(str, 2)];
+    if (i >= 0 && operators[i].spelling[0] == str[0]
+        && operators[i].spelling[1] == str[1])
+        return &operators[i];
+
+    const auto c = static_cast<unsigned char>(*str);
+    if (c >= 128 || (i = detail::operator_chars.slots[c]) < 0)
+        return nullptr;
+    return &operators[i];
+}
+
+inline std::size_t spelling_length(const Operator &op) {
+    return op.spelling[1] == '\0' ? 1 : 2;
+}
+
+// Returns the operator table entry of `tok` or nullptr for non-operators
+constexpr const Operator *find_operator(Tok tok) {
+    return detail::operator_by_tok.ops[static_cast<std::size_t>(tok)];
+}
+
+#endif
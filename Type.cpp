@@ -0,0 +1,158 @@
+#include "Type.hpp"
+#include "llvm/Support/Casting.h"
+#include <cstddef>
+
+namespace {
+
+constexpr auto first_arith = static_cast<std::size_t>(Type::TypeKind::Bool);
+constexpr auto num_arith
+        = static_cast<std::size_t>(Type::TypeKind::Double) - first_arith + 1;
+
+// In the order of the arithmetic kinds: bool, u8, i32, u32, i64, f32, double
+constexpr ArithTraits arith_traits[num_arith] = {
+        {1, false, false}, {8, false, false}, {32, false, true},
+        {32, false, false}, {64, false, true}, {32, true, true},
+        {64, true, true},
+};
+
+// widens[from][to], the lattice of implicit conversions. Integers widen to
+// `f32` only if it holds all their values, but to `double` regardless.
+constexpr bool widens[num_arith][num_arith] = {
+        // bool  u8     i32    u32    i64    f32    double
+        {true, true, true, true, true, true, true},      // bool
+        {false, true, true, true, true, true, true},     // u8
+        {false, false, true, false, true, false, true},  // i32
+        {false, false, false, true, true, false, true},  // u32
+        {false, false, false, false, true, false, true}, // i64
+        {false, false, false, false, false, true, true}, // f32
+        {false, false, false, false, false, false, true} // double
+};
+
+// Index into the tables above, num_arith for other types
+std::size_t arith_index(const Type &type) {
+    const auto kind = static_cast<std::size_t>(type.getKind());
+    return kind >= first_arith && kind < first_arith + num_arith
+                   ? kind - first_arith
+                   : num_arith;
+}
+
+}
+
+const ArithTraits *get_arith_traits(const Type &type) {
+    const auto i = arith_index(type);
+    return i < num_arith ? &arith_traits[i] : nullptr;
+}
+
+const Type &get_lane_type(const Type &type) {
+    const auto *vec = llvm::dyn_cast<VectorType>(&type);
+    return vec ? *vec->get_elem() : type;
+}
+
+bool widens_to(const Type &from, const Type &to) {
+    const auto *from_vec = llvm::dyn_cast<VectorType>(&from);
+    const auto *to_vec = llvm::dyn_cast<VectorType>(&to);
+    if (from_vec || to_vec)
+        return from_vec && to_vec
+               && from_vec->get_lanes() == to_vec->get_lanes()
+               && widens_to(*from_vec->get_elem(), *to_vec->get_elem());
+
+    const auto i = arith_index(from), j = arith_index(to);
+    return i < num_arith && j < num_arith && widens[i][j];
+}
+
+const Type *TypeContext::get_simple(Type::TypeKind kind) const {
+    switch (kind) {
+        case Type::TypeKind::Void:
+            return get_void();
+        case Type::TypeKind::Bool:
+            return get_bool();
+        case Type::TypeKind::UInt8:
+            return get_uint8();
+        case Type::TypeKind::Int32:
+            return get_int32();
+        case Type::TypeKind::UInt32:
+            return get_uint32();
+        case Type::TypeKind::Int64:
+            return get_int64();
+        case Type::TypeKind::Float:
+            return get_float();
+        case Type::TypeKind::Double:
+            return get_double();
+        case Type::TypeKind::StrLit:
+            return get_str_lit();
+        default:
+            return nullptr;
+    }
+}
+
+const Type *TypeContext::get_common(const Type &lhs, const Type &rhs) {
+    const auto *lhs_vec = llvm::dyn_cast<VectorType>(&lhs);
+    const auto *rhs_vec = llvm::dyn_cast<VectorType>(&rhs);
+    if (lhs_vec || rhs_vec) {
+        const auto lanes = (lhs_vec ? lhs_vec : rhs_vec)->get_lanes();
+        if (lhs_vec && rhs_vec && rhs_vec->get_lanes() != lanes)
+            return nullptr;
+        const auto *elem
+                = get_common(lhs_vec ? *lhs_vec->get_elem() : lhs,
+                             rhs_vec ? *rhs_vec->get_elem() : rhs);
+        return elem ? get_vector(elem, lanes) : nullptr;
+    }
+
+    const auto i = arith_index(lhs), j = arith_index(rhs);
+    if (i == num_arith || j == num_arith)
+        return nullptr;
+    // Kinds are ordered along the lattice, the first common one is the least
+    for (auto k = i > j ? i : j; k < num_arith; ++k) {
+        if (widens[i][k] && widens[j][k])
+            return get_simple(static_cast<Type::TypeKind>(first_arith + k));
+    }
+    return nullptr;
+}
+
+const FunctionType *
+TypeContext::get_function(std::vector<const Type *> param_types,
+                          const Type *ret_type) {
+    std::lock_guard<std::mutex> lock{derived_types_mutex};
+    auto &type = function_types[{param_types, ret_type}];
+    if (!type)
+        type.reset(new FunctionType{std::move(param_types), ret_type});
+    return type.get();
+}
+
+const ArrayType *TypeContext::get_array(const Type *elem, uint32_t size) {
+    std::lock_guard<std::mutex> lock{derived_types_mutex};
+    auto &type = array_types[{elem, size}];
+    if (!type)
+        type.reset(new ArrayType{elem, size});
+    return type.get();
+}
+
+const SliceType *TypeContext::get_slice(const Type *elem) {
+    std::lock_guard<std::mutex> lock{derived_types_mutex};
+    auto &type = slice_types[elem];
+    if (!type)
+        type.reset(new SliceType{elem});
+    return type.get();
+}
+
+const VectorType *TypeContext::get_vector(const Type *elem, uint32_t lanes) {
+    std::lock_guard<std::mutex> lock{derived_types_mutex};
+    auto &type = vector_types[{elem, lanes}];
+    if (!type)
+        type.reset(new VectorType{elem, lanes});
+    return type.get();
+}
+
+const FutureType *TypeContext::get_future(const Type *result) {
+    std::lock_guard<std::mutex> lock{derived_types_mutex};
+    auto &type = future_types[result];
+    if (!type)
+        type.reset(new FutureType{result});
+    return type.get();
+}
+
+uint32_t TypeContext::get_native_lanes(const Type &elem) const {
+    const auto *traits = get_arith_traits(elem);
+    const auto lanes = traits ? native_vector_bits / traits->bits : 1;
+    return lanes ? lanes : 1;
+}
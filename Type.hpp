@@ -1,23 +1,46 @@
 #ifndef HXWK_TYPES_H
 #define HXWK_TYPES_H
 
+#include <cstdint>
+#include <map>
 #include <memory>
-#include <type_traits>
+#include <mutex>
+#include <utility>
 #include <vector>
 
+// Types are interned by a TypeContext, which creates each distinct type
+// exactly once. They are therefore compared by pointer and never copied.
 class Type {
   public:
-    enum class TypeKind { Simple, Void, Bool, Int32, Double, StrLit, Function };
+    enum class TypeKind {
+        Simple,
+        Void,
+        // The arithmetic kinds are contiguous, ordered such that each type
+        // comes before every type it widens to
+        Bool,
+        UInt8,
+        Int32,
+        UInt32,
+        Int64,
+        Float,
+        Double,
+        StrLit,
+        Function,
+        Array,
+        Slice,
+        Vector,
+        Future
+    };
 
     virtual ~Type() = default;
 
-    Type(TypeKind kind) : kind{kind} {};
+    Type(const Type &) = delete;
+    Type &operator=(const Type &) = delete;
+
     TypeKind getKind() const { return kind; };
 
-    virtual bool operator==(const Type &rhs) const {
-        return kind == rhs.getKind();
-    };
-    bool operator!=(const Type &rhs) { return !(*this == rhs); };
+  protected:
+    Type(TypeKind kind) : kind{kind} {};
 
   private:
     const TypeKind kind;
@@ -25,86 +48,284 @@ class Type {
 
 class SimpleType : public virtual Type {
   public:
-    SimpleType() : Type{TypeKind::Simple} {};
-
     static bool classof(const Type *type) {
         return type->getKind() >= TypeKind::Simple
                && type->getKind() <= TypeKind::StrLit;
     };
+
+  protected:
+    SimpleType() : Type{TypeKind::Simple} {};
 };
 
 class VoidType : public SimpleType {
   public:
-    VoidType() : Type{TypeKind::Void} {};
-
     static bool classof(const Type *type) {
         return type->getKind() == TypeKind::Void;
     };
+
+  private:
+    friend class TypeContext;
+    VoidType() : Type{TypeKind::Void} {};
 };
 
 class BoolType : public SimpleType {
   public:
+    static bool classof(const Type *type) {
+        return type->getKind() == TypeKind::Bool;
+    };
+
+  private:
+    friend class TypeContext;
     BoolType() : Type{TypeKind::Bool} {};
+};
 
+class UInt8Type : public SimpleType {
+  public:
     static bool classof(const Type *type) {
-        return type->getKind() == TypeKind::Bool;
+        return type->getKind() == TypeKind::UInt8;
     };
+
+  private:
+    friend class TypeContext;
+    UInt8Type() : Type{TypeKind::UInt8} {};
 };
 
 class Int32Type : public SimpleType {
   public:
+    static bool classof(const Type *type) {
+        return type->getKind() == TypeKind::Int32;
+    };
+
+  private:
+    friend class TypeContext;
     Int32Type() : Type{TypeKind::Int32} {};
+};
 
+class UInt32Type : public SimpleType {
+  public:
     static bool classof(const Type *type) {
-        return type->getKind() == TypeKind::Int32;
+        return type->getKind() == TypeKind::UInt32;
     };
+
+  private:
+    friend class TypeContext;
+    UInt32Type() : Type{TypeKind::UInt32} {};
 };
 
-class DoubleType : public SimpleType {
+class Int64Type : public SimpleType {
   public:
-    DoubleType() : Type{TypeKind::Double} {};
+    static bool classof(const Type *type) {
+        return type->getKind() == TypeKind::Int64;
+    };
 
+  private:
+    friend class TypeContext;
+    Int64Type() : Type{TypeKind::Int64} {};
+};
+
+// `f32`
+class FloatType : public SimpleType {
+  public:
+    static bool classof(const Type *type) {
+        return type->getKind() == TypeKind::Float;
+    };
+
+  private:
+    friend class TypeContext;
+    FloatType() : Type{TypeKind::Float} {};
+};
+
+class DoubleType : public SimpleType {
+  public:
     static bool classof(const Type *type) {
         return type->getKind() == TypeKind::Double;
     };
+
+  private:
+    friend class TypeContext;
+    DoubleType() : Type{TypeKind::Double} {};
 };
 
 class StrLitType : public SimpleType {
   public:
-    StrLitType() : Type{TypeKind::StrLit} {};
-
     static bool classof(const Type *type) {
         return type->getKind() == TypeKind::StrLit;
     };
+
+  private:
+    friend class TypeContext;
+    StrLitType() : Type{TypeKind::StrLit} {};
 };
 
 class FunctionType : public Type {
   public:
-    FunctionType(std::vector<std::shared_ptr<Type>> param_types,
-                 std::shared_ptr<Type> ret_type)
+    const std::vector<const Type *> &get_args() const { return param_types; };
+    const Type *get_ret_type() const { return ret_type; };
+
+    static bool classof(const Type *type) {
+        return type->getKind() == TypeKind::Function;
+    };
+
+  private:
+    friend class TypeContext;
+    FunctionType(std::vector<const Type *> param_types, const Type *ret_type)
             : Type{TypeKind::Function},
               param_types{std::move(param_types)},
-              ret_type{std::move(ret_type)} {};
+              ret_type{ret_type} {};
 
-    const std::vector<std::shared_ptr<Type>> get_args() const {
-        return param_types;
+    std::vector<const Type *> param_types;
+    const Type *ret_type;
+};
+
+// `[elem; size]`, a fixed number of elements stored in place
+class ArrayType : public Type {
+  public:
+    const Type *get_elem() const { return elem; };
+    uint32_t get_size() const { return size; };
+
+    static bool classof(const Type *type) {
+        return type->getKind() == TypeKind::Array;
     };
-    const std::shared_ptr<Type> &get_ret_type() const { return ret_type; };
+
+  private:
+    friend class TypeContext;
+    ArrayType(const Type *elem, uint32_t size)
+            : Type{TypeKind::Array}, elem{elem}, size{size} {};
+
+    const Type *elem;
+    uint32_t size;
+};
+
+// `[elem]`, refers to elements stored elsewhere and knows their number. A
+// slice does not keep the elements it refers to alive.
+class SliceType : public Type {
+  public:
+    const Type *get_elem() const { return elem; };
 
     static bool classof(const Type *type) {
-        return type->getKind() == TypeKind::Function;
+        return type->getKind() == TypeKind::Slice;
     };
 
-    bool operator==(const Type &rhs) const override {
-        const FunctionType &rhs_fn = *static_cast<const FunctionType *>(&rhs);
+  private:
+    friend class TypeContext;
+    SliceType(const Type *elem) : Type{TypeKind::Slice}, elem{elem} {};
 
-        return Type::operator==(rhs) && ret_type == rhs_fn.ret_type
-               && param_types.size() == rhs_fn.param_types.size();
+    const Type *elem;
+};
+
+// How values of an arithmetic type are represented
+struct ArithTraits {
+    unsigned bits;
+    bool is_float;
+    // Decides between signed and unsigned division, comparison, extension
+    // and conversion from and to floating point
+    bool is_signed;
+};
+
+// Returns nullptr unless `type` is arithmetic: `bool`, an integer or a
+// floating point type
+const ArithTraits *get_arith_traits(const Type &type);
+// The type of the lanes of a vector, any other type itself
+const Type &get_lane_type(const Type &type);
+// Whether `from` implicitly converts to `to`. Implicit conversions keep every
+// value, except for the precision of large integers converted to `double`.
+// Vectors widen lane by lane to vectors of as many lanes.
+bool widens_to(const Type &from, const Type &to);
+
+// `vec<elem, lanes>`, a SIMD vector of arithmetic elements which operators
+// apply to lane by lane. Comparisons yield vectors of `bool`.
+class VectorType : public Type {
+  public:
+    const Type *get_elem() const { return elem; };
+    uint32_t get_lanes() const { return lanes; };
+
+    static bool classof(const Type *type) {
+        return type->getKind() == TypeKind::Vector;
     };
 
   private:
-    std::vector<std::shared_ptr<Type>> param_types;
-    std::shared_ptr<Type> ret_type;
+    friend class TypeContext;
+    VectorType(const Type *elem, uint32_t lanes)
+            : Type{TypeKind::Vector}, elem{elem}, lanes{lanes} {};
+
+    const Type *elem;
+    uint32_t lanes;
+};
+
+// The type of `spawn f(args)`, whose result is of type `result` once
+// awaited. It cannot be named, so futures cannot be passed around.
+class FutureType : public Type {
+  public:
+    const Type *get_result() const { return result; };
+
+    static bool classof(const Type *type) {
+        return type->getKind() == TypeKind::Future;
+    };
+
+  private:
+    friend class TypeContext;
+    FutureType(const Type *result) : Type{TypeKind::Future}, result{result} {};
+
+    const Type *result;
+};
+
+class TypeContext {
+  public:
+    TypeContext() = default;
+    TypeContext(const TypeContext &) = delete;
+    TypeContext &operator=(const TypeContext &) = delete;
+
+    const VoidType *get_void() const { return &void_type; };
+    const BoolType *get_bool() const { return &bool_type; };
+    const UInt8Type *get_uint8() const { return &uint8_type; };
+    const Int32Type *get_int32() const { return &int32_type; };
+    const UInt32Type *get_uint32() const { return &uint32_type; };
+    const Int64Type *get_int64() const { return &int64_type; };
+    const FloatType *get_float() const { return &float_type; };
+    const DoubleType *get_double() const { return &double_type; };
+    const StrLitType *get_str_lit() const { return &str_lit_type; };
+    // Returns nullptr for kinds which are not simple types
+    const Type *get_simple(Type::TypeKind kind) const;
+    // The least type both arithmetic types widen to, which binary
+    // expressions convert their operands to. Along with a vector, scalars
+    // are converted to vectors of as many lanes. Returns nullptr for
+    // vectors of different lengths.
+    const Type *get_common(const Type &lhs, const Type &rhs);
+    // May be called from several threads at once
+    const FunctionType *get_function(std::vector<const Type *> param_types,
+                                     const Type *ret_type);
+    // Like get_function
+    const ArrayType *get_array(const Type *elem, uint32_t size);
+    const SliceType *get_slice(const Type *elem);
+    const VectorType *get_vector(const Type *elem, uint32_t lanes);
+    const FutureType *get_future(const Type *result);
+    // The number of lanes of type `elem` filling one of the target's vector
+    // registers, at least 1
+    uint32_t get_native_lanes(const Type &elem) const;
+    void set_native_vector_bits(unsigned bits) { native_vector_bits = bits; };
+
+  private:
+    using FunctionKey = std::pair<std::vector<const Type *>, const Type *>;
+    using ArrayKey = std::pair<const Type *, uint32_t>;
+
+    VoidType void_type;
+    BoolType bool_type;
+    UInt8Type uint8_type;
+    Int32Type int32_type;
+    UInt32Type uint32_type;
+    Int64Type int64_type;
+    FloatType float_type;
+    DoubleType double_type;
+    StrLitType str_lit_type;
+    // Guards the maps of derived types below
+    std::mutex derived_types_mutex;
+    std::map<FunctionKey, std::unique_ptr<FunctionType>> function_types;
+    std::map<ArrayKey, std::unique_ptr<ArrayType>> array_types;
+    std::map<const Type *, std::unique_ptr<SliceType>> slice_types;
+    std::map<ArrayKey, std::unique_ptr<VectorType>> vector_types;
+    std::map<const Type *, std::unique_ptr<FutureType>> future_types;
+    // SSE and NEON registers, unless the target says otherwise
+    unsigned native_vector_bits{128};
 };
 
 #endif
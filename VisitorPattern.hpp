@@ -9,3 +9,16 @@
 
 #define VISIT(visitable_type)                                                 \
     void visit(const visitable_type &visitable) override
+
+// Variants for visitors which annotate or rewrite the nodes they visit
+#define ABSTR_ACCEPT_MUT(visitor_type)                                        \
+    virtual void accept(visitor_type &visitor) = 0
+
+#define ACCEPT_MUT(visitor_type)                                              \
+    void accept(visitor_type &visitor) override { visitor.visit(*this); }
+
+#define ABSTR_VISIT_MUT(visitable_type)                                       \
+    virtual void visit(visitable_type &visitable) = 0
+
+#define VISIT_MUT(visitable_type)                                             \
+    void visit(visitable_type &visitable) override
@@ -0,0 +1,36 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/CharScan.cpp" "CMakeFiles/hxwk.dir/CharScan.cpp.o" "gcc" "CMakeFiles/hxwk.dir/CharScan.cpp.o.d"
+  "/root/repo/CharScanAVX2.cpp" "CMakeFiles/hxwk.dir/CharScanAVX2.cpp.o" "gcc" "CMakeFiles/hxwk.dir/CharScanAVX2.cpp.o.d"
+  "/root/repo/CompileCache.cpp" "CMakeFiles/hxwk.dir/CompileCache.cpp.o" "gcc" "CMakeFiles/hxwk.dir/CompileCache.cpp.o.d"
+  "/root/repo/ConstFold.cpp" "CMakeFiles/hxwk.dir/ConstFold.cpp.o" "gcc" "CMakeFiles/hxwk.dir/ConstFold.cpp.o.d"
+  "/root/repo/Effects.cpp" "CMakeFiles/hxwk.dir/Effects.cpp.o" "gcc" "CMakeFiles/hxwk.dir/Effects.cpp.o.d"
+  "/root/repo/FunctionCache.cpp" "CMakeFiles/hxwk.dir/FunctionCache.cpp.o" "gcc" "CMakeFiles/hxwk.dir/FunctionCache.cpp.o.d"
+  "/root/repo/IRGenerator.cpp" "CMakeFiles/hxwk.dir/IRGenerator.cpp.o" "gcc" "CMakeFiles/hxwk.dir/IRGenerator.cpp.o.d"
+  "/root/repo/Jit.cpp" "CMakeFiles/hxwk.dir/Jit.cpp.o" "gcc" "CMakeFiles/hxwk.dir/Jit.cpp.o.d"
+  "/root/repo/Lexer.cpp" "CMakeFiles/hxwk.dir/Lexer.cpp.o" "gcc" "CMakeFiles/hxwk.dir/Lexer.cpp.o.d"
+  "/root/repo/Optimizer.cpp" "CMakeFiles/hxwk.dir/Optimizer.cpp.o" "gcc" "CMakeFiles/hxwk.dir/Optimizer.cpp.o.d"
+  "/root/repo/ParallelCodegen.cpp" "CMakeFiles/hxwk.dir/ParallelCodegen.cpp.o" "gcc" "CMakeFiles/hxwk.dir/ParallelCodegen.cpp.o.d"
+  "/root/repo/Parser.cpp" "CMakeFiles/hxwk.dir/Parser.cpp.o" "gcc" "CMakeFiles/hxwk.dir/Parser.cpp.o.d"
+  "/root/repo/Sema.cpp" "CMakeFiles/hxwk.dir/Sema.cpp.o" "gcc" "CMakeFiles/hxwk.dir/Sema.cpp.o.d"
+  "/root/repo/SourceBuffer.cpp" "CMakeFiles/hxwk.dir/SourceBuffer.cpp.o" "gcc" "CMakeFiles/hxwk.dir/SourceBuffer.cpp.o.d"
+  "/root/repo/Target.cpp" "CMakeFiles/hxwk.dir/Target.cpp.o" "gcc" "CMakeFiles/hxwk.dir/Target.cpp.o.d"
+  "/root/repo/Type.cpp" "CMakeFiles/hxwk.dir/Type.cpp.o" "gcc" "CMakeFiles/hxwk.dir/Type.cpp.o.d"
+  "/root/repo/main.cpp" "CMakeFiles/hxwk.dir/main.cpp.o" "gcc" "CMakeFiles/hxwk.dir/main.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_bench_build/CMakeFiles/hxwk_rt.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,43 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/hxwk.dir/CharScan.cpp.o"
+  "CMakeFiles/hxwk.dir/CharScan.cpp.o.d"
+  "CMakeFiles/hxwk.dir/CharScanAVX2.cpp.o"
+  "CMakeFiles/hxwk.dir/CharScanAVX2.cpp.o.d"
+  "CMakeFiles/hxwk.dir/CompileCache.cpp.o"
+  "CMakeFiles/hxwk.dir/CompileCache.cpp.o.d"
+  "CMakeFiles/hxwk.dir/ConstFold.cpp.o"
+  "CMakeFiles/hxwk.dir/ConstFold.cpp.o.d"
+  "CMakeFiles/hxwk.dir/Effects.cpp.o"
+  "CMakeFiles/hxwk.dir/Effects.cpp.o.d"
+  "CMakeFiles/hxwk.dir/FunctionCache.cpp.o"
+  "CMakeFiles/hxwk.dir/FunctionCache.cpp.o.d"
+  "CMakeFiles/hxwk.dir/IRGenerator.cpp.o"
+  "CMakeFiles/hxwk.dir/IRGenerator.cpp.o.d"
+  "CMakeFiles/hxwk.dir/Jit.cpp.o"
+  "CMakeFiles/hxwk.dir/Jit.cpp.o.d"
+  "CMakeFiles/hxwk.dir/Lexer.cpp.o"
+  "CMakeFiles/hxwk.dir/Lexer.cpp.o.d"
+  "CMakeFiles/hxwk.dir/Optimizer.cpp.o"
+  "CMakeFiles/hxwk.dir/Optimizer.cpp.o.d"
+  "CMakeFiles/hxwk.dir/ParallelCodegen.cpp.o"
+  "CMakeFiles/hxwk.dir/ParallelCodegen.cpp.o.d"
+  "CMakeFiles/hxwk.dir/Parser.cpp.o"
+  "CMakeFiles/hxwk.dir/Parser.cpp.o.d"
+  "CMakeFiles/hxwk.dir/Sema.cpp.o"
+  "CMakeFiles/hxwk.dir/Sema.cpp.o.d"
+  "CMakeFiles/hxwk.dir/SourceBuffer.cpp.o"
+  "CMakeFiles/hxwk.dir/SourceBuffer.cpp.o.d"
+  "CMakeFiles/hxwk.dir/Target.cpp.o"
+  "CMakeFiles/hxwk.dir/Target.cpp.o.d"
+  "CMakeFiles/hxwk.dir/Type.cpp.o"
+  "CMakeFiles/hxwk.dir/Type.cpp.o.d"
+  "CMakeFiles/hxwk.dir/main.cpp.o"
+  "CMakeFiles/hxwk.dir/main.cpp.o.d"
+  "hxwk"
+  "hxwk.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/hxwk.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/hxwk_rt.dir/Runtime.cpp.o"
+  "CMakeFiles/hxwk_rt.dir/Runtime.cpp.o.d"
+  "libhxwk_rt.a"
+  "libhxwk_rt.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/hxwk_rt.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
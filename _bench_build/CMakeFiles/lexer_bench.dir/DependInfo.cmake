@@ -0,0 +1,23 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/CharScan.cpp" "CMakeFiles/lexer_bench.dir/CharScan.cpp.o" "gcc" "CMakeFiles/lexer_bench.dir/CharScan.cpp.o.d"
+  "/root/repo/CharScanAVX2.cpp" "CMakeFiles/lexer_bench.dir/CharScanAVX2.cpp.o" "gcc" "CMakeFiles/lexer_bench.dir/CharScanAVX2.cpp.o.d"
+  "/root/repo/Lexer.cpp" "CMakeFiles/lexer_bench.dir/Lexer.cpp.o" "gcc" "CMakeFiles/lexer_bench.dir/Lexer.cpp.o.d"
+  "/root/repo/SourceBuffer.cpp" "CMakeFiles/lexer_bench.dir/SourceBuffer.cpp.o" "gcc" "CMakeFiles/lexer_bench.dir/SourceBuffer.cpp.o.d"
+  "/root/repo/bench/LexerBench.cpp" "CMakeFiles/lexer_bench.dir/bench/LexerBench.cpp.o" "gcc" "CMakeFiles/lexer_bench.dir/bench/LexerBench.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
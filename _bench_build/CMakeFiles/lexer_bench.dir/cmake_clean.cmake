@@ -0,0 +1,19 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/lexer_bench.dir/CharScan.cpp.o"
+  "CMakeFiles/lexer_bench.dir/CharScan.cpp.o.d"
+  "CMakeFiles/lexer_bench.dir/CharScanAVX2.cpp.o"
+  "CMakeFiles/lexer_bench.dir/CharScanAVX2.cpp.o.d"
+  "CMakeFiles/lexer_bench.dir/Lexer.cpp.o"
+  "CMakeFiles/lexer_bench.dir/Lexer.cpp.o.d"
+  "CMakeFiles/lexer_bench.dir/SourceBuffer.cpp.o"
+  "CMakeFiles/lexer_bench.dir/SourceBuffer.cpp.o.d"
+  "CMakeFiles/lexer_bench.dir/bench/LexerBench.cpp.o"
+  "CMakeFiles/lexer_bench.dir/bench/LexerBench.cpp.o.d"
+  "lexer_bench"
+  "lexer_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/lexer_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/runtime_bench.dir/bench/RuntimeBench.cpp.o"
+  "CMakeFiles/runtime_bench.dir/bench/RuntimeBench.cpp.o.d"
+  "runtime_bench"
+  "runtime_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/runtime_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/scope_bench.dir/bench/ScopeBench.cpp.o"
+  "CMakeFiles/scope_bench.dir/bench/ScopeBench.cpp.o.d"
+  "scope_bench"
+  "scope_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/scope_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
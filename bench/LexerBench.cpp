@@ -0,0 +1,128 @@
+// Measures raw lexing throughput over a synthetic, machine-generated looking
+// source file, followed by the throughput of each available CharScanner
+// kernel on long runs of its character class. Build with
+// -DHXWK_BUILD_BENCHMARKS=ON and run `lexer_bench [MiB] [repetitions]`.
+
+#include "CharScan.hpp"
+#include "Lexer.hpp"
+#include "SourceBuffer.hpp"
+#include "StringInterner.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static std::string generate_source(std::size_t min_size) {
+    std::string src;
+    std::size_t n = 0;
+    while (src.size() < min_size) {
+        auto i = std::to_string(n++);
+        src += "// Generated function number " + i + "\n"
+               "fn generatedFunction" + i + "(argumentNumberOne: i32, "
+               "argumentNumberTwo: double) -> bool {\n"
+               "    let temporaryValue" + i + " = argumentNumberOne * "
+               + i + " + 42;\n"
+               "    let other = if temporaryValue" + i + " < 1000 {\n"
+               "        argumentNumberTwo / 3.25\n"
+               "    } else {\n"
+               "        printf(\"value %d\\n\", temporaryValue" + i + ");\n"
+               "        0.5\n"
+               "    };\n"
+               "    other - 1.0 < argumentNumberTwo\n"
+               "}\n\n";
+    }
+    return src;
+}
+
+template <typename F>
+static double best_time(int reps, F f) {
+    double best = 0;
+    for (int rep = 0; rep < reps; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> time
+                = std::chrono::steady_clock::now() - start;
+        if (best == 0 || time.count() < best)
+            best = time.count();
+    }
+    return best;
+}
+
+static void bench_kernels(const CharScanner &scanner, int reps) {
+    struct Run {
+        const char *name;
+        char c;
+        CharScanner::Kernel CharScanner::*kernel;
+    };
+    const Run runs[] = {{"space", ' ', &CharScanner::skip_space},
+                        {"alnum", 'x', &CharScanner::skip_alnum},
+                        {"digits", '7', &CharScanner::skip_digits}};
+
+    // Many runs of a few KiB each, like banners and generated names
+    constexpr std::size_t run_len = 4093, n_runs = 1 << 14;
+    for (const auto &run : runs) {
+        std::string text;
+        for (std::size_t i = 0; i < n_runs; ++i)
+            text += std::string(run_len, run.c) + ';';
+
+        std::size_t skipped = 0;
+        double time = best_time(reps, [&] {
+            skipped = 0;
+            const char *p = text.data(), *end = p + text.size();
+            while (p != end) {
+                const char *q = (scanner.*run.kernel)(p, end);
+                skipped += q - p;
+                p = q + 1;
+            }
+        });
+
+        if (skipped != run_len * n_runs)
+            std::cerr << "Kernel " << scanner.name << '/' << run.name
+                      << " skipped " << skipped << " characters\n";
+        std::cout << "  " << scanner.name << '/' << run.name << ": "
+                  << text.size() / time / 1e9 << " GB/s\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    const std::size_t mib = argc > 1 ? std::atoi(argv[1]) : 64;
+    const int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    SourceBuffer src{generate_source(mib << 20)};
+
+    double best = 0;
+    std::size_t tokens = 0;
+    for (int rep = 0; rep < reps; ++rep) {
+        StringInterner interner;
+        tokens = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        Lexer lex{src, interner};
+        while (lex.get_tok() != Tok::END) {
+            if (lex.get_tok() == Tok::INVALID) {
+                std::cerr << "Lexing failed\n";
+                return 1;
+            }
+            ++tokens;
+            lex.get_next_tok();
+        }
+        std::chrono::duration<double> time
+                = std::chrono::steady_clock::now() - start;
+
+        if (best == 0 || time.count() < best)
+            best = time.count();
+    }
+
+    std::cout << src.size() / double(1 << 20) << " MiB, " << tokens
+              << " tokens, best of " << reps << ": " << best * 1e3
+              << " ms\n"
+              << tokens / best / 1e6 << " Mtokens/s, "
+              << src.size() / best / 1e9 << " GB/s\n";
+
+    std::cout << "Kernels (lexer uses " << CharScanner::best().name << "):\n";
+    bench_kernels(CharScanner::scalar(), reps);
+    if (CharScanner::sse2())
+        bench_kernels(*CharScanner::sse2(), reps);
+    if (CharScanner::avx2())
+        bench_kernels(*CharScanner::avx2(), reps);
+}
@@ -0,0 +1,153 @@
+// Measures how the runtime's work-stealing pool scales from 1 to N workers,
+// on the two shapes compiled programs hand it: fork/join recursion through
+// `hxwk_spawn`/`hxwk_await`, lowered like `spawn` and `await`, and a `par
+// for` reduction through `hxwk_par_for`. Since the pool is sized once per
+// process, each number of workers runs in a child process of its own.
+// Build with -DHXWK_BUILD_BENCHMARKS=ON and run
+// `runtime_bench [max workers] [repetitions]`.
+
+#include "Runtime.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+// The frame of a spawned call as IRGenerator lays it out: the task, the
+// result and the arguments
+struct FibFrame {
+    alignas(int64_t) char task[hxwk_task_size];
+    int64_t result;
+    int32_t n;
+};
+
+constexpr int32_t fib_n = 32;
+// Below, calls run serially like in a program spawning only above a cutoff
+constexpr int32_t fib_cutoff = 16;
+
+int64_t fib_serial(int32_t n) {
+    return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+int64_t fib(int32_t n);
+int64_t par_fib() { return fib(fib_n); }
+
+void fib_thunk(void *frame) {
+    auto &fib_frame = *static_cast<FibFrame *>(frame);
+    fib_frame.result = fib(fib_frame.n);
+}
+
+int64_t fib(int32_t n) {
+    if (n < fib_cutoff)
+        return fib_serial(n);
+    FibFrame frame;
+    frame.n = n - 1;
+    hxwk_spawn(&frame, fib_thunk);
+    const auto rhs = fib(n - 2);
+    hxwk_await(&frame);
+    return frame.result + rhs;
+}
+
+constexpr int64_t loop_length = 1 << 24;
+
+// Sums a hash of each index, which does not vectorise away
+void loop_body(void *, int64_t lo, int64_t hi, void *acc) {
+    uint64_t sum = 0;
+    for (int64_t i = lo; i < hi; ++i) {
+        uint64_t x = static_cast<uint64_t>(i) * 0x9e3779b97f4a7c15u;
+        x ^= x >> 29;
+        sum += x * 0xbf58476d1ce4e5b9u >> 32;
+    }
+    *static_cast<uint64_t *>(acc) += sum;
+}
+
+void loop_combine(void *into, const void *from) {
+    *static_cast<uint64_t *>(into) += *static_cast<const uint64_t *>(from);
+}
+
+uint64_t par_loop() {
+    uint64_t acc = 0;
+    hxwk_par_for(0, loop_length, 0, loop_body, nullptr, &acc, sizeof(acc),
+                 loop_combine);
+    return acc;
+}
+
+template <typename Fn>
+double measure(Fn fn, int reps, decltype(fn()) expected) {
+    double best = 0;
+    for (int rep = 0; rep < reps; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        auto result = fn();
+        std::chrono::duration<double> time
+                = std::chrono::steady_clock::now() - start;
+
+        if (result != expected)
+            std::cerr << "Unexpected result\n";
+        if (best == 0 || time.count() < best)
+            best = time.count();
+    }
+    return best;
+}
+
+struct Times {
+    double fib, loop;
+};
+
+// Runs both workloads on a pool of `workers` in a child process, which
+// reports its times through a pipe
+bool run_child(unsigned workers, int reps, Times &times) {
+    int fds[2];
+    if (pipe(fds) != 0)
+        return false;
+
+    const pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0) {
+        close(fds[0]);
+        setenv("HXWK_THREADS", std::to_string(workers).c_str(), 1);
+        uint64_t expected_loop = 0;
+        loop_body(nullptr, 0, loop_length, &expected_loop);
+        const Times child{measure(par_fib, reps, fib_serial(fib_n)),
+                          measure(par_loop, reps, expected_loop)};
+        const bool ok = write(fds[1], &child, sizeof(child)) == sizeof(child);
+        _exit(ok ? 0 : 1);
+    }
+
+    close(fds[1]);
+    const bool ok = read(fds[0], &times, sizeof(times)) == sizeof(times);
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+}
+
+int main(int argc, char **argv) {
+    const unsigned hardware = std::thread::hardware_concurrency();
+    const unsigned max_workers = argc > 1 ? std::atoi(argv[1])
+                                          : hardware ? hardware : 1;
+    const int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    std::cout << "workers  fib(" << fib_n << ") [ms]  speedup  par for [ms]"
+              << "  speedup\n";
+    Times serial{0, 0};
+    for (unsigned workers = 1; workers <= max_workers; ++workers) {
+        Times times;
+        if (!run_child(workers, reps, times)) {
+            std::cerr << "Benchmark with " << workers << " workers failed\n";
+            return 1;
+        }
+        if (workers == 1)
+            serial = times;
+        std::cout << workers << "  " << times.fib * 1e3 << "  "
+                  << serial.fib / times.fib << "  " << times.loop * 1e3
+                  << "  " << serial.loop / times.loop << '\n';
+    }
+}
@@ -0,0 +1,111 @@
+// Compares IdScoper with the std::map-per-scope table it replaced on deeply
+// nested generated scopes, as produced by nested `ScopeExpr`/`IfExpr`s. Each
+// scope binds a few fresh names, shadows an outer one and then looks up
+// names from the innermost and outermost scopes as well as unbound ones.
+// Build with -DHXWK_BUILD_BENCHMARKS=ON and run `scope_bench [repetitions]`.
+
+#include "IdScoper.hpp"
+#include "StringInterner.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Value {
+    const void *val;
+};
+
+// The previous implementation, kept for reference
+class MapScoper {
+  public:
+    using value_t = Value;
+    void enter() { named_values.emplace_back(); }
+    void exit() { named_values.pop_back(); }
+    value_t operator[](Symbol id) {
+        for (auto i = named_values.rbegin(); i != named_values.rend(); ++i) {
+            value_t &val = i->operator[](id);
+            if (val.val != nullptr)
+                return val;
+        }
+        return value_t{};
+    }
+    value_t &current_scope(Symbol id) { return named_values.back()[id]; }
+
+  private:
+    std::vector<std::map<Symbol, value_t>> named_values;
+};
+
+constexpr int names_per_scope = 4;
+constexpr int lookups_per_scope = 16;
+
+template <typename Scoper>
+std::size_t run(Scoper &scoper, const std::vector<Symbol> &syms, int depth) {
+    static const int dummy = 0;
+    std::size_t found = 0;
+
+    scoper.enter();
+    scoper.current_scope(syms[0]) = {&dummy};
+
+    for (int d = 1; d <= depth; ++d) {
+        scoper.enter();
+        for (int n = 0; n < names_per_scope; ++n)
+            scoper.current_scope(syms[d * names_per_scope + n]) = {&dummy};
+        scoper.current_scope(syms[0]) = {&dummy};
+
+        for (int l = 0; l < lookups_per_scope; ++l) {
+            // Innermost, outermost and never bound names
+            auto inner = syms[d * names_per_scope + l % names_per_scope];
+            found += scoper[inner].val != nullptr;
+            found += scoper[syms[0]].val != nullptr;
+            found += scoper[syms[syms.size() - 1 - l]].val != nullptr;
+        }
+    }
+
+    for (int d = 0; d <= depth; ++d)
+        scoper.exit();
+    return found;
+}
+
+template <typename Scoper>
+double measure(const std::vector<Symbol> &syms, int depth, int reps) {
+    double best = 0;
+    for (int rep = 0; rep < reps; ++rep) {
+        Scoper scoper;
+        auto start = std::chrono::steady_clock::now();
+        auto found = run(scoper, syms, depth);
+        std::chrono::duration<double> time
+                = std::chrono::steady_clock::now() - start;
+
+        if (found != 2u * lookups_per_scope * depth)
+            std::cerr << "Unexpected lookup results\n";
+        if (best == 0 || time.count() < best)
+            best = time.count();
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char **argv) {
+    const int reps = argc > 1 ? std::atoi(argv[1]) : 5;
+    const int depths[] = {1, 8, 64, 512, 4096};
+
+    StringInterner interner;
+    std::vector<Symbol> syms;
+    for (int i = 0; i < (depths[4] + 1) * names_per_scope + lookups_per_scope;
+         ++i)
+        syms.push_back(interner.intern("name" + std::to_string(i)));
+
+    std::cout << "depth  std::map [ns/lookup]  IdScoper [ns/lookup]\n";
+    for (int depth : depths) {
+        const double lookups = 3.0 * lookups_per_scope * depth;
+        auto map_time = measure<MapScoper>(syms, depth, reps);
+        auto flat_time = measure<IdScoper<Value>>(syms, depth, reps);
+        std::cout << depth << "  " << map_time / lookups * 1e9 << "  "
+                  << flat_time / lookups * 1e9 << '\n';
+    }
+}
@@ -0,0 +1,22 @@
+fn reduce(x: u32) -> u32 {
+    x - x / 65521 as u32 * 65521 as u32
+}
+
+fn adler32(data: [u8]) -> u32 {
+    let mut a = 1 as u32;
+    let mut b = 0 as u32;
+    for i in 0..len(data) {
+        a = reduce(a + data[i]);
+        b = reduce(b + a);
+    };
+    b * 65536 as u32 + a
+}
+
+fn main() -> void {
+    let text = [87, 105, 107, 105, 112, 101, 100, 105, 97];
+    let mut data = [0 as u8; 9];
+    for i in 0..len(text) {
+        data[i] = text[i] as u8;
+    };
+    printf("%u\n", adler32(data));
+}
@@ -0,0 +1,28 @@
+fn dot(x: [f32], y: [f32]) -> f32 {
+    let mut acc = splat(0 as f32);
+    let lanes = len(acc);
+    let mut i = 0;
+    while i + lanes < len(x) + 1 {
+        acc = acc + load(x, i) * load(y, i);
+        i = i + lanes;
+    };
+    let mut sum = hsum(acc);
+    while i < len(x) {
+        sum = sum + x[i] * y[i];
+        i = i + 1;
+    };
+    sum
+}
+
+fn main() -> void {
+    let n = 1003;
+    let x = new [f32; n];
+    let y = new [f32; n];
+    for i in 0..n {
+        x[i] = i as f32;
+        y[i] = (i - i / 4 * 4) as f32;
+    };
+    printf("%.1f\n", dot(x, y) as double);
+    free(x);
+    free(y);
+}
@@ -0,0 +1,20 @@
+fn fib(n: i32) -> i64 {
+    if n < 2 { n as i64 } else { fib(n - 1) + fib(n - 2) }
+}
+
+// Spawns the larger half while the smaller one runs on this worker, small
+// calls are not worth a task of their own
+fn pfib(n: i32) -> i64 {
+    if n < 20 {
+        fib(n)
+    } else {
+        let lhs = spawn pfib(n - 1);
+        let rhs = pfib(n - 2);
+        await lhs + rhs
+    }
+}
+
+fn main() -> void {
+    let n = 35;
+    printf("fib(%d) = %ld\n", n, pfib(n));
+}
@@ -0,0 +1,10 @@
+fn main() -> void {
+    let n = 10000000;
+    let step = 1.0 / n as double;
+    let mut sum = 0.0;
+    par for i in 0..n reduce(+) sum {
+        let x = (i as double + 0.5) * step;
+        sum = sum + 4.0 / (1.0 + x * x);
+    };
+    printf("%.9f\n", sum * step);
+}
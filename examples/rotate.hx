@@ -0,0 +1,13 @@
+// Rotates the lanes of `v` by one, `n` times. The call is in tail position,
+// so the recursion runs in constant stack space even at -O0.
+fn rotate(v: vec<i32, 4>, n: i32) -> vec<i32, 4> {
+    if n < 1 { v } else { rotate(shuffle(v, [1, 2, 3, 0]), n - 1) }
+}
+
+// Prints 1 2 3 0
+fn main() -> void {
+    let v = insert(insert(insert(0 as vec<i32, 4>, 1, 1), 2, 2), 3, 3);
+    let r = rotate(v, 1000001);
+    printf("%d %d %d %d\n", extract(r, 0), extract(r, 1), extract(r, 2),
+           extract(r, 3));
+}
@@ -0,0 +1,22 @@
+fn sieve(composite: [bool]) -> void {
+    for n in 2..len(composite) {
+        if composite[n] {} else {
+            let mut multiple = n * n;
+            while multiple < len(composite) {
+                composite[multiple] = 0 < 1;
+                multiple = multiple + n;
+            };
+        }
+    }
+}
+
+fn main() -> void {
+    let composite = new [bool; 100];
+    sieve(composite);
+    for n in 2..len(composite) {
+        if composite[n] {} else {
+            printf("%d ist prim.\n", n);
+        }
+    };
+    free(composite);
+}
@@ -0,0 +1,34 @@
+fn sum(s: [i32]) -> i32 {
+    let mut t = 0;
+    for i in 0..len(s) {
+        t = t + s[i];
+    };
+    t
+}
+
+// The array lives in this function's frame, which the call in tail position
+// must not reuse
+fn sevens() -> i32 {
+    let a = [7; 1000];
+    sum(a)
+}
+
+// Each step reverses the previous step's array into a new one, which a jump
+// back to the entry would overwrite while reading it
+fn steps(s: [i32], n: i32) -> i32 {
+    if n < 1 {
+        s[0] * 1000 + s[1] * 100 + s[2] * 10 + s[3]
+    } else {
+        let mut a = [0; 4];
+        for i in 0..4 {
+            a[i] = s[3 - i] + i;
+        };
+        steps(a, n - 1)
+    }
+}
+
+// Prints 7000 and 7777
+fn main() -> void {
+    printf("%d\n", sevens());
+    printf("%d\n", steps([1, 2, 3, 4], 3));
+}
@@ -1,47 +1,589 @@
 #include "AST.hpp"
+#include "Arena.hpp"
+#include "CompileCache.hpp"
+#include "ConstFold.hpp"
+#include "Effects.hpp"
+#include "FunctionCache.hpp"
 #include "IRGenerator.hpp"
+#include "Jit.hpp"
 #include "Lexer.hpp"
+#include "Log.hpp"
+#include "Optimizer.hpp"
+#include "ParallelCodegen.hpp"
 #include "Parser.hpp"
+#include "Sema.hpp"
+#include "SourceBuffer.hpp"
+#include "StringInterner.hpp"
+#include "Target.hpp"
+#include "Type.hpp"
 #include "VisitorPattern.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Target/TargetMachine.h"
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
+
+enum class EmitKind { LLVM, BITCODE, ASSEMBLY, OBJECT, EXECUTABLE };
 
 static void show_usage(std::string name) {
-    std::cerr << "Usage: " << name << " [option(s)] VALUES\n"
+    std::cerr << "Usage: " << name << " [option(s)] [FILE]\n"
+              << "Reads from standard input if FILE is omitted or `-`.\n"
               << "Options:\n"
-              << "\t-h, --help\t\tShow this help message\n";
+              << "\t-h, --help\t\tShow this help message\n"
+              << "\t-O0, -O1, -O2, -O3\tOptimisation level (default: -O0)\n"
+              << "\t-o FILE\t\t\tOutput file (default: out.ll)\n"
+              << "\t--emit=KIND\t\tOne of llvm, bc, asm, obj or exe "
+                 "(default:\n\t\t\t\tguessed from the output file's "
+                 "extension)\n"
+              << "\t-march=ARCH\t\tTarget architecture, e.g. x86-64 or "
+                 "native\n"
+              << "\t-mcpu=CPU\t\tTarget CPU, e.g. skylake or native\n"
+              << "\t--run\t\t\tCompile for the host in memory and run "
+                 "`main`,\n\t\t\t\treporting compile and run times on "
+                 "stderr\n"
+              << "\t--lazy\t\t\tLike --run, but only compile functions "
+                 "when\n\t\t\t\tthey are first called, which counts as "
+                 "run time\n"
+              << "\t--cache\t\t\tReuse output of earlier runs from the "
+                 "default\n\t\t\t\tcache directory\n"
+              << "\t--cache-dir=DIR\t\tLike --cache, but use DIR\n"
+              << "\t--cache-size=MB\t\tLimit the cache's size "
+                 "(default: 512)\n"
+              << "\t--cache-stats\t\tPrint cache hits and misses on "
+                 "stderr\n"
+              << "\t--incremental\t\tCache each function on its own, "
+                 "only for\n\t\t\t\texecutables and --run\n"
+              << "\t--jobs=N\t\tCompile functions on N threads, 0 for "
+                 "one per\n\t\t\t\tcore (default: 1)\n"
+              << "\t--report-tail-calls\tNote tail calls which cannot be "
+                 "turned into\n\t\t\t\tjumps\n"
+              << "\t--unchecked\t\tLeave out bounds checks, indexing out "
+                 "of\n\t\t\t\tbounds is undefined behaviour\n"
+              << "Compiled programs run `par for` loops and spawned calls "
+                 "on one thread\nper core, or on as many as HXWK_THREADS "
+                 "says. Object files and\nassembly need to be linked with "
+                 "libhxwk_rt.a from the compiler's\ndirectory.\n";
+}
+
+static bool parse_emit_kind(llvm::StringRef name, EmitKind &kind) {
+    if (name == "llvm" || name == "ll") {
+        kind = EmitKind::LLVM;
+    } else if (name == "bc") {
+        kind = EmitKind::BITCODE;
+    } else if (name == "asm" || name == "s") {
+        kind = EmitKind::ASSEMBLY;
+    } else if (name == "obj" || name == "o") {
+        kind = EmitKind::OBJECT;
+    } else if (name == "exe") {
+        kind = EmitKind::EXECUTABLE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char *default_output(EmitKind kind) {
+    switch (kind) {
+        case EmitKind::LLVM:
+            return "out.ll";
+        case EmitKind::BITCODE:
+            return "out.bc";
+        case EmitKind::ASSEMBLY:
+            return "out.s";
+        case EmitKind::OBJECT:
+            return "out.o";
+        default:
+            return "a.out";
+    }
+}
+
+// The runtime library is built next to the compiler
+static std::string find_runtime(const char *argv0) {
+    static int anchor;
+    llvm::SmallString<128> path{llvm::sys::path::parent_path(
+            llvm::sys::fs::getMainExecutable(argv0, &anchor))};
+    llvm::sys::path::append(path, "libhxwk_rt.a");
+    return path.str().str();
+}
+
+// Links object files given in memory with the system's C compiler driver,
+// which knows where to find the C library and start files. The runtime is
+// written in C++ and runs threads.
+static bool link_executable(llvm::ArrayRef<llvm::StringRef> objects,
+                            llvm::StringRef output_path,
+                            const std::string &runtime_path) {
+    auto cc = llvm::sys::findProgramByName("cc");
+    if (!cc)
+        return Log::error_val<bool>("Cannot find `cc` to link with");
+    if (!llvm::sys::fs::exists(runtime_path))
+        return Log::error_val<bool>("Cannot find the runtime library `",
+                                    runtime_path, "`");
+
+    std::vector<std::string> object_paths;
+    bool ok = true;
+    for (auto contents : objects) {
+        llvm::SmallString<128> object_path;
+        if (llvm::sys::fs::createTemporaryFile("hxwk", "o", object_path)) {
+            ok = Log::error_val<bool>("Cannot create temporary file");
+            break;
+        }
+        object_paths.push_back(object_path.str().str());
+
+        std::ofstream object{object_path.c_str(), std::ios_base::binary};
+        if (object.write(contents.data(), contents.size()).fail()) {
+            ok = Log::error_val<bool>("Cannot write `",
+                                      object_path.str().str(), "`");
+            break;
+        }
+    }
+
+    if (ok) {
+        std::vector<llvm::StringRef> args{*cc};
+        args.insert(args.end(), object_paths.begin(), object_paths.end());
+        args.push_back(runtime_path);
+        args.push_back("-lstdc++");
+        args.push_back("-pthread");
+        args.push_back("-o");
+        args.push_back(output_path);
+
+        std::string error;
+        if (llvm::sys::ExecuteAndWait(*cc, args, llvm::None, {}, 0, 0, &error)
+            != 0)
+            ok = Log::error_val<bool>("Linking failed",
+                                      error.empty() ? "" : ": ", error);
+    }
+
+    for (const auto &object_path : object_paths)
+        llvm::sys::fs::remove(object_path);
+    return ok;
+}
+
+// Generates the output file's contents, executables are produced as object
+// code to be linked.
+static bool generate(IRGenerator &gen, llvm::TargetMachine &tm, EmitKind kind,
+                     std::string &contents) {
+    std::ostringstream out;
+    bool ok = true;
+    switch (kind) {
+        case EmitKind::LLVM:
+            gen.write_assembly(out);
+            break;
+        case EmitKind::BITCODE:
+            gen.write_bitcode(out);
+            break;
+        case EmitKind::ASSEMBLY:
+            ok = gen.write_native_assembly(out, tm);
+            break;
+        default:
+            ok = gen.write_object(out, tm);
+            break;
+    }
+    contents = out.str();
+    return ok;
+}
+
+static bool write_output(EmitKind kind, llvm::StringRef contents,
+                         const std::string &output_path,
+                         const std::string &runtime_path) {
+    if (kind == EmitKind::EXECUTABLE)
+        return link_executable(contents, output_path, runtime_path);
+
+    std::ofstream out_file{output_path, std::ios_base::binary};
+    if (out_file.write(contents.data(), contents.size()).fail())
+        return Log::error_val<bool>("Cannot write `", output_path, "`");
+    return true;
+}
+
+// Everything but the source that the compiler's output depends on
+static std::string describe_target(llvm::TargetMachine &tm,
+                                   unsigned opt_level, bool unchecked) {
+    return tm.getTargetTriple().getTriple() + ' ' + tm.getTargetCPU().str()
+           + ' ' + tm.getTargetFeatureString().str() + " -O"
+           + std::to_string(opt_level) + (unchecked ? " --unchecked" : "");
+}
+
+// Links a module in bitcode into `module`
+static bool link_bitcode(llvm::Module &module, llvm::MemoryBuffer &bitcode) {
+    auto linked = llvm::parseBitcodeFile(bitcode.getMemBufferRef(),
+                                         module.getContext());
+    if (!linked)
+        return Log::error_val<bool>("Cannot read bitcode: ",
+                                    llvm::toString(linked.takeError()));
+    if (llvm::Linker::linkModules(module, std::move(*linked)))
+        return Log::error_val<bool>("Cannot link modules");
+    return true;
+}
+
+static void finish_cache(CompileCache &cache, bool print_stats) {
+    cache.evict();
+    if (print_stats)
+        cache.print_stats();
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+}
+
+// `main` has to take no arguments and return either nothing or an exit code
+static bool check_main(llvm::Module &module, bool &returns_code) {
+    auto *main_fn = module.getFunction("main");
+    if (!main_fn || !main_fn->arg_empty())
+        return Log::error_val<bool>("Expected function `main` without "
+                                    "parameters");
+    returns_code = main_fn->getReturnType()->isIntegerTy(32);
+    if (!returns_code && !main_fn->getReturnType()->isVoidTy())
+        return Log::error_val<bool>("Expected `main` to return i32 or void");
+    return true;
+}
+
+// Hands the module over to the JIT and calls its `main`. If `objects` hold
+// the module's object code, they are run instead and the module stays with
+// `gen` and `context`.
+static int run(Jit &jit, IRGenerator &gen,
+               std::unique_ptr<llvm::LLVMContext> &context,
+               std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects,
+               bool returns_code, Clock::time_point compile_start) {
+    if (objects.empty()
+        && !jit.add_module(gen.take_module(), std::move(context)))
+        return 1;
+    for (auto &object : objects) {
+        if (!jit.add_object(std::move(object)))
+            return 1;
+    }
+    auto *addr = jit.lookup("main");
+    if (!addr)
+        return 1;
+    double compile_ms = milliseconds_since(compile_start);
+
+    int exit_code = 0;
+    auto run_start = Clock::now();
+    if (returns_code)
+        exit_code = reinterpret_cast<int32_t (*)()>(addr)();
+    else
+        reinterpret_cast<void (*)()>(addr)();
+    double run_ms = milliseconds_since(run_start);
+
+    // The program writes through the C library's buffer
+    std::fflush(stdout);
+    std::cerr << "compile: " << compile_ms << " ms, run: " << run_ms
+              << " ms\n";
+    return exit_code;
 }
 
 int main(int argc, char** argv) {
+    std::string input_path{"-"};
+    std::string output_path;
+    bool emit_given = false;
+    EmitKind emit_kind = EmitKind::LLVM;
+    TargetSpec target_spec;
+    bool run_jit = false;
+    bool lazy_jit = false;
+    std::string cache_dir;
+    uint64_t cache_size = 512;
+    bool cache_stats = false;
+    bool incremental = false;
+    unsigned jobs = 1;
+    bool report_tail_calls = false;
+    bool unchecked = false;
+
     for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
+        llvm::StringRef arg = argv[i];
         if ((arg == "-h") || (arg == "--help")) {
             show_usage(argv[0]);
             return 1;
+        } else if (arg.size() == 3 && arg.startswith("-O") && arg[2] >= '0'
+                   && arg[2] <= '3') {
+            target_spec.opt_level = arg[2] - '0';
+        } else if (arg == "-o") {
+            if (++i == argc)
+                return Log::error_val<int, 1>("Missing file name after -o");
+            output_path = argv[i];
+        } else if (arg.consume_front("--emit=")) {
+            if (!parse_emit_kind(arg, emit_kind))
+                return Log::error_val<int, 1>("Unknown output kind `",
+                                              arg.str(), "`");
+            emit_given = true;
+        } else if (arg.consume_front("-march=")) {
+            target_spec.arch = arg.str();
+        } else if (arg.consume_front("-mcpu=")) {
+            target_spec.cpu = arg.str();
+        } else if (arg == "--run") {
+            run_jit = true;
+        } else if (arg == "--lazy") {
+            run_jit = lazy_jit = true;
+        } else if (arg == "--cache") {
+            cache_dir = CompileCache::default_dir();
+        } else if (arg.consume_front("--cache-dir=")) {
+            cache_dir = arg.str();
+        } else if (arg.consume_front("--cache-size=")) {
+            if (arg.getAsInteger(10, cache_size))
+                return Log::error_val<int, 1>("Invalid cache size `",
+                                              arg.str(), "`");
+        } else if (arg == "--cache-stats") {
+            cache_stats = true;
+        } else if (arg == "--incremental") {
+            incremental = true;
+        } else if (arg.consume_front("--jobs=")) {
+            if (arg.getAsInteger(10, jobs))
+                return Log::error_val<int, 1>("Invalid number of jobs `",
+                                              arg.str(), "`");
+            if (jobs == 0)
+                jobs = llvm::hardware_concurrency().compute_thread_count();
+        } else if (arg == "--report-tail-calls") {
+            report_tail_calls = true;
+        } else if (arg == "--unchecked") {
+            unchecked = true;
+        } else if (arg.startswith("-") && arg != "-") {
+            show_usage(argv[0]);
+            return Log::error_val<int, 1>("Unknown option `", arg.str(), "`");
+        } else {
+            input_path = arg.str();
         }
     }
 
-    Parser par{Lexer{}};
-    IRGenerator gen{"Hexenwerk"};
-    IRStatementVis vis_code{gen};
+    if (run_jit
+        && (emit_given || !output_path.empty() || !target_spec.arch.empty()
+            || !target_spec.cpu.empty()))
+        return Log::error_val<int, 1>("--run and --lazy always compile for "
+                                      "the host and cannot be combined "
+                                      "with -o, --emit, -march or -mcpu");
 
-    while (std::unique_ptr<Statement> ast = par.parse()) {
-        ast->accept(vis_code);
-        if (vis_code.get_val() == nullptr) {
-            break;
+    if (!emit_given && !output_path.empty()) {
+        auto dot = output_path.rfind('.');
+        if (dot == std::string::npos
+            || !parse_emit_kind(llvm::StringRef{output_path}.substr(dot + 1),
+                                emit_kind))
+            emit_kind = EmitKind::EXECUTABLE;
+    }
+    if (output_path.empty())
+        output_path = default_output(emit_kind);
+    const auto runtime_path = find_runtime(argv[0]);
+
+    if (incremental
+        && (lazy_jit || (!run_jit && emit_kind != EmitKind::EXECUTABLE)))
+        return Log::error_val<int, 1>("--incremental only applies to "
+                                      "executables and --run");
+    if (incremental && cache_dir.empty())
+        cache_dir = CompileCache::default_dir();
+    if (jobs > 1 && (lazy_jit || incremental))
+        return Log::error_val<int, 1>("--jobs cannot be combined with "
+                                      "--lazy or --incremental");
+    // Executables and the JIT can take one object per worker, anything else
+    // is linked into a single module first
+    bool split_objects
+            = jobs > 1 && (run_jit || emit_kind == EmitKind::EXECUTABLE);
+
+    auto compile_start = Clock::now();
+
+    std::unique_ptr<CompileCache> cache;
+    if (!cache_dir.empty()) {
+        cache = CompileCache::open(cache_dir, cache_size << 20);
+        if (!cache)
+            return 1;
+    }
+
+    std::unique_ptr<Jit> jit;
+    std::unique_ptr<llvm::TargetMachine> tm;
+    if (run_jit)
+        jit = Jit::create(target_spec.opt_level, lazy_jit, cache.get());
+    else
+        tm = create_target_machine(target_spec);
+    if (!jit && !tm)
+        return 1;
+    auto &target = run_jit ? jit->get_target_machine() : *tm;
+
+    auto src = input_path == "-" ? SourceBuffer::from_stdin()
+                                 : SourceBuffer::from_file(input_path);
+    if (!src)
+        return 1;
+
+    // Executables are cached as object code, linking them again is cheap.
+    // The JIT files objects by module identifier, a lazy JIT compiles one
+    // module per function.
+    const char *output_name = run_jit ? (lazy_jit ? "jit-lazy" : "jit")
+                              : emit_kind == EmitKind::EXECUTABLE
+                                      ? "o"
+                                      : default_output(emit_kind);
+    std::string key = CompileCache::make_key(
+            {llvm::StringRef{src->begin(), src->size()}, output_name,
+             describe_target(target, target_spec.opt_level, unchecked)});
+    // Incremental compilation replaces caching the file as a whole, split
+    // objects cannot be stored as a single file.
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects;
+    if (cache && !lazy_jit && !incremental && !split_objects) {
+        if (auto cached = cache->lookup(
+                    run_jit ? CompileCache::get_object_key(key) : key))
+            objects.push_back(std::move(cached));
+    }
+    bool cached = !objects.empty();
+
+    if (cached && !run_jit) {
+        bool ok = write_output(emit_kind, objects[0]->getBuffer(),
+                               output_path, runtime_path);
+        finish_cache(*cache, cache_stats);
+        return ok ? 0 : 1;
+    }
+
+    std::unique_ptr<FunctionCache> fn_cache;
+    if (incremental)
+        fn_cache = std::make_unique<FunctionCache>(
+                *cache,
+                describe_target(target, target_spec.opt_level, unchecked));
+
+    StringInterner interner;
+    TypeContext types;
+    // `vec<T>` fills a vector register of the target
+    types.set_native_vector_bits(get_native_vector_bits(target));
+    Arena ast_arena;
+    Parser par{Lexer{*src, interner}, ast_arena, types};
+    auto context = std::make_unique<llvm::LLVMContext>();
+    IRGenerator gen{*context, "Hexenwerk", interner};
+    gen.get_module().setModuleIdentifier(key);
+    gen.set_target(target);
+    gen.set_report_tail_calls(report_tail_calls);
+    gen.set_bounds_checks(!unchecked);
+    Optimizer optimizer{target_spec.opt_level, &target};
+    // The lazy JIT leaves optimisation until a function is actually called.
+    // With cached object code, the module is only needed to find `main`.
+    // Incremental compilation needs to see functions before they are
+    // optimised.
+    if (lazy_jit)
+        jit->set_optimizer(&optimizer);
+    else if (!cached && !incremental)
+        gen.set_optimizer(&optimizer);
+
+    // Sema needs the whole file, so that functions can be called before
+    // they are defined
+    llvm::SHA1 digest;
+    llvm::DenseMap<const Statement *, std::string> digests;
+    if (fn_cache)
+        par.set_digest(&digest);
+    std::vector<Statement *> statements;
+    while (Statement *ast = par.parse()) {
+        statements.push_back(ast);
+        if (fn_cache) {
+            digests[ast] = digest.final().str();
+            digest.init();
+        }
+    }
+    if (!par.at_end())
+        return 1;
+
+    Sema sema{interner, types, ast_arena};
+    if (!sema.run(statements))
+        return 1;
+    EffectAnalysis effects;
+    effects.run(sema.get_decls(), sema.get_defs());
+    if (target_spec.opt_level > 0) {
+        // A call evaluated at compile time leaves no trace in the IR, which
+        // FunctionCache takes the functions a definition depends on from
+        ConstFolder folder{types, ast_arena, incremental ? 0 : 1u << 20};
+        folder.run(sema.get_defs());
+    }
+
+    for (const auto *decl : sema.get_decls())
+        gen.declare(*decl);
+
+    if (jobs > 1) {
+        ParallelCodegen codegen{
+                sema.get_decls(), sema.get_defs(), interner,
+                target_spec.opt_level,
+                [&]() -> std::unique_ptr<llvm::TargetMachine> {
+                    return run_jit ? jit->create_target_machine()
+                                   : create_target_machine(target_spec);
+                }};
+        codegen.set_report_tail_calls(report_tail_calls);
+        codegen.set_bounds_checks(!unchecked);
+        if (!codegen.run(jobs, split_objects
+                                       ? ParallelCodegen::Output::OBJECT
+                                       : ParallelCodegen::Output::BITCODE))
+            return 1;
+
+        for (const auto &output : codegen.get_outputs()) {
+            auto buffer = llvm::MemoryBuffer::getMemBufferCopy(output);
+            if (split_objects) {
+                objects.push_back(std::move(buffer));
+                continue;
+            }
+            if (!link_bitcode(gen.get_module(), *buffer))
+                return 1;
+        }
+    } else {
+        for (const auto *def : sema.get_defs()) {
+            auto *fn = gen.define(*def);
+            if (!fn)
+                return 1;
+            if (fn_cache)
+                fn_cache->add_digest(fn->getName(), digests[def]);
         }
     }
 
-    //std::ofstream out_file{"out.bc", std::ios_base::binary};
-    std::ofstream out_file{"out.ll"};
-    if (out_file.fail())
+    // Optimisation may remove `main` once its code comes from the cache
+    bool returns_code = false;
+    if (run_jit && !check_main(gen.get_module(), returns_code))
+        return 1;
+
+    if (fn_cache)
+        fn_cache->prepare(gen.get_module());
+    // Workers have optimised their modules already
+    if (!lazy_jit && !cached && jobs == 1
+        && !optimizer.run_on_module(gen.get_module()))
         return 1;
-    //gen.write_bitcode(out_file);
-    gen.write_assembly(out_file);
+    if (fn_cache) {
+        if (!fn_cache->compile(gen.get_module(), target))
+            return 1;
+        objects = fn_cache->take_objects();
+    }
 
-    return 0;
+    if (run_jit) {
+        int status = run(*jit, gen, context, std::move(objects),
+                         returns_code, compile_start);
+        if (cache)
+            finish_cache(*cache, cache_stats);
+        return status;
+    }
+
+    if (!objects.empty()) {
+        std::vector<llvm::StringRef> contents;
+        for (const auto &object : objects)
+            contents.push_back(object->getBuffer());
+        bool ok = link_executable(contents, output_path, runtime_path);
+        if (cache)
+            finish_cache(*cache, cache_stats);
+        return ok ? 0 : 1;
+    }
+
+    std::string contents;
+    if (!generate(gen, *tm, emit_kind, contents))
+        return 1;
+    if (cache)
+        cache->store(key, contents);
+    bool ok = write_output(emit_kind, contents, output_path, runtime_path);
+    if (cache)
+        finish_cache(*cache, cache_stats);
+    return ok ? 0 : 1;
 }